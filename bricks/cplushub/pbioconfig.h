@@ -1,6 +1,8 @@
 // SPDX-License-Identifier: MIT
 // Copyright (c) 2019-2020 The Pybricks Authors
 
+#define PBIO_CONFIG_ATTITUDE                (1)
+
 #define PBIO_CONFIG_IOPORT_LPF2             (1)
 
 #define PBIO_CONFIG_DCMOTOR                 (1)
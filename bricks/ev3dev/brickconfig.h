@@ -9,6 +9,9 @@
 
 #define PYBRICKS_HUB_EV3                (1)
 
+// Control loops run in the task caller thread instead of the event hook
+#define PYBRICKS_PORT_CONTROL_THREAD    (1)
+
 // Pybricks modules
 #define PYBRICKS_PY_BUTTONS             (1)
 #define PYBRICKS_PY_EV3DEVICES          (1)
@@ -18,6 +21,7 @@
 #define PYBRICKS_PY_PARAMETERS          (1)
 #define PYBRICKS_PY_PUPDEVICES          (0)
 #define PYBRICKS_PY_ROBOTICS            (1)
+#define PYBRICKS_PY_TOOLS_TASKS         (1)
 #define PYBRICKS_PY_USIGNAL             (1)
 
 #define MICROPY_PORT_INIT_FUNC pybricks_init()
@@ -31,6 +35,7 @@ extern const struct _mp_obj_module_t pb_module_experimental;
 extern const struct _mp_obj_module_t pb_module_hubs;
 extern const struct _mp_obj_module_t pb_module_iodevices;
 extern const struct _mp_obj_module_t pb_module_media_ev3dev;
+extern const struct _mp_obj_module_t pb_module_messaging;
 extern const struct _mp_obj_module_t pb_module_nxtdevices;
 extern const struct _mp_obj_module_t pb_module_parameters;
 extern const struct _mp_obj_module_t pb_module_robotics;
@@ -44,6 +49,7 @@ extern const struct _mp_obj_module_t pb_module_usignal;
     { MP_ROM_QSTR(MP_QSTR_hubs_c),          MP_ROM_PTR(&pb_module_hubs)             }, \
     { MP_ROM_QSTR(MP_QSTR_iodevices_c),     MP_ROM_PTR(&pb_module_iodevices)        }, \
     { MP_ROM_QSTR(MP_QSTR_media_ev3dev_c),  MP_ROM_PTR(&pb_module_media_ev3dev)     }, \
+    { MP_ROM_QSTR(MP_QSTR_messaging_c),     MP_ROM_PTR(&pb_module_messaging)        }, \
     { MP_ROM_QSTR(MP_QSTR_nxtdevices_c),    MP_ROM_PTR(&pb_module_nxtdevices)       }, \
     { MP_ROM_QSTR(MP_QSTR_parameters_c),    MP_ROM_PTR(&pb_module_parameters)       }, \
     { MP_ROM_QSTR(MP_QSTR_robotics_c),      MP_ROM_PTR(&pb_module_robotics)         }, \
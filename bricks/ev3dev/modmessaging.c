@@ -0,0 +1,327 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+// Mailbox storage and message framing for pybricks.messaging.
+//
+// This implements the parts of the EV3 mailbox protocol that run for every
+// message, so that they don't need any allocations. Mailboxes and outgoing
+// frames use buffers that are allocated once with the Mailboxes object.
+// Incoming frames use a buffer that each connection allocates once, since
+// all connections receive at the same time. All mailbox data is only
+// accessed while holding the GIL, so reading the latest value does not need
+// a lock. The mutex below is only used to wake up threads that wait for a
+// mailbox update while they have released the GIL.
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "py/mpconfig.h"
+#include "py/mpthread.h"
+#include "py/obj.h"
+#include "py/runtime.h"
+#include "py/stream.h"
+
+// Maximum number of mailboxes that can be used at the same time
+#define PB_MESSAGING_NUM_MAILBOXES (16)
+
+// The EV3 firmware limits messages to 1024 bytes, not counting the size field
+#define PB_MESSAGING_MAX_SIZE (1024)
+
+// Size of the fixed message header: message counter, command type, command
+#define HEADER_SIZE (4)
+
+// EV3 VM bytecodes
+#define SYSTEM_COMMAND_NO_REPLY (0x81)
+#define WRITEMAILBOX (0x9E)
+
+// How often threads that wait for an update check for pending exceptions (ms)
+#define WAIT_POLL_MS (10)
+
+typedef struct _messaging_mailbox_t {
+    // Name without terminating zero, as sent by the remote device
+    char name[UINT8_MAX];
+    uint8_t name_size;
+    // Size of the current value
+    uint16_t data_size;
+    bool has_value;
+    // Incremented on each update, protected by update_lock
+    uint32_t update_count;
+    uint8_t data[PB_MESSAGING_MAX_SIZE];
+} messaging_mailbox_t;
+
+typedef struct _messaging_Mailboxes_obj_t {
+    mp_obj_base_t base;
+    uint8_t num_mailboxes;
+    messaging_mailbox_t mailboxes[PB_MESSAGING_NUM_MAILBOXES];
+    // Outgoing message, including the size field
+    uint8_t tx_frame[2 + PB_MESSAGING_MAX_SIZE];
+} messaging_Mailboxes_obj_t;
+
+STATIC pthread_mutex_t update_lock = PTHREAD_MUTEX_INITIALIZER;
+STATIC pthread_cond_t update_cond = PTHREAD_COND_INITIALIZER;
+
+STATIC mp_obj_t messaging_Mailboxes_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args) {
+    mp_arg_check_num(n_args, n_kw, 0, 0, false);
+    messaging_Mailboxes_obj_t *self = m_new0(messaging_Mailboxes_obj_t, 1);
+    self->base.type = type;
+    return MP_OBJ_FROM_PTR(self);
+}
+
+// Gets the size of a mailbox name without trailing zeros, since the EV3
+// firmware includes the terminating zero of the name and we don't.
+STATIC size_t get_name_size(const char *name, size_t name_size) {
+    while (name_size && name[name_size - 1] == '\0') {
+        name_size--;
+    }
+
+    if (name_size > sizeof(((messaging_mailbox_t *)0)->name)) {
+        mp_raise_ValueError(MP_ERROR_TEXT("Mailbox name is too long"));
+    }
+
+    return name_size;
+}
+
+// Gets the mailbox with the given name or NULL if it does not exist yet.
+STATIC messaging_mailbox_t *find_mailbox(messaging_Mailboxes_obj_t *self, const char *name, size_t name_size) {
+    name_size = get_name_size(name, name_size);
+
+    for (uint8_t i = 0; i < self->num_mailboxes; i++) {
+        messaging_mailbox_t *mbox = &self->mailboxes[i];
+        if (mbox->name_size == name_size && memcmp(mbox->name, name, name_size) == 0) {
+            return mbox;
+        }
+    }
+
+    return NULL;
+}
+
+// Gets the mailbox with the given name, adding it if it does not exist yet.
+// Only received messages add mailboxes, so that asking for a name that is
+// never sent does not use up one of the mailboxes.
+STATIC messaging_mailbox_t *get_mailbox(messaging_Mailboxes_obj_t *self, const char *name, size_t name_size) {
+    messaging_mailbox_t *mbox = find_mailbox(self, name, name_size);
+    if (mbox) {
+        return mbox;
+    }
+
+    if (self->num_mailboxes == PB_MESSAGING_NUM_MAILBOXES) {
+        mp_raise_ValueError(MP_ERROR_TEXT("Too many mailboxes"));
+    }
+
+    name_size = get_name_size(name, name_size);
+    mbox = &self->mailboxes[self->num_mailboxes++];
+    memcpy(mbox->name, name, name_size);
+    mbox->name_size = name_size;
+    return mbox;
+}
+
+STATIC uint16_t get_u16(const uint8_t *data) {
+    return data[0] | data[1] << 8;
+}
+
+STATIC void set_u16(uint8_t *data, uint16_t value) {
+    data[0] = value;
+    data[1] = value >> 8;
+}
+
+// Reads exactly size bytes. Returns false if the connection was closed.
+STATIC bool read_exactly(mp_obj_t stream, uint8_t *buf, mp_uint_t size) {
+    int errcode = 0;
+    mp_uint_t ret = mp_stream_rw(stream, buf, size, &errcode, MP_STREAM_RW_READ);
+    if (ret == MP_STREAM_ERROR) {
+        if (errcode == ECONNRESET) {
+            return false;
+        }
+        mp_raise_OSError(errcode);
+    }
+    return ret == size;
+}
+
+// Mailboxes.receive(stream, buf)
+// Reads one message from the stream and stores it in its mailbox. buf is a
+// writable buffer of at least MAX_SIZE bytes that is used for the incoming
+// frame. Returns False when the remote device closed the connection.
+STATIC mp_obj_t messaging_Mailboxes_receive(mp_obj_t self_in, mp_obj_t stream_in, mp_obj_t buf_in) {
+    messaging_Mailboxes_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    mp_get_stream_raise(stream_in, MP_STREAM_OP_READ);
+    mp_buffer_info_t buf;
+    mp_get_buffer_raise(buf_in, &buf, MP_BUFFER_WRITE);
+    if (buf.len < PB_MESSAGING_MAX_SIZE) {
+        mp_raise_ValueError(MP_ERROR_TEXT("Buffer is too small"));
+    }
+
+    uint8_t *frame = buf.buf;
+
+    if (!read_exactly(stream_in, frame, 2)) {
+        return mp_const_false;
+    }
+    uint16_t size = get_u16(frame);
+    if (size > PB_MESSAGING_MAX_SIZE || size < HEADER_SIZE + 1) {
+        mp_raise_ValueError(MP_ERROR_TEXT("Bad message size"));
+    }
+    if (!read_exactly(stream_in, frame, size)) {
+        return mp_const_false;
+    }
+
+    if (frame[2] != SYSTEM_COMMAND_NO_REPLY) {
+        mp_raise_ValueError(MP_ERROR_TEXT("Bad message type"));
+    }
+    if (frame[3] != WRITEMAILBOX) {
+        mp_raise_ValueError(MP_ERROR_TEXT("Bad command"));
+    }
+
+    uint8_t name_size = frame[4];
+    const uint8_t *name = frame + HEADER_SIZE + 1;
+    if (HEADER_SIZE + 1 + name_size + 2 > size) {
+        mp_raise_ValueError(MP_ERROR_TEXT("Bad message size"));
+    }
+    uint16_t data_size = get_u16(name + name_size);
+    const uint8_t *data = name + name_size + 2;
+    if (data + data_size > frame + size) {
+        mp_raise_ValueError(MP_ERROR_TEXT("Bad message size"));
+    }
+
+    messaging_mailbox_t *mbox = get_mailbox(self, (const char *)name, name_size);
+    memcpy(mbox->data, data, data_size);
+    mbox->data_size = data_size;
+    mbox->has_value = true;
+
+    pthread_mutex_lock(&update_lock);
+    mbox->update_count++;
+    pthread_cond_broadcast(&update_cond);
+    pthread_mutex_unlock(&update_lock);
+
+    return mp_const_true;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_3(messaging_Mailboxes_receive_obj, messaging_Mailboxes_receive);
+
+// Mailboxes.read(name)
+// Gets the latest value of a mailbox or None if it never received one.
+STATIC mp_obj_t messaging_Mailboxes_read(mp_obj_t self_in, mp_obj_t name_in) {
+    messaging_Mailboxes_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    size_t name_size;
+    const char *name = mp_obj_str_get_data(name_in, &name_size);
+
+    messaging_mailbox_t *mbox = find_mailbox(self, name, name_size);
+    if (!mbox || !mbox->has_value) {
+        return mp_const_none;
+    }
+    return mp_obj_new_bytes(mbox->data, mbox->data_size);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(messaging_Mailboxes_read_obj, messaging_Mailboxes_read);
+
+// Mailboxes.wait(name)
+// Waits until the mailbox receives a value.
+STATIC mp_obj_t messaging_Mailboxes_wait(mp_obj_t self_in, mp_obj_t name_in) {
+    messaging_Mailboxes_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    size_t name_size;
+    const char *name = mp_obj_str_get_data(name_in, &name_size);
+
+    // A mailbox that does not exist yet is added with its first update, so
+    // it counts as having had no updates until then.
+    messaging_mailbox_t *mbox = find_mailbox(self, name, name_size);
+    uint32_t update_count = 0;
+    if (mbox) {
+        pthread_mutex_lock(&update_lock);
+        update_count = mbox->update_count;
+        pthread_mutex_unlock(&update_lock);
+    }
+
+    for (;;) {
+        // Release the GIL so that the threads that receive messages can run
+        MP_THREAD_GIL_EXIT();
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += WAIT_POLL_MS * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        pthread_mutex_lock(&update_lock);
+        if (!mbox || mbox->update_count == update_count) {
+            pthread_cond_timedwait(&update_cond, &update_lock, &deadline);
+        }
+        bool updated = mbox && mbox->update_count != update_count;
+        pthread_mutex_unlock(&update_lock);
+        MP_THREAD_GIL_ENTER();
+
+        if (updated) {
+            return mp_const_none;
+        }
+
+        // Mailboxes are only added while holding the GIL, so look again
+        // now that we have it.
+        if (!mbox) {
+            mbox = find_mailbox(self, name, name_size);
+            if (mbox) {
+                return mp_const_none;
+            }
+        }
+
+        // Allow KeyboardInterrupt and other exceptions
+        mp_handle_pending(true);
+    }
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(messaging_Mailboxes_wait_obj, messaging_Mailboxes_wait);
+
+// Mailboxes.frame(name, payload)
+// Encodes a message for a mailbox. The returned memoryview refers to a buffer
+// that is reused by the next call, so it must be sent before calling again.
+STATIC mp_obj_t messaging_Mailboxes_frame(mp_obj_t self_in, mp_obj_t name_in, mp_obj_t payload_in) {
+    messaging_Mailboxes_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    size_t name_size;
+    const char *name = mp_obj_str_get_data(name_in, &name_size);
+    mp_buffer_info_t payload;
+    mp_get_buffer_raise(payload_in, &payload, MP_BUFFER_READ);
+
+    // The name is sent with its terminating zero
+    size_t size = HEADER_SIZE + 1 + name_size + 1 + 2 + payload.len;
+    if (name_size + 1 > UINT8_MAX || size > PB_MESSAGING_MAX_SIZE) {
+        mp_raise_ValueError(MP_ERROR_TEXT("Message is too big"));
+    }
+
+    uint8_t *frame = self->tx_frame;
+    set_u16(frame, size);
+    set_u16(frame + 2, 1);
+    frame[4] = SYSTEM_COMMAND_NO_REPLY;
+    frame[5] = WRITEMAILBOX;
+    frame[6] = name_size + 1;
+    memcpy(frame + 7, name, name_size);
+    frame[7 + name_size] = '\0';
+    set_u16(frame + 8 + name_size, payload.len);
+    memcpy(frame + 10 + name_size, payload.buf, payload.len);
+
+    return mp_obj_new_memoryview('B', 2 + size, frame);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_3(messaging_Mailboxes_frame_obj, messaging_Mailboxes_frame);
+
+STATIC const mp_rom_map_elem_t messaging_Mailboxes_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR_receive), MP_ROM_PTR(&messaging_Mailboxes_receive_obj) },
+    { MP_ROM_QSTR(MP_QSTR_read),    MP_ROM_PTR(&messaging_Mailboxes_read_obj)    },
+    { MP_ROM_QSTR(MP_QSTR_wait),    MP_ROM_PTR(&messaging_Mailboxes_wait_obj)    },
+    { MP_ROM_QSTR(MP_QSTR_frame),   MP_ROM_PTR(&messaging_Mailboxes_frame_obj)   },
+    { MP_ROM_QSTR(MP_QSTR_MAX_SIZE), MP_ROM_INT(PB_MESSAGING_MAX_SIZE)          },
+};
+STATIC MP_DEFINE_CONST_DICT(messaging_Mailboxes_locals_dict, messaging_Mailboxes_locals_dict_table);
+
+STATIC const mp_obj_type_t messaging_Mailboxes_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_Mailboxes,
+    .make_new = messaging_Mailboxes_make_new,
+    .locals_dict = (mp_obj_dict_t *)&messaging_Mailboxes_locals_dict,
+};
+
+STATIC const mp_rom_map_elem_t ev3dev_messaging_globals_table[] = {
+    { MP_ROM_QSTR(MP_QSTR___name__),  MP_ROM_QSTR(MP_QSTR_messaging_c)       },
+    { MP_ROM_QSTR(MP_QSTR_Mailboxes), MP_ROM_PTR(&messaging_Mailboxes_type)  },
+};
+STATIC MP_DEFINE_CONST_DICT(ev3dev_messaging_globals, ev3dev_messaging_globals_table);
+
+const mp_obj_module_t pb_module_messaging = {
+    .base = { &mp_type_module },
+    .globals = (mp_obj_dict_t *)&ev3dev_messaging_globals,
+};
@@ -2,9 +2,10 @@
 # Copyright (C) 2020 The Pybricks Authors
 
 from _thread import allocate_lock
-from uerrno import ECONNRESET
 from ustruct import pack, unpack
 
+from messaging_c import Mailboxes
+
 from pybricks.bluetooth import (
     resolve,
     BDADDR_ANY,
@@ -133,51 +134,27 @@ class TextMailbox(Mailbox):
 # EV3 standard firmware is hard-coded to use channel 1
 EV3_RFCOMM_CHANNEL = 1
 
-# EV3 VM bytecodes
-SYSTEM_COMMAND_NO_REPLY = 0x81
-WRITEMAILBOX = 0x9E
-
 
 class MailboxHandler(StreamRequestHandler):
     def handle(self):
         with self.server._lock:
             self.server._clients[self.client_address[0]] = self.request
-        while True:
-            try:
-                buf = self.rfile.read(2)
-            except OSError as ex:
-                # The client disconnected the connection
-                if ex.args[0] == ECONNRESET:
-                    break
-                raise
-            (size,) = unpack("<H", buf)
-            buf = self.rfile.read(size)
-            msg_count, cmd_type, cmd, name_size = unpack("<HBBB", buf)
-            if cmd_type != SYSTEM_COMMAND_NO_REPLY:
-                raise ValueError("Bad message type")
-            if cmd != WRITEMAILBOX:
-                raise ValueError("Bad command")
-            mbox = buf[5 : 5 + name_size].decode().strip("\0")
-            (data_size,) = unpack("<H", buf[5 + name_size : 7 + name_size])
-            data = buf[7 + name_size : 7 + name_size + data_size]
-
-            with self.server._lock:
-                self.server._mailboxes[mbox] = data
-                update_lock = self.server._updates.get(mbox)
-                if update_lock:
-                    update_lock.release()
+        # Framing and mailbox storage are done in C, so receiving a message
+        # does not allocate any memory. Each connection needs its own buffer
+        # since they all receive at the same time.
+        buf = bytearray(Mailboxes.MAX_SIZE)
+        while self.server._mailboxes.receive(self.rfile, buf):
+            pass
 
 
 class MailboxHandlerMixIn:
     def __init__(self):
-        # protects against concurrent access of other attributes
+        # protects against concurrent access of _clients and _addresses
         self._lock = allocate_lock()
-        # map of mailbox name to raw data
-        self._mailboxes = {}
+        # mailbox storage with preallocated buffers
+        self._mailboxes = Mailboxes()
         # map of device name/address to object with send() method
         self._clients = {}
-        # map of mailbox name to mutex lock
-        self._updates = {}
         # map of names to addresses
         self._addresses = {}
 
@@ -193,8 +170,7 @@ class MailboxHandlerMixIn:
                 The current mailbox raw data or ``None`` if nothing has ever
                 been delivered to the mailbox.
         """
-        with self._lock:
-            return self._mailboxes.get(mbox)
+        return self._mailboxes.read(mbox)
 
     def send_to_mailbox(self, brick, mbox, payload):
         """Sends a mailbox value using raw bytes data.
@@ -208,22 +184,10 @@ class MailboxHandlerMixIn:
             payload (bytes):
                 A bytes-like object that will be sent to the mailbox.
         """
-        mbox_len = len(mbox) + 1
-        payload_len = len(payload)
-        send_len = 7 + mbox_len + payload_len
-        fmt = "<HHBBB{}sH{}s".format(mbox_len, payload_len)
-        data = pack(
-            fmt,
-            send_len,
-            1,
-            SYSTEM_COMMAND_NO_REPLY,
-            WRITEMAILBOX,
-            mbox_len,
-            mbox,
-            payload_len,
-            payload,
-        )
         with self._lock:
+            # The frame buffer is reused for each message, so this has to be
+            # sent before the lock is released.
+            data = self._mailboxes.frame(mbox, payload)
             if brick is None:
                 for client in self._clients.values():
                     client.send(data)
@@ -238,15 +202,7 @@ class MailboxHandlerMixIn:
 
     def wait_for_mailbox_update(self, mbox):
         """Waits until ``mbox`` receives a value."""
-        lock = allocate_lock()
-        lock.acquire()
-        with self._lock:
-            self._updates[mbox] = lock
-        try:
-            return lock.acquire()
-        finally:
-            with self._lock:
-                del self._updates[mbox]
+        self._mailboxes.wait(mbox)
 
 
 class BluetoothMailboxServer(MailboxHandlerMixIn, ThreadingRFCOMMServer):
@@ -385,10 +385,16 @@ struct _mp_bluetooth_btstack_root_pointers_t;
 #define MICROPY_BLUETOOTH_ROOT_POINTERS
 #endif
 
+// Number of decoded images kept by file name for drawing
+#define PYBRICKS_EV3DEV_IMAGE_CACHE_SIZE (8)
+
 #define MICROPY_PORT_ROOT_POINTERS \
     const char *readline_hist[50]; \
     void *mmap_region_head; \
+    mp_obj_t ev3dev_image_cache_key[PYBRICKS_EV3DEV_IMAGE_CACHE_SIZE]; \
+    mp_obj_t ev3dev_image_cache_image[PYBRICKS_EV3DEV_IMAGE_CACHE_SIZE]; \
     MICROPY_BLUETOOTH_ROOT_POINTERS \
+    PYBRICKS_ROBOTICS_ROOT_POINTERS \
 
 // We need to provide a declaration/definition of alloca()
 // unless support for it is disabled.
@@ -427,6 +433,8 @@ struct _mp_bluetooth_btstack_root_pointers_t;
 #define MICROPY_VM_HOOK_LOOP do { \
         extern int pbio_do_one_event(void); \
         pbio_do_one_event(); \
+        extern void pb_type_ev3dev_Image_poll_screen(void); \
+        pb_type_ev3dev_Image_poll_screen(); \
 } while (0);
 
 #include <glib.h>
@@ -436,6 +444,8 @@ struct _mp_bluetooth_btstack_root_pointers_t;
         mp_handle_pending(true); \
         extern int pbio_do_one_event(void); \
         while (pbio_do_one_event()) { } \
+        extern void pb_type_ev3dev_Image_flush_screen(void); \
+        pb_type_ev3dev_Image_flush_screen(); \
         MP_THREAD_GIL_EXIT(); \
         g_main_context_iteration(g_main_context_get_thread_default(), TRUE); \
         MP_THREAD_GIL_ENTER(); \
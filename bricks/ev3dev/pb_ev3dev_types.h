@@ -24,6 +24,11 @@ GrxFont *pb_ev3dev_Font_obj_get_font(mp_const_obj_t obj);
 
 const mp_obj_type_t pb_type_ev3dev_Image;
 
+// Copies drawing on the screen image to the actual screen
+void pb_type_ev3dev_Image_flush_screen(void);
+// Same as above, but at most at the screen frame rate
+void pb_type_ev3dev_Image_poll_screen(void);
+
 // class Speaker
 
 const mp_obj_type_t pb_type_ev3dev_Speaker;
@@ -5,7 +5,9 @@
 // class Image
 //
 // Image manipulation on ev3dev using the GRX3 graphics library. This can be
-// used for both in-memory images and writing directly to the screen.
+// used for both in-memory images and the screen. Drawing on the screen goes to
+// an off-screen frame first. Only the area that changed is copied to the
+// screen when the frame is flushed.
 
 #include <string.h>
 
@@ -22,6 +24,7 @@
 
 #include "modparameters.h"
 #include "pb_ev3dev_types.h"
+#include "pbinit.h"
 #include "pbkwarg.h"
 #include "pbobj.h"
 
@@ -29,8 +32,10 @@ typedef struct _ev3dev_Image_obj_t {
     mp_obj_base_t base;
     mp_obj_t width;
     mp_obj_t height;
-    mp_obj_t buffer; // only used by _screen_
     gboolean cleared; // only used by _screen_
+    gboolean on_screen; // true for _screen_ and sub-images of it
+    gint screen_x; // position on the screen, if on_screen
+    gint screen_y;
     GrxContext *context;
     void *mem; // don't touch - needed for GC pressure
     GrxTextOptions *text_options;
@@ -38,6 +43,90 @@ typedef struct _ev3dev_Image_obj_t {
     gint print_y;
 } ev3dev_Image_obj_t;
 
+// Off-screen frame shared by all images that draw on the screen
+STATIC GrxContext *screen_frame;
+
+// Area of the screen frame that changed since the last flush
+STATIC gboolean screen_dirty;
+STATIC gint dirty_x1, dirty_y1, dirty_x2, dirty_y2;
+
+// Time of the last flush (us)
+STATIC gint64 screen_flush_time;
+
+// Minimum time between automatic flushes while the program is running (us)
+#define SCREEN_FLUSH_INTERVAL (33 * 1000)
+
+STATIC GrxContext *get_screen_frame(void) {
+    if (screen_frame == NULL) {
+        // The frame is never freed, so it is not allocated on the GC heap
+        GrxContext *screen = grx_get_screen_context();
+        gint w = grx_context_get_width(screen);
+        gint h = grx_context_get_height(screen);
+        GrxFrameMemory mem;
+        mem.plane0 = g_malloc(grx_screen_get_context_size(w, h));
+        screen_frame = grx_context_new(w, h, &mem, NULL);
+        if (!screen_frame) {
+            mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("failed to allocate context for screen"));
+        }
+        // Start with what is on the screen now
+        grx_context_bit_blt(screen_frame, 0, 0, screen, 0, 0, w - 1, h - 1, GRX_COLOR_MODE_WRITE);
+    }
+    return screen_frame;
+}
+
+// Marks an area of the image as changed, so it is copied to the screen on the
+// next flush. Does nothing for images that are not on the screen.
+STATIC void mark_dirty(ev3dev_Image_obj_t *self, gint x1, gint y1, gint x2, gint y2) {
+    if (!self->on_screen) {
+        return;
+    }
+
+    // Convert to screen coordinates and clip to the screen
+    gint left = MAX(MIN(x1, x2) + self->screen_x, 0);
+    gint top = MAX(MIN(y1, y2) + self->screen_y, 0);
+    gint right = MIN(MAX(x1, x2) + self->screen_x, grx_context_get_max_x(screen_frame));
+    gint bottom = MIN(MAX(y1, y2) + self->screen_y, grx_context_get_max_y(screen_frame));
+    if (right < left || bottom < top) {
+        return;
+    }
+
+    if (!screen_dirty) {
+        dirty_x1 = left;
+        dirty_y1 = top;
+        dirty_x2 = right;
+        dirty_y2 = bottom;
+        screen_dirty = TRUE;
+        return;
+    }
+    dirty_x1 = MIN(dirty_x1, left);
+    dirty_y1 = MIN(dirty_y1, top);
+    dirty_x2 = MAX(dirty_x2, right);
+    dirty_y2 = MAX(dirty_y2, bottom);
+}
+
+// Marks the whole image as changed
+STATIC void mark_dirty_all(ev3dev_Image_obj_t *self) {
+    mark_dirty(self, 0, 0, grx_context_get_max_x(self->context), grx_context_get_max_y(self->context));
+}
+
+// Copies the changed area of the screen frame to the screen
+void pb_type_ev3dev_Image_flush_screen(void) {
+    if (!screen_dirty) {
+        return;
+    }
+    grx_context_bit_blt(grx_get_screen_context(), dirty_x1, dirty_y1, screen_frame,
+        dirty_x1, dirty_y1, dirty_x2, dirty_y2, GRX_COLOR_MODE_WRITE);
+    screen_dirty = FALSE;
+    screen_flush_time = g_get_monotonic_time();
+}
+
+// Flushes the screen if it changed, but not more often than the frame rate
+void pb_type_ev3dev_Image_poll_screen(void) {
+    if (screen_dirty && g_get_monotonic_time() - screen_flush_time >= SCREEN_FLUSH_INTERVAL) {
+        pb_type_ev3dev_Image_flush_screen();
+    }
+}
+
 // map Pybricks color enum to GRX color value using standard web CSS values
 STATIC GrxColor map_color(mp_obj_t *obj) {
     if (obj == mp_const_none) {
@@ -85,7 +174,10 @@ STATIC mp_obj_t ev3dev_Image_new(GrxContext *context) {
     self->text_options = grx_text_options_new(font, GRX_COLOR_BLACK);
 
     // only the screen needs to be cleared on first use
-    self->cleared = context != grx_get_screen_context();
+    self->cleared = TRUE;
+    self->on_screen = FALSE;
+    self->screen_x = 0;
+    self->screen_y = 0;
 
     return MP_OBJ_FROM_PTR(self);
 }
@@ -104,12 +196,23 @@ STATIC mp_obj_t ev3dev_Image_make_new(const mp_obj_type_t *type, size_t n_args,
     mp_arg_val_t arg_vals[MP_ARRAY_SIZE(allowed_args)];
     mp_arg_parse_all_kw_array(n_args, n_kw, args, MP_ARRAY_SIZE(allowed_args), allowed_args, arg_vals);
 
+    // All images use the pixel format of the screen
+    pybricks_init_graphics();
+
     GrxContext *context = NULL;
+    ev3dev_Image_obj_t *screen_parent = NULL;
+    gint screen_x = 0;
+    gint screen_y = 0;
 
     mp_obj_t source_in = arg_vals[ARG_source].u_obj;
     if (mp_obj_is_qstr(source_in) && MP_OBJ_QSTR_VALUE(source_in) == MP_QSTR__screen_) {
-        // special case '_screen_' creates image that draws directly to screen
-        context = grx_context_ref(grx_get_screen_context());
+        // special case '_screen_' creates image that draws to the screen
+        context = grx_context_ref(get_screen_frame());
+        mp_obj_t image = ev3dev_Image_new(context);
+        ev3dev_Image_obj_t *self = MP_OBJ_TO_PTR(image);
+        self->on_screen = TRUE;
+        self->cleared = FALSE;
+        return image;
     } else if (mp_obj_is_str(source_in)) {
         const char *filename = mp_obj_str_get_str(source_in);
 
@@ -154,6 +257,12 @@ STATIC mp_obj_t ev3dev_Image_make_new(const mp_obj_type_t *type, size_t n_args,
             mp_int_t x2 = pb_obj_get_int(arg_vals[ARG_x2].u_obj);
             mp_int_t y2 = pb_obj_get_int(arg_vals[ARG_y2].u_obj);
             context = grx_context_new_subcontext(x1, y1, x2, y2, image->context, NULL);
+            // drawing on a part of the screen still needs to update the screen
+            if (image->on_screen) {
+                screen_parent = image;
+                screen_x = image->screen_x + MIN(x1, x2);
+                screen_y = image->screen_y + MIN(y1, y2);
+            }
         } else {
             gint w = grx_context_get_width(image->context);
             gint h = grx_context_get_height(image->context);
@@ -169,10 +278,90 @@ STATIC mp_obj_t ev3dev_Image_make_new(const mp_obj_type_t *type, size_t n_args,
         mp_raise_TypeError(MP_ERROR_TEXT("Argument must be str or Image"));
     }
 
-    return ev3dev_Image_new(context);
+    mp_obj_t image = ev3dev_Image_new(context);
+    if (screen_parent) {
+        ev3dev_Image_obj_t *self = MP_OBJ_TO_PTR(image);
+        self->on_screen = TRUE;
+        self->screen_x = screen_x;
+        self->screen_y = screen_y;
+    }
+    return image;
+}
+
+// Decoded images are kept by file name, so that drawing the same file again
+// does not read and decode it again. The least recently used image is
+// replaced when the cache is full.
+STATIC uint32_t image_cache_stamp[PYBRICKS_EV3DEV_IMAGE_CACHE_SIZE];
+STATIC uint32_t image_cache_time;
+
+// Gets the file name including extension, as used by the cache
+STATIC mp_obj_t image_cache_key(mp_obj_t filename_in) {
+    const char *filename = mp_obj_str_get_str(filename_in);
+    if (g_str_has_suffix(filename, ".png") || g_str_has_suffix(filename, ".PNG")) {
+        return filename_in;
+    }
+    vstr_t vstr;
+    vstr_init(&vstr, strlen(filename) + 4);
+    vstr_add_str(&vstr, filename);
+    vstr_add_str(&vstr, ".png");
+    return mp_obj_new_str_from_vstr(&mp_type_str, &vstr);
+}
+
+// Gets the image for a file from the cache, loading it if needed
+STATIC mp_obj_t image_cache_get(mp_obj_t filename_in) {
+    mp_obj_t key = image_cache_key(filename_in);
+
+    size_t oldest = 0;
+    for (size_t i = 0; i < PYBRICKS_EV3DEV_IMAGE_CACHE_SIZE; i++) {
+        mp_obj_t cached = MP_STATE_PORT(ev3dev_image_cache_key)[i];
+        if (cached != MP_OBJ_NULL && mp_obj_equal(cached, key)) {
+            image_cache_stamp[i] = ++image_cache_time;
+            return MP_STATE_PORT(ev3dev_image_cache_image)[i];
+        }
+        // Empty entries have a stamp of 0, so they are used first
+        if (image_cache_stamp[i] < image_cache_stamp[oldest]) {
+            oldest = i;
+        }
+    }
+
+    mp_obj_t args[1] = { key };
+    mp_obj_t image = ev3dev_Image_make_new(&pb_type_ev3dev_Image, 1, 0, args);
+
+    MP_STATE_PORT(ev3dev_image_cache_key)[oldest] = key;
+    MP_STATE_PORT(ev3dev_image_cache_image)[oldest] = image;
+    image_cache_stamp[oldest] = ++image_cache_time;
+
+    return image;
+}
+
+// Drops a file from the cache, for example because it was overwritten
+STATIC void image_cache_remove(mp_obj_t filename_in) {
+    mp_obj_t key = image_cache_key(filename_in);
+
+    for (size_t i = 0; i < PYBRICKS_EV3DEV_IMAGE_CACHE_SIZE; i++) {
+        mp_obj_t cached = MP_STATE_PORT(ev3dev_image_cache_key)[i];
+        if (cached != MP_OBJ_NULL && mp_obj_equal(cached, key)) {
+            MP_STATE_PORT(ev3dev_image_cache_key)[i] = MP_OBJ_NULL;
+            MP_STATE_PORT(ev3dev_image_cache_image)[i] = MP_OBJ_NULL;
+            image_cache_stamp[i] = 0;
+        }
+    }
+}
+
+// Gets the image to draw from, which is either an Image or a file name
+STATIC ev3dev_Image_obj_t *get_source_image(mp_obj_t source_in) {
+    if (mp_obj_is_str(source_in)) {
+        source_in = image_cache_get(source_in);
+    }
+    if (!mp_obj_is_type(source_in, &pb_type_ev3dev_Image)) {
+        mp_raise_TypeError(MP_ERROR_TEXT("source must be Image or str"));
+    }
+    return MP_OBJ_TO_PTR(source_in);
 }
 
 STATIC mp_obj_t ev3dev_Image_empty(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    pybricks_init_graphics();
+
     enum { ARG_width, ARG_height };
     const mp_arg_t allowed_args[] = {
         { MP_QSTR_width, MP_ARG_OBJ, { .u_obj = mp_obj_new_int(grx_get_screen_width())} },
@@ -213,13 +402,54 @@ STATIC void clear_once(ev3dev_Image_obj_t *self) {
         return;
     }
     grx_context_clear(self->context, GRX_COLOR_WHITE);
+    mark_dirty_all(self);
     self->cleared = TRUE;
 }
 
+// Copies the area (x1, y1)-(x2, y2) of the source to (x, y) on this image.
+// The area is clipped to both images, so sprites may be partially outside.
+STATIC void blit(ev3dev_Image_obj_t *self, gint x, gint y, ev3dev_Image_obj_t *source,
+    gint x1, gint y1, gint x2, gint y2, GrxColorMode mode) {
+
+    // Clip to source. Whatever is cut off at the top left moves the
+    // destination by the same amount, so the rest stays in place.
+    if (x1 < 0) {
+        x -= x1;
+        x1 = 0;
+    }
+    if (y1 < 0) {
+        y -= y1;
+        y1 = 0;
+    }
+    x2 = MIN(x2, grx_context_get_max_x(source->context));
+    y2 = MIN(y2, grx_context_get_max_y(source->context));
+
+    // Clip to destination
+    if (x < 0) {
+        x1 -= x;
+        x = 0;
+    }
+    if (y < 0) {
+        y1 -= y;
+        y = 0;
+    }
+    x2 = MIN(x2, x1 + grx_context_get_max_x(self->context) - x);
+    y2 = MIN(y2, y1 + grx_context_get_max_y(self->context) - y);
+
+    if (x2 < x1 || y2 < y1) {
+        return;
+    }
+
+    clear_once(self);
+    grx_context_bit_blt(self->context, x, y, source->context, x1, y1, x2, y2, mode);
+    mark_dirty(self, x, y, x + x2 - x1, y + y2 - y1);
+}
+
 STATIC mp_obj_t ev3dev_Image_clear(mp_obj_t self_in) {
     ev3dev_Image_obj_t *self = MP_OBJ_TO_PTR(self_in);
     clear_once(self);
     grx_context_clear(self->context, GRX_COLOR_WHITE);
+    mark_dirty_all(self);
     self->print_x = 0;
     self->print_y = 0;
     return mp_const_none;
@@ -240,6 +470,7 @@ STATIC mp_obj_t ev3dev_Image_draw_pixel(size_t n_args, const mp_obj_t *pos_args,
     clear_once(self);
     grx_set_current_context(self->context);
     grx_draw_pixel(x_, y_, color_);
+    mark_dirty(self, x_, y_, x_, y_);
 
     return mp_const_none;
 }
@@ -270,6 +501,7 @@ STATIC mp_obj_t ev3dev_Image_draw_line(size_t n_args, const mp_obj_t *pos_args,
         GrxLineOptions options = { .color = color_, .width = width_ };
         grx_draw_line_with_options(x1_, y1_, x2_, y2_, &options);
     }
+    mark_dirty(self, MIN(x1_, x2_) - width_, MIN(y1_, y2_) - width_, MAX(x1_, x2_) + width_, MAX(y1_, y2_) + width_);
 
     return mp_const_none;
 }
@@ -308,6 +540,7 @@ STATIC mp_obj_t ev3dev_Image_draw_box(size_t n_args, const mp_obj_t *pos_args, m
             grx_draw_box(x1_, y1_, x2_, y2_, color_);
         }
     }
+    mark_dirty(self, x1_, y1_, x2_, y2_);
 
     return mp_const_none;
 }
@@ -335,6 +568,7 @@ STATIC mp_obj_t ev3dev_Image_draw_circle(size_t n_args, const mp_obj_t *pos_args
     } else {
         grx_draw_circle(x_, y_, r_, color_);
     }
+    mark_dirty(self, x_ - r_, y_ - r_, x_ + r_, y_ + r_);
 
     return mp_const_none;
 }
@@ -350,18 +584,10 @@ STATIC mp_obj_t ev3dev_Image_draw_image(size_t n_args, const mp_obj_t *pos_args,
 
     mp_int_t x_ = pb_obj_get_int(x);
     mp_int_t y_ = pb_obj_get_int(y);
-    if (mp_obj_is_str(source)) {
-        mp_obj_t args[1] = { source };
-        source = ev3dev_Image_make_new(&pb_type_ev3dev_Image, 1, 0, args);
-    }
-    if (!mp_obj_is_type(source, &pb_type_ev3dev_Image)) {
-        mp_raise_TypeError(MP_ERROR_TEXT("Image object is required"));
-    }
-    ev3dev_Image_obj_t *source_ = MP_OBJ_TO_PTR(source);
+    ev3dev_Image_obj_t *source_ = get_source_image(source);
     GrxColor transparent_ = map_color(transparent);
 
-    clear_once(self);
-    grx_context_bit_blt(self->context, x_, y_, source_->context, 0, 0,
+    blit(self, x_, y_, source_, 0, 0,
         grx_context_get_max_x(source_->context), grx_context_get_max_y(source_->context),
         transparent_ == GRX_COLOR_NONE ? GRX_COLOR_MODE_WRITE : grx_color_to_image_mode(transparent_));
 
@@ -369,50 +595,67 @@ STATIC mp_obj_t ev3dev_Image_draw_image(size_t n_args, const mp_obj_t *pos_args,
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(ev3dev_Image_draw_image_obj, 1, ev3dev_Image_draw_image);
 
-STATIC mp_obj_t ev3dev_Image_load_image(mp_obj_t self_in, mp_obj_t source_in) {
-    ev3dev_Image_obj_t *self = MP_OBJ_TO_PTR(self_in);
-
-    if (mp_obj_is_str(source_in)) {
-        mp_obj_t args[1] = { source_in };
-        source_in = ev3dev_Image_make_new(&pb_type_ev3dev_Image, 1, 0, args);
-    }
+STATIC mp_obj_t ev3dev_Image_blit(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    PB_PARSE_ARGS_METHOD(n_args, pos_args, kw_args,
+        ev3dev_Image_obj_t, self,
+        PB_ARG_REQUIRED(x),
+        PB_ARG_REQUIRED(y),
+        PB_ARG_REQUIRED(source),
+        PB_ARG_DEFAULT_INT(x1, 0),
+        PB_ARG_DEFAULT_INT(y1, 0),
+        PB_ARG_DEFAULT_NONE(x2),
+        PB_ARG_DEFAULT_NONE(y2),
+        PB_ARG_DEFAULT_NONE(transparent));
 
-    if (!mp_obj_is_type(source_in, &pb_type_ev3dev_Image)) {
-        mp_raise_TypeError(MP_ERROR_TEXT("source must be Image or str"));
-    }
+    ev3dev_Image_obj_t *source_ = get_source_image(source);
+    mp_int_t x_ = pb_obj_get_int(x);
+    mp_int_t y_ = pb_obj_get_int(y);
+    mp_int_t x1_ = pb_obj_get_int(x1);
+    mp_int_t y1_ = pb_obj_get_int(y1);
+    mp_int_t x2_ = x2 == mp_const_none ? grx_context_get_max_x(source_->context) : pb_obj_get_int(x2);
+    mp_int_t y2_ = y2 == mp_const_none ? grx_context_get_max_y(source_->context) : pb_obj_get_int(y2);
+    GrxColor transparent_ = map_color(transparent);
 
-    ev3dev_Image_obj_t *source = MP_OBJ_TO_PTR(source_in);
+    blit(self, x_, y_, source_, x1_, y1_, x2_, y2_,
+        transparent_ == GRX_COLOR_NONE ? GRX_COLOR_MODE_WRITE : grx_color_to_image_mode(transparent_));
 
-    mp_obj_t x = mp_obj_new_int((mp_obj_get_int(self->width) - mp_obj_get_int(source->width)) / 2);
-    mp_obj_t y = mp_obj_new_int((mp_obj_get_int(self->height) - mp_obj_get_int(source->height)) / 2);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(ev3dev_Image_blit_obj, 1, ev3dev_Image_blit);
 
-    // if the destination is the screen, then we double-buffer to prevent flicker
-    if (self->context == grx_get_screen_context()) {
-        if (self->buffer == MP_OBJ_NULL) {
-            mp_obj_t args[2] = { self->width, self->height };
-            mp_map_t kw_args;
-            mp_map_init(&kw_args, 0);
-            self->buffer = ev3dev_Image_empty(MP_ARRAY_SIZE(args), args, &kw_args);
-        }
+STATIC mp_obj_t ev3dev_Image_load_image(mp_obj_t self_in, mp_obj_t source_in) {
+    ev3dev_Image_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    ev3dev_Image_obj_t *source = get_source_image(source_in);
 
-        ev3dev_Image_clear(self->buffer);
+    gint w = grx_context_get_width(self->context);
+    gint h = grx_context_get_height(self->context);
+    gint source_w = grx_context_get_width(source->context);
+    gint source_h = grx_context_get_height(source->context);
+    gint x = (w - source_w) / 2;
+    gint y = (h - source_h) / 2;
 
-        mp_obj_t args[4] = { self->buffer, x, y, source_in };
-        mp_map_t kw_args;
-        mp_map_init(&kw_args, 0);
-        ev3dev_Image_draw_image(MP_ARRAY_SIZE(args), args, &kw_args);
+    // Draw the image first and then clear only the area around it. Nothing
+    // is cleared twice, so this does not flicker on the screen.
+    self->cleared = TRUE;
+    blit(self, x, y, source, 0, 0, source_w - 1, source_h - 1, GRX_COLOR_MODE_WRITE);
 
-        source_in = self->buffer;
-        x = MP_OBJ_NEW_SMALL_INT(0);
-        y = MP_OBJ_NEW_SMALL_INT(0);
-    } else {
-        ev3dev_Image_clear(self_in);
+    grx_set_current_context(self->context);
+    if (y > 0) {
+        grx_draw_filled_box(0, 0, w - 1, y - 1, GRX_COLOR_WHITE);
+    }
+    if (y + source_h < h) {
+        grx_draw_filled_box(0, y + source_h, w - 1, h - 1, GRX_COLOR_WHITE);
+    }
+    if (x > 0) {
+        grx_draw_filled_box(0, y, x - 1, y + source_h - 1, GRX_COLOR_WHITE);
+    }
+    if (x + source_w < w) {
+        grx_draw_filled_box(x + source_w, y, w - 1, y + source_h - 1, GRX_COLOR_WHITE);
     }
 
-    mp_obj_t args[4] = { self_in, x, y, source_in };
-    mp_map_t kw_args;
-    mp_map_init(&kw_args, 0);
-    ev3dev_Image_draw_image(MP_ARRAY_SIZE(args), args, &kw_args);
+    mark_dirty_all(self);
+    self->print_x = 0;
+    self->print_y = 0;
 
     return mp_const_none;
 }
@@ -444,13 +687,14 @@ STATIC mp_obj_t ev3dev_Image_draw_text(size_t n_args, const mp_obj_t *pos_args,
     grx_set_current_context(self->context);
     grx_text_options_set_fg_color(self->text_options, text_color_);
     grx_text_options_set_bg_color(self->text_options, background_color_);
+    GrxFont *font = grx_text_options_get_font(self->text_options);
+    gint w = grx_font_get_text_width(font, text_);
+    gint h = grx_font_get_text_height(font, text_);
     if (background_color_ != GRX_COLOR_NONE) {
-        GrxFont *font = grx_text_options_get_font(self->text_options);
-        gint w = grx_font_get_text_width(font, text_);
-        gint h = grx_font_get_text_height(font, text_);
         grx_draw_filled_box(x_, y_, x_ + w - 1, y_ + h - 1, background_color_);
     }
     grx_draw_text(text_, x_, y_, self->text_options);
+    mark_dirty(self, x_, y_, x_ + w - 1, y_ + h - 1);
 
     return mp_const_none;
 }
@@ -529,12 +773,14 @@ STATIC mp_obj_t ev3dev_Image_print(size_t n_args, const mp_obj_t *pos_args, mp_m
                 }
             }
             self->print_y -= over;
+            mark_dirty_all(self);
         }
         gint w = grx_font_get_text_width(font, *l);
         gint h = grx_font_get_text_height(font, *l);
         grx_draw_filled_box(self->print_x, self->print_y,
             self->print_x + w - 1, self->print_y + h - 1, GRX_COLOR_WHITE);
         grx_draw_text(*l, self->print_x, self->print_y, self->text_options);
+        mark_dirty(self, self->print_x, self->print_y, self->print_x + w - 1, self->print_y + h - 1);
         self->print_x += w;
     }
     g_strfreev(lines);
@@ -543,6 +789,12 @@ STATIC mp_obj_t ev3dev_Image_print(size_t n_args, const mp_obj_t *pos_args, mp_m
 }
 MP_DEFINE_CONST_FUN_OBJ_KW(ev3dev_Image_print_obj, 1, ev3dev_Image_print);
 
+STATIC mp_obj_t ev3dev_Image_flush(mp_obj_t self_in) {
+    pb_type_ev3dev_Image_flush_screen();
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(ev3dev_Image_flush_obj, ev3dev_Image_flush);
+
 STATIC mp_obj_t ev3dev_Image_save(mp_obj_t self_in, mp_obj_t filename_in) {
     ev3dev_Image_obj_t *self = MP_OBJ_TO_PTR(self_in);
     const char *filename = mp_obj_str_get_str(filename_in);
@@ -557,6 +809,7 @@ STATIC mp_obj_t ev3dev_Image_save(mp_obj_t self_in, mp_obj_t filename_in) {
     GError *error = NULL;
     gboolean ok = grx_context_save_to_png(self->context, filename, &error);
     g_free(filename_ext);
+    image_cache_remove(filename_in);
     if (!ok) {
         mp_obj_t ex = mp_obj_new_exception_msg_varg(&mp_type_OSError,
             "Failed to save image: %s", error->message);
@@ -577,11 +830,13 @@ STATIC const mp_rom_map_elem_t ev3dev_Image_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_draw_box),    MP_ROM_PTR(&ev3dev_Image_draw_box_obj)                 },
     { MP_ROM_QSTR(MP_QSTR_draw_circle), MP_ROM_PTR(&ev3dev_Image_draw_circle_obj)              },
     { MP_ROM_QSTR(MP_QSTR_draw_image),  MP_ROM_PTR(&ev3dev_Image_draw_image_obj)               },
+    { MP_ROM_QSTR(MP_QSTR_blit),        MP_ROM_PTR(&ev3dev_Image_blit_obj)                     },
     { MP_ROM_QSTR(MP_QSTR_load_image),  MP_ROM_PTR(&ev3dev_Image_load_image_obj)               },
     { MP_ROM_QSTR(MP_QSTR_draw_text),   MP_ROM_PTR(&ev3dev_Image_draw_text_obj)                },
     { MP_ROM_QSTR(MP_QSTR_set_font),    MP_ROM_PTR(&ev3dev_Image_set_font_obj)                 },
     { MP_ROM_QSTR(MP_QSTR_print),       MP_ROM_PTR(&ev3dev_Image_print_obj)                    },
     { MP_ROM_QSTR(MP_QSTR_save),        MP_ROM_PTR(&ev3dev_Image_save_obj)                     },
+    { MP_ROM_QSTR(MP_QSTR_flush),       MP_ROM_PTR(&ev3dev_Image_flush_obj)                    },
     { MP_ROM_QSTR(MP_QSTR_width),       MP_ROM_ATTRIBUTE_OFFSET(ev3dev_Image_obj_t, width)     },
     { MP_ROM_QSTR(MP_QSTR_height),      MP_ROM_ATTRIBUTE_OFFSET(ev3dev_Image_obj_t, height)    },
 };
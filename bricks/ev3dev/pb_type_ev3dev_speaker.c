@@ -7,9 +7,14 @@
 //
 // There are two ways to create sounds. One is to use the "Beep" device to
 // create tones with a given frequency. This is done using the Linux input
-// device so that the sound is played on the EV3. The other is to use ALSA
-// for PCM playback of sampled sounds. To keep the code simple, we just
-// invoke `aplay` in a subprocess (same with espeak for text to speech).
+// device so that the sound is played on the EV3. Notes are played the same
+// way by a background process (see ev3dev_speaker_notes_process), so they
+// don't block the program. The other is to use ALSA for PCM playback of
+// sampled sounds. Sound files are decoded once and then played in-process
+// (see pbpcm.c), so they start right away. Files that can not be decoded are
+// played by `aplay` in a subprocess instead. Text to speech is rendered by
+// espeak once and then cached like sound files. The cache has a size limit,
+// so sounds that have not been used for a while are decoded again.
 
 #include <errno.h>
 #include <fcntl.h>
@@ -21,6 +26,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <contiki.h>
 #include <gio/gio.h>
 #include <glib.h>
 
@@ -30,8 +36,11 @@
 #include "py/runtime.h"
 
 #include "pb_ev3dev_types.h"
+#include "pberror.h"
+#include "pbinit.h"
 #include "pbkwarg.h"
 #include "pbobj.h"
+#include "pbpcm.h"
 
 #define EV3DEV_EV3_INPUT_DEV_PATH "/dev/input/by-path/platform-sound-event"
 
@@ -50,6 +59,8 @@ typedef struct _ev3dev_Speaker_obj_t {
     gboolean espeak_busy;
     gboolean espeak_result;
     GError *espeak_error;
+    GBytes *espeak_wav;
+    bool speech_cache;
     gboolean splice_busy;
     gssize splice_result;
     GError *splice_error;
@@ -61,6 +72,7 @@ STATIC ev3dev_Speaker_obj_t ev3dev_speaker_singleton;
 STATIC mp_obj_t ev3dev_Speaker_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args) {
     ev3dev_Speaker_obj_t *self = &ev3dev_speaker_singleton;
     if (!self->intialized) {
+        gint64 start = g_get_monotonic_time();
         self->base.type = &pb_type_ev3dev_Speaker;
         self->beep_fd = open(EV3DEV_EV3_INPUT_DEV_PATH, O_RDWR, 0);
         if (self->beep_fd == -1) {
@@ -84,6 +96,7 @@ STATIC mp_obj_t ev3dev_Speaker_make_new(const mp_obj_type_t *type, size_t n_args
         }
 
         self->intialized = true;
+        pybricks_report_startup_step("speaker", start);
     }
     return MP_OBJ_FROM_PTR(self);
 }
@@ -103,10 +116,82 @@ static int set_beep_frequency(ev3dev_Speaker_obj_t *self, int32_t freq) {
     return ret;
 }
 
-// This is used when there is an unhandled exception in a program to make sure
-// we stop beeping.
+// A note as played by the sequencer
+typedef struct _ev3dev_Speaker_note_t {
+    // Frequency (Hz) or 0 for a rest
+    uint16_t frequency;
+    // How long the note sounds (ms)
+    uint32_t on_time;
+    // Silence after the note, so that notes don't run together (ms)
+    uint32_t off_time;
+} ev3dev_Speaker_note_t;
+
+// Notes of the melody that is playing. This is not on the MicroPython heap,
+// since the sequencer keeps using it after play_notes() returns.
+STATIC GArray *notes_table;
+STATIC struct etimer notes_timer;
+
+PROCESS(ev3dev_speaker_notes_process, "speaker notes");
+
+// Plays the notes in notes_table. This runs in the pbio event loop, so the
+// melody keeps going while the program does other things. The timer is reset
+// from its previous deadline, so the tempo does not drift.
+PROCESS_THREAD(ev3dev_speaker_notes_process, ev, data) {
+    static guint index;
+    static ev3dev_Speaker_note_t *note;
+
+    PROCESS_BEGIN();
+
+    etimer_set(&notes_timer, 0);
+
+    for (index = 0; index < notes_table->len; index++) {
+        note = &g_array_index(notes_table, ev3dev_Speaker_note_t, index);
+
+        set_beep_frequency(&ev3dev_speaker_singleton, note->frequency);
+        etimer_reset_with_new_interval(&notes_timer, clock_from_msec(note->on_time));
+        PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_TIMER && data == &notes_timer);
+
+        if (note->off_time) {
+            set_beep_frequency(&ev3dev_speaker_singleton, 0);
+            etimer_reset_with_new_interval(&notes_timer, clock_from_msec(note->off_time));
+            PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_TIMER && data == &notes_timer);
+        }
+    }
+
+    // in case the last note has '_'
+    set_beep_frequency(&ev3dev_speaker_singleton, 0);
+
+    PROCESS_END();
+}
+
+// Stops the melody that is playing, if any
+STATIC void stop_notes(ev3dev_Speaker_obj_t *self) {
+    if (process_is_running(&ev3dev_speaker_notes_process)) {
+        process_exit(&ev3dev_speaker_notes_process);
+        set_beep_frequency(self, 0);
+    }
+}
+
+// This is used when there is an unhandled exception in a program or at the
+// end of the program to make sure we stop beeping.
 void _pb_ev3dev_speaker_beep_off() {
+    // Nothing to stop if the speaker was never used
+    if (!ev3dev_speaker_singleton.intialized) {
+        return;
+    }
+    stop_notes(&ev3dev_speaker_singleton);
     set_beep_frequency(&ev3dev_speaker_singleton, 0);
+    pb_pcm_stop();
+}
+
+// Sets the tone frequency. While a sound file is playing, the tone is mixed
+// with it, because the beep device would interrupt the sound.
+STATIC int set_tone(ev3dev_Speaker_obj_t *self, bool mix, int32_t freq) {
+    if (mix) {
+        pb_pcm_set_tone(freq);
+        return 0;
+    }
+    return set_beep_frequency(self, freq);
 }
 
 STATIC mp_obj_t ev3dev_Speaker_beep(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
@@ -117,8 +202,12 @@ STATIC mp_obj_t ev3dev_Speaker_beep(size_t n_args, const mp_obj_t *pos_args, mp_
 
     mp_int_t freq = pb_obj_get_int(frequency);
     mp_int_t ms = pb_obj_get_int(duration);
+    bool mix = pb_pcm_is_playing();
 
-    int ret = set_beep_frequency(self, freq);
+    // A beep replaces the melody, since they use the same device
+    stop_notes(self);
+
+    int ret = set_tone(self, mix, freq);
     if (ret == -1) {
         mp_raise_OSError(errno);
     }
@@ -130,10 +219,10 @@ STATIC mp_obj_t ev3dev_Speaker_beep(size_t n_args, const mp_obj_t *pos_args, mp_
     nlr_buf_t nlr;
     if (nlr_push(&nlr) == 0) {
         mp_hal_delay_ms(ms);
-        set_beep_frequency(self, 0);
+        set_tone(self, mix, 0);
         nlr_pop();
     } else {
-        set_beep_frequency(self, 0);
+        set_tone(self, mix, 0);
         nlr_jump(nlr.ret_val);
     }
 
@@ -141,7 +230,8 @@ STATIC mp_obj_t ev3dev_Speaker_beep(size_t n_args, const mp_obj_t *pos_args, mp_
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(ev3dev_Speaker_beep_obj, 1, ev3dev_Speaker_beep);
 
-STATIC void ev3dev_Speaker_play_note(ev3dev_Speaker_obj_t *self, mp_obj_t obj, int duration) {
+// Parses a note such as "C#4/8." and adds it to notes_table
+STATIC void ev3dev_Speaker_parse_note(mp_obj_t obj, int duration) {
     const char *note = mp_obj_str_get_str(obj);
     int pos = 0;
     double freq;
@@ -301,17 +391,36 @@ STATIC void ev3dev_Speaker_play_note(ev3dev_Speaker_obj_t *self, mp_obj_t obj, i
         pos--;
     }
 
-    set_beep_frequency(self, (int)freq);
+    ev3dev_Speaker_note_t parsed = {
+        .frequency = (uint16_t)freq,
+    };
 
     // Normally, we want there to be a period of no sound (release) so that
     // notes are distinct instead of running together. To sound good, the
     // release period is made proportional to duration of the note.
     if (release) {
-        mp_hal_delay_ms(7 * duration / 8);
-        set_beep_frequency(self, 0);
-        mp_hal_delay_ms(duration / 8);
+        parsed.on_time = 7 * duration / 8;
+        parsed.off_time = duration / 8;
+    } else {
+        parsed.on_time = duration;
+    }
+
+    g_array_append_val(notes_table, parsed);
+}
+
+// Waits for the melody to finish, stopping it on exceptions
+STATIC void ev3dev_Speaker_notes_wait(ev3dev_Speaker_obj_t *self) {
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        while (process_is_running(&ev3dev_speaker_notes_process)) {
+            // Sleep until the next note is due
+            int32_t delay = (int32_t)(etimer_expiration_time(&notes_timer) - clock_time());
+            mp_hal_delay_ms(clock_to_msec(MAX(delay, 1)));
+        }
+        nlr_pop();
     } else {
-        mp_hal_delay_ms(duration);
+        stop_notes(self);
+        nlr_jump(nlr.ret_val);
     }
 }
 
@@ -319,25 +428,32 @@ STATIC mp_obj_t ev3dev_Speaker_play_notes(size_t n_args, const mp_obj_t *pos_arg
     PB_PARSE_ARGS_METHOD(n_args, pos_args, kw_args,
         ev3dev_Speaker_obj_t, self,
         PB_ARG_REQUIRED(notes),
-        PB_ARG_DEFAULT_INT(tempo, 120));
+        PB_ARG_DEFAULT_INT(tempo, 120),
+        PB_ARG_DEFAULT_TRUE(wait));
 
     // length of whole note in milliseconds = 4 quarter/whole * 60 s/min * 1000 ms/s / tempo quarter/min
     int duration = 4 * 60 * 1000 / pb_obj_get_int(tempo);
 
-    nlr_buf_t nlr;
+    // A new melody replaces the one that is playing
+    stop_notes(self);
+
+    if (!notes_table) {
+        notes_table = g_array_new(FALSE, FALSE, sizeof(ev3dev_Speaker_note_t));
+    }
+    g_array_set_size(notes_table, 0);
+
+    // Parse all notes first, so that playing them takes no more work and
+    // invalid notes are found before anything is played.
     mp_obj_t item;
     mp_obj_t iterable = mp_getiter(notes, NULL);
-    if (nlr_push(&nlr) == 0) {
-        while ((item = mp_iternext(iterable)) != MP_OBJ_STOP_ITERATION) {
-            ev3dev_Speaker_play_note(self, item, duration);
-        }
-        // in case the last note has '_'
-        set_beep_frequency(self, 0);
-        nlr_pop();
-    } else {
-        // ensure that sound stops if an exception is raised
-        set_beep_frequency(self, 0);
-        nlr_jump(nlr.ret_val);
+    while ((item = mp_iternext(iterable)) != MP_OBJ_STOP_ITERATION) {
+        ev3dev_Speaker_parse_note(item, duration);
+    }
+
+    process_start(&ev3dev_speaker_notes_process, NULL);
+
+    if (mp_obj_is_true(wait)) {
+        ev3dev_Speaker_notes_wait(self);
     }
 
     return mp_const_none;
@@ -352,13 +468,41 @@ STATIC void ev3dev_Speaker_aplay_callback(GObject *source_object, GAsyncResult *
     self->aplay_busy = FALSE;
 }
 
+// Waits for the in-process sound to finish, stopping it on exceptions
+STATIC void ev3dev_Speaker_pcm_wait(void) {
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        // The playback thread wakes up the glib main loop when done
+        while (pb_pcm_is_playing()) {
+            MICROPY_EVENT_POLL_HOOK
+        }
+        nlr_pop();
+    } else {
+        pb_pcm_stop();
+        nlr_jump(nlr.ret_val);
+    }
+}
+
 STATIC mp_obj_t ev3dev_Speaker_play_file(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
     PB_PARSE_ARGS_METHOD(n_args, pos_args, kw_args,
         ev3dev_Speaker_obj_t, self,
-        PB_ARG_REQUIRED(file));
+        PB_ARG_REQUIRED(file),
+        PB_ARG_DEFAULT_TRUE(wait));
 
     const char *path = mp_obj_str_get_str(file);
 
+    // Play in-process if the file can be decoded
+    pb_pcm_sound_t *sound;
+    if (pb_pcm_init() == PBIO_SUCCESS && pb_pcm_load_wav(path, &sound) == PBIO_SUCCESS) {
+        pb_assert(pb_pcm_play(sound));
+        if (mp_obj_is_true(wait)) {
+            ev3dev_Speaker_pcm_wait();
+        }
+        return mp_const_none;
+    }
+
+    // Otherwise, let aplay deal with it. This always waits.
+
     // FIXME: This function needs to be protected agains re-entrancy to make it
     // thread-safe.
 
@@ -441,13 +585,136 @@ STATIC void ev3dev_Speaker_splice_callback(GObject *source_object, GAsyncResult
     self->splice_busy = FALSE;
 }
 
-STATIC mp_obj_t ev3dev_Speaker_say(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
-    PB_PARSE_ARGS_METHOD(n_args, pos_args, kw_args,
-        ev3dev_Speaker_obj_t, self,
-        PB_ARG_REQUIRED(text));
+STATIC void ev3dev_Speaker_communicate_callback(GObject *source_object, GAsyncResult *res, gpointer user_data) {
+    GSubprocess *subprocess = G_SUBPROCESS(source_object);
+    ev3dev_Speaker_obj_t *self = user_data;
+    g_clear_error(&self->espeak_error);
+    g_clear_pointer(&self->espeak_wav, g_bytes_unref);
+    self->espeak_result = g_subprocess_communicate_finish(subprocess, res,
+        &self->espeak_wav, NULL, &self->espeak_error);
+    self->espeak_busy = FALSE;
+}
 
-    const char *text_ = mp_obj_str_get_str(text);
+// Runs espeak to get the spoken text as a WAV file in memory. The caller must
+// free the result with g_bytes_unref().
+STATIC GBytes *ev3dev_Speaker_render_speech(ev3dev_Speaker_obj_t *self, const char *text_) {
+    GError *error = NULL;
+    GSubprocess *espeak = g_subprocess_new(
+        G_SUBPROCESS_FLAGS_STDOUT_PIPE | G_SUBPROCESS_FLAGS_STDERR_SILENCE,
+        &error, "espeak", "-a", "200", "-v", self->voice_setting, "-s", self->speed,
+        "-p", self->pitch, "--stdout", text_, NULL);
+    if (!espeak) {
+        // This error is unexpected, so doesn't need to be "user-friendly"
+        mp_obj_t ex = mp_obj_new_exception_msg_varg(&mp_type_RuntimeError,
+            "Failed to spawn espeak: %s", error->message);
+        g_error_free(error);
+        nlr_raise(ex);
+    }
+
+    self->espeak_busy = TRUE;
+    g_subprocess_communicate_async(espeak, NULL, NULL, ev3dev_Speaker_communicate_callback, self);
+
+    // Same as in play_file, keep running the event loop until espeak is done.
+    mp_obj_t exception = MP_OBJ_NULL;
+    nlr_buf_t nlr;
+    do {
+        if (nlr_push(&nlr) == 0) {
+            MICROPY_EVENT_POLL_HOOK
+            nlr_pop();
+        } else {
+            g_subprocess_force_exit(espeak);
+            exception = MP_OBJ_FROM_PTR(nlr.ret_val);
+        }
+    } while (self->espeak_busy);
 
+    gboolean success = self->espeak_result && g_subprocess_get_successful(espeak);
+    g_object_unref(espeak);
+
+    GBytes *wav = self->espeak_wav;
+    self->espeak_wav = NULL;
+
+    if (exception != MP_OBJ_NULL) {
+        if (wav) {
+            g_bytes_unref(wav);
+        }
+        nlr_raise(exception);
+    }
+
+    if (!success) {
+        if (wav) {
+            g_bytes_unref(wav);
+        }
+        return NULL;
+    }
+
+    return wav;
+}
+
+// Gets the spoken text as a decoded sound. Sounds are cached in memory by the
+// text and the speech options, so espeak only runs the first time. If the disk
+// cache is enabled, rendered speech is also saved as a WAV file, so it is
+// there for the next program as well.
+STATIC bool ev3dev_Speaker_get_speech(ev3dev_Speaker_obj_t *self, const char *text_, pb_pcm_sound_t **sound) {
+    if (pb_pcm_init() != PBIO_SUCCESS) {
+        return false;
+    }
+
+    gchar *key = g_strdup_printf("%s/%s/%s/%s", self->voice_setting, self->speed, self->pitch, text_);
+    *sound = pb_pcm_lookup(key);
+    if (*sound) {
+        g_free(key);
+        return true;
+    }
+
+    gchar *path = NULL;
+    if (self->speech_cache) {
+        gchar *name = g_compute_checksum_for_string(G_CHECKSUM_SHA1, key, -1);
+        gchar *file_name = g_strconcat(name, ".wav", NULL);
+        path = g_build_filename(g_get_user_cache_dir(), "pybricks", "speech", file_name, NULL);
+        g_free(file_name);
+        g_free(name);
+
+        if (pb_pcm_load_wav(path, sound) == PBIO_SUCCESS) {
+            g_free(path);
+            g_free(key);
+            return true;
+        }
+    }
+
+    GBytes *wav = NULL;
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        wav = ev3dev_Speaker_render_speech(self, text_);
+        nlr_pop();
+    } else {
+        g_free(path);
+        g_free(key);
+        nlr_jump(nlr.ret_val);
+    }
+
+    bool ok = false;
+    if (wav) {
+        gsize size;
+        const uint8_t *data = g_bytes_get_data(wav, &size);
+        ok = pb_pcm_add_wav(key, data, size, sound) == PBIO_SUCCESS;
+
+        // Failing to save is not an error, it only means it is not cached
+        if (ok && path) {
+            gchar *dir = g_path_get_dirname(path);
+            if (g_mkdir_with_parents(dir, 0755) == 0) {
+                g_file_set_contents(path, (const gchar *)data, size, NULL);
+            }
+            g_free(dir);
+        }
+        g_bytes_unref(wav);
+    }
+
+    g_free(path);
+    g_free(key);
+    return ok;
+}
+
+STATIC void ev3dev_Speaker_say_aplay(ev3dev_Speaker_obj_t *self, const char *text_) {
     // FIXME: This function needs to be protected agains re-entrancy to make it
     // thread-safe.
 
@@ -555,18 +822,56 @@ STATIC mp_obj_t ev3dev_Speaker_say(size_t n_args, const mp_obj_t *pos_args, mp_m
 
     g_object_unref(aplay);
     g_object_unref(espeak);
+}
+
+STATIC mp_obj_t ev3dev_Speaker_say(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    PB_PARSE_ARGS_METHOD(n_args, pos_args, kw_args,
+        ev3dev_Speaker_obj_t, self,
+        PB_ARG_REQUIRED(text),
+        PB_ARG_DEFAULT_TRUE(wait));
+
+    const char *text_ = mp_obj_str_get_str(text);
+
+    // Play in-process if the speech can be decoded
+    pb_pcm_sound_t *sound;
+    if (ev3dev_Speaker_get_speech(self, text_, &sound)) {
+        pb_assert(pb_pcm_play(sound));
+        if (mp_obj_is_true(wait)) {
+            ev3dev_Speaker_pcm_wait();
+        }
+        return mp_const_none;
+    }
+
+    // Otherwise, pipe espeak into aplay. This always waits.
+    ev3dev_Speaker_say_aplay(self, text_);
 
     return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(ev3dev_Speaker_say_obj, 1, ev3dev_Speaker_say);
 
+STATIC mp_obj_t ev3dev_Speaker_prepare_say(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    PB_PARSE_ARGS_METHOD(n_args, pos_args, kw_args,
+        ev3dev_Speaker_obj_t, self,
+        PB_ARG_REQUIRED(text));
+
+    // Renders the speech now, so that say() can start right away later on. If
+    // it can't be rendered, say() falls back to aplay, so there is nothing to
+    // prepare.
+    pb_pcm_sound_t *sound;
+    ev3dev_Speaker_get_speech(self, mp_obj_str_get_str(text), &sound);
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(ev3dev_Speaker_prepare_say_obj, 1, ev3dev_Speaker_prepare_say);
+
 STATIC mp_obj_t ev3dev_Speaker_set_speech_options(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
     PB_PARSE_ARGS_METHOD(n_args, pos_args, kw_args,
         ev3dev_Speaker_obj_t, self,
         PB_ARG_DEFAULT_NONE(language),
         PB_ARG_DEFAULT_NONE(voice),
         PB_ARG_DEFAULT_NONE(speed),
-        PB_ARG_DEFAULT_NONE(pitch));
+        PB_ARG_DEFAULT_NONE(pitch),
+        PB_ARG_DEFAULT_NONE(cache));
 
     if (language != mp_const_none) {
         strncpy(self->language, mp_obj_str_get_str(language), sizeof(self->language));
@@ -582,6 +887,9 @@ STATIC mp_obj_t ev3dev_Speaker_set_speech_options(size_t n_args, const mp_obj_t
     if (pitch != mp_const_none) {
         snprintf(self->pitch, sizeof(self->pitch), INT_FMT, pb_obj_get_int(pitch));
     }
+    if (cache != mp_const_none) {
+        self->speech_cache = mp_obj_is_true(cache);
+    }
 
     return mp_const_none;
 }
@@ -658,6 +966,7 @@ STATIC const mp_rom_map_elem_t ev3dev_Speaker_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_play_notes),          MP_ROM_PTR(&ev3dev_Speaker_play_notes_obj)          },
     { MP_ROM_QSTR(MP_QSTR_play_file),           MP_ROM_PTR(&ev3dev_Speaker_play_file_obj)           },
     { MP_ROM_QSTR(MP_QSTR_say),                 MP_ROM_PTR(&ev3dev_Speaker_say_obj)                 },
+    { MP_ROM_QSTR(MP_QSTR_prepare_say),         MP_ROM_PTR(&ev3dev_Speaker_prepare_say_obj)         },
     { MP_ROM_QSTR(MP_QSTR_set_speech_options),  MP_ROM_PTR(&ev3dev_Speaker_set_speech_options_obj)  },
     { MP_ROM_QSTR(MP_QSTR_set_volume),          MP_ROM_PTR(&ev3dev_Speaker_set_volume_obj)          },
 };
@@ -5,6 +5,7 @@
 
 #include "pberror.h"
 #include "pbdevice.h"
+#include "pbinit.h"
 
 #include <pbio/config.h>
 
@@ -13,6 +14,7 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <pbdrv/ioport.h>
 #include <pbio/port.h>
 #include <pbio/iodev.h>
 
@@ -40,6 +42,14 @@ struct _pbdevice_t {
      * Data type for current mode
      */
     lego_sensor_data_type_t data_type;
+    /**
+     * Time (us) of the most recent sample, for devices without a lego_sensor
+     */
+    uint32_t timestamp;
+    /**
+     * Sequence number of the most recent sample, for devices without a lego_sensor
+     */
+    uint32_t data_seq;
     /**
      * Platform specific low-level device abstraction
      */
@@ -48,6 +58,15 @@ struct _pbdevice_t {
 
 pbdevice_t iodevices[4];
 
+// How long to keep trying to get a device that is being set up (ms)
+#define DEVICE_WAIT_TIMEOUT (15000)
+
+// Delay between tries to get the device (ms)
+#define DEVICE_RETRY_MIN_DELAY (50)
+#define DEVICE_RETRY_MAX_DELAY (1000)
+// How often to check for udev events while waiting between retries (ms)
+#define DEVICE_CHANGE_POLL_INTERVAL (10)
+
 // Get an ev3dev sensor
 static pbio_error_t get_device(pbdevice_t **pbdev, pbio_iodev_type_id_t valid_id, pbio_port_t port) {
     if (port < PBIO_PORT_1 || port > PBIO_PORT_4) {
@@ -115,7 +134,12 @@ static pbio_error_t get_values(pbdevice_t *pbdev, uint8_t mode, int32_t *values)
 
     // The NXT Color Sensor is a special case, so deal with it accordingly
     if (pbdev->type_id == PBIO_IODEV_TYPE_ID_NXT_COLOR_SENSOR) {
-        return nxtcolor_get_values_at_mode(pbdev->port, mode, values);
+        pbio_error_t err = nxtcolor_get_values_at_mode(pbdev->port, mode, values);
+        if (err == PBIO_SUCCESS) {
+            pbdev->timestamp = mp_hal_ticks_us();
+            pbdev->data_seq++;
+        }
+        return err;
     }
 
     pbio_error_t err;
@@ -184,26 +208,52 @@ static pbio_error_t get_values(pbdevice_t *pbdev, uint8_t mode, int32_t *values)
     return PBIO_SUCCESS;
 }
 
+// Waits for the given time (ms), but returns early if udev reports that a
+// device was added, removed or changed in the meantime.
+static void wait_for_device_change(uint32_t delay) {
+    uint32_t generation = pbdrv_ioport_ev3dev_get_generation();
+    uint32_t time_start = mp_hal_ticks_ms();
+    while (mp_hal_ticks_ms() - time_start < delay) {
+        mp_hal_delay_ms(DEVICE_CHANGE_POLL_INTERVAL);
+        if (pbdrv_ioport_ev3dev_get_generation() != generation) {
+            return;
+        }
+    }
+}
+
 pbdevice_t *pbdevice_get_device(pbio_port_t port, pbio_iodev_type_id_t valid_id) {
     pbdevice_t *pbdev = NULL;
     pbio_error_t err;
 
+    gint64 start = g_get_monotonic_time();
+
     // Try to get the device
     err = get_device(&pbdev, valid_id, port);
 
     // FIXME: Reading port mode is not enough confirmation that we are done,
-    // So we cannot wait until PBIO_ERROR_AGAIN disappears. Use udev instead.
-    // For now, just wait a little longer before giving up.
+    // So we cannot wait until PBIO_ERROR_AGAIN disappears. Instead, keep
+    // trying until the device shows up or the time is up. The delay between
+    // tries grows, so that devices that are ready soon don't have to wait
+    // long, without opening the sysfs files too often. A udev event for any
+    // device cuts the delay short, since it is likely the one we wait for.
     if (err == PBIO_ERROR_AGAIN) {
-        for (uint8_t i = 0; i < 5; i++) {
+        uint32_t delay = DEVICE_RETRY_MIN_DELAY;
+        uint32_t time_start = mp_hal_ticks_ms();
+        while (mp_hal_ticks_ms() - time_start < DEVICE_WAIT_TIMEOUT) {
+            wait_for_device_change(delay);
             err = get_device(&pbdev, valid_id, port);
             if (err == PBIO_SUCCESS) {
                 break;
             }
-            mp_hal_delay_ms(1000 * (i + 1));
+            delay = MIN(delay * 2, DEVICE_RETRY_MAX_DELAY);
         }
     }
     pb_assert(err);
+
+    char step[32];
+    snprintf(step, sizeof(step), "device on port %c", port);
+    pybricks_report_startup_step(step, start);
+
     return pbdev;
 }
 void pbdevice_get_values(pbdevice_t *pbdev, uint8_t mode, int32_t *values) {
@@ -214,6 +264,15 @@ void pbdevice_get_values(pbdevice_t *pbdev, uint8_t mode, int32_t *values) {
     pb_assert(err);
 }
 
+pbio_error_t pbdevice_get_values_nowait(pbdevice_t *pbdev, uint8_t mode, int32_t *values) {
+    // Changing modes and reading the NXT Color Sensor have to wait, so that
+    // is left to pbdevice_get_values()
+    if (pbdev->type_id == PBIO_IODEV_TYPE_ID_NXT_COLOR_SENSOR || pbdev->mode != mode) {
+        return PBIO_ERROR_INVALID_OP;
+    }
+    return get_values(pbdev, mode, values);
+}
+
 void pbdevice_set_values(pbdevice_t *pbdev, uint8_t mode, int32_t *values, uint8_t num_values) {
     pb_assert(PBIO_ERROR_NOT_SUPPORTED);
 }
@@ -229,6 +288,15 @@ void pbdevice_get_info(pbdevice_t *pbdev, pbio_port_t *port, pbio_iodev_type_id_
     *num_values = pbdev->data_len;
 }
 
+void pbdevice_get_timestamp(pbdevice_t *pbdev, uint32_t *timestamp, uint32_t *seq) {
+    if (pbdev->type_id == PBIO_IODEV_TYPE_ID_NXT_COLOR_SENSOR) {
+        *timestamp = pbdev->timestamp;
+        *seq = pbdev->data_seq;
+        return;
+    }
+    lego_sensor_get_timestamp(pbdev->sensor, timestamp, seq);
+}
+
 int8_t pbdevice_get_mode_id_from_str(pbdevice_t *pbdev, const char *mode_str) {
     uint8_t mode;
     pb_assert(lego_sensor_get_mode_id_from_str(pbdev->sensor, mode_str, &mode));
@@ -12,47 +12,80 @@
 #include <sys/time.h>
 #include <sys/timerfd.h>
 
+#include <contiki.h>
 #include <glib.h>
 #include <grx-3.0.h>
 
 #include <pbio/config.h>
 #include <pbio/main.h>
 #include <pbio/light.h>
+#include <pbio/motorpoll.h>
 
 #include "py/mpconfig.h"
 #include "py/mpthread.h"
+#include "py/runtime.h"
 
+#include "pb_ev3dev_types.h"
 #include "pbinit.h"
+#include "pbmotorevent.h"
+#include "pbpcm.h"
 
 // Flag that indicates whether we are busy stopping the thread
 static volatile bool stopping_thread = false;
 static pthread_t task_caller_thread;
 
-// The background thread that keeps firing the task handler
+// The background thread that keeps firing the task handler. There is no
+// clock tick interrupt on ev3dev, so this thread requests the etimer poll
+// itself and then sleeps until the next etimer deadline.
 static void *task_caller(void *arg) {
     struct timespec ts;
-    ts.tv_sec = 0;
-    ts.tv_nsec = PBIO_CONFIG_SERVO_PERIOD_MS * 1000000;
+    int32_t delay;
 
     while (!stopping_thread) {
         MP_THREAD_GIL_ENTER();
+        etimer_request_poll();
         while (pbio_do_one_event()) {
         }
+        delay = PBIO_CONFIG_SERVO_PERIOD_MS;
+        if (etimer_pending()) {
+            delay = (int32_t)(etimer_next_expiration_time() - clock_time());
+            if (delay < 0) {
+                delay = 0;
+            } else if (delay > PBIO_CONFIG_SERVO_PERIOD_MS) {
+                delay = PBIO_CONFIG_SERVO_PERIOD_MS;
+            }
+        }
         MP_THREAD_GIL_EXIT();
 
+        ts.tv_sec = 0;
+        ts.tv_nsec = delay * 1000000;
         clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, NULL);
     }
 
     return NULL;
 }
 
-// Pybricks initialization tasks
-void pybricks_init() {
-    GError *error = NULL;
-    if (!grx_set_mode_default_graphics(FALSE, &error)) {
-        fprintf(stderr, "Could not initialize graphics. Be sure to run using `brickrun -r -- pybricks-micropython`.\n");
-        exit(1);
+// Set by PYBRICKS_STARTUP_REPORT in the environment
+static bool startup_report;
+// Time at which pybricks_init() was called (us)
+static gint64 startup_time;
+
+static bool graphics_initialized;
+
+// Prints how long a startup step took if PYBRICKS_STARTUP_REPORT is set.
+// Steps that are done on first use are included, so the report shows what
+// each program actually waited for.
+void pybricks_report_startup_step(const char *step, gint64 step_start) {
+    if (!startup_report) {
+        return;
     }
+    gint64 now = g_get_monotonic_time();
+    fprintf(stderr, "startup: %-24s %8.1f ms (at %8.1f ms)\n", step,
+        (now - step_start) / 1000.0, (now - startup_time) / 1000.0);
+}
+
+// Draws the Pybricks logo in the middle of the screen
+static void draw_logo(void) {
     grx_clear_screen(GRX_COLOR_WHITE);
 
     // Screen center
@@ -91,18 +124,58 @@ void pybricks_init() {
         }
     };
     grx_draw_filled_convex_polygon(3, triangle, GRX_COLOR_BLACK);
+}
+
+// Sets up the screen the first time that anything needs it. Setting the
+// graphics mode takes a large part of the startup time, and programs that
+// don't use the screen or images don't need it at all.
+void pybricks_init_graphics(void) {
+    if (graphics_initialized) {
+        return;
+    }
+    gint64 start = g_get_monotonic_time();
+    GError *error = NULL;
+    if (!grx_set_mode_default_graphics(FALSE, &error)) {
+        g_error_free(error);
+        mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("Could not initialize graphics. Be sure to run using `brickrun -r -- pybricks-micropython`."));
+    }
+    graphics_initialized = true;
+    draw_logo();
+    pybricks_report_startup_step("graphics", start);
+}
+
+// Pybricks initialization tasks. Graphics, sound and devices are set up when
+// they are first used instead of here.
+void pybricks_init() {
+    startup_time = g_get_monotonic_time();
+    startup_report = getenv("PYBRICKS_STARTUP_REPORT") != NULL;
 
+    gint64 start = g_get_monotonic_time();
     pbio_init();
     pbio_light_on_with_pattern(PBIO_PORT_SELF, PBIO_LIGHT_COLOR_GREEN, PBIO_LIGHT_PATTERN_BREATHE); // TODO: define PBIO_LIGHT_PATTERN_EV3_RUN (Or, discuss if we want to use breathe for EV3, too)
+    pybricks_report_startup_step("pbio", start);
+
+    start = g_get_monotonic_time();
     pthread_create(&task_caller_thread, NULL, task_caller, NULL);
+    pb_motor_event_start();
+    pybricks_report_startup_step("control thread", start);
 }
 
 // Pybricks deinitialization tasks
 void pybricks_deinit() {
+    // Show anything that was drawn after the last automatic screen update
+    pb_type_ev3dev_Image_flush_screen();
+
+    // Stop melodies that were started without waiting for them
+    extern void _pb_ev3dev_speaker_beep_off();
+    _pb_ev3dev_speaker_beep_off();
+
     // Signal motor thread to stop and wait for it to do so.
+    pb_motor_event_stop();
     stopping_thread = true;
     pthread_join(task_caller_thread, NULL);
     pbio_deinit();
+    pb_pcm_deinit();
 }
 
 void pybricks_unhandled_exception() {
@@ -4,8 +4,16 @@
 #ifndef MICROPY_INCLUDED_PBINIT_H
 #define MICROPY_INCLUDED_PBINIT_H
 
+#include <stdint.h>
+
+#include <glib.h>
+
 void pybricks_init();
 
 void pybricks_deinit();
 
+void pybricks_init_graphics(void);
+
+void pybricks_report_startup_step(const char *step, gint64 step_start);
+
 #endif // MICROPY_INCLUDED_PBINIT_H
@@ -0,0 +1,491 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <alsa/asoundlib.h>
+#include <glib.h>
+
+#include <pbio/error.h>
+
+#include "pbpcm.h"
+
+// Number of frames mixed and written at a time (about 12 ms)
+#define PERIOD_FRAMES (256)
+
+// Total latency of the sound device buffer (us)
+#define DEVICE_LATENCY_US (25000)
+
+// Amplitude of the tone, which is about as loud as the beep device
+#define TONE_AMPLITUDE (6000)
+
+// Total size of the decoded samples in the cache (bytes). This is about a
+// minute and a half of sound. Programs that say many different phrases, like
+// measured values, would otherwise run the brick out of memory.
+#define CACHE_MAX_SIZE (4 * 1024 * 1024)
+
+struct _pb_pcm_sound_t {
+    int16_t *samples; // Mono samples at PB_PCM_RATE
+    uint32_t num_samples;
+    gchar *key; // Key in the cache, if the sound is in it
+    GList *link; // Link in cache_lru
+};
+
+static snd_pcm_t *pcm;
+static pthread_t pcm_thread;
+static bool stopping;
+
+// Decoded sounds by file path or other key
+static GHashTable *cache;
+// Cached sounds with the most recently used first
+static GQueue cache_lru = G_QUEUE_INIT;
+// Size of all cached samples (bytes)
+static gsize cache_size;
+
+// Everything below is shared with the playback thread and protected by lock
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static pb_pcm_sound_t *sample_sound;
+static uint32_t sample_pos;
+// Time at which the last sound that was mixed is done playing from the
+// device buffer, or 0 if there is no such sound (monotonic, us)
+static gint64 sample_end_time;
+static uint32_t tone_step;
+static uint32_t tone_phase;
+
+static bool is_active(void) {
+    return sample_sound != NULL || tone_step != 0;
+}
+
+// Mixes the sample and the tone into one period
+static void mix(int16_t *buf, uint32_t frames) {
+    for (uint32_t i = 0; i < frames; i++) {
+        int32_t value = 0;
+
+        if (sample_sound) {
+            value += sample_sound->samples[sample_pos++];
+            if (sample_pos >= sample_sound->num_samples) {
+                sample_sound = NULL;
+            }
+        }
+
+        if (tone_step) {
+            value += (tone_phase & 0x80000000) ? TONE_AMPLITUDE : -TONE_AMPLITUDE;
+            tone_phase += tone_step;
+        }
+
+        buf[i] = value > INT16_MAX ? INT16_MAX : (value < INT16_MIN ? INT16_MIN : value);
+    }
+}
+
+// Waits for a change or until the given monotonic time. Must be called with
+// the lock held.
+static void wait_until(gint64 end_time) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    gint64 delay = MAX(end_time - g_get_monotonic_time(), 0);
+    deadline.tv_sec += delay / G_USEC_PER_SEC;
+    deadline.tv_nsec += (delay % G_USEC_PER_SEC) * 1000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    pthread_cond_timedwait(&wake, &lock, &deadline);
+}
+
+static void *pcm_thread_func(void *arg) {
+    int16_t buf[PERIOD_FRAMES];
+
+    pthread_mutex_lock(&lock);
+    while (!stopping) {
+        // Let waiting programs know when the last sound has left the device.
+        // They wait in the glib main loop, so wake it up.
+        if (sample_end_time && g_get_monotonic_time() >= sample_end_time) {
+            sample_end_time = 0;
+            g_main_context_wakeup(g_main_context_default());
+        }
+
+        // Sleep until there is something to play, instead of feeding the
+        // device with silence. The device underruns meanwhile, which is
+        // recovered from on the next write.
+        if (!is_active()) {
+            if (sample_end_time) {
+                wait_until(sample_end_time);
+            } else {
+                pthread_cond_wait(&wake, &lock);
+            }
+            continue;
+        }
+
+        bool had_sample = sample_sound != NULL;
+        mix(buf, PERIOD_FRAMES);
+        bool sample_done = had_sample && sample_sound == NULL;
+        pthread_mutex_unlock(&lock);
+
+        // This blocks until the device has room, which paces the thread
+        snd_pcm_sframes_t ret = snd_pcm_writei(pcm, buf, PERIOD_FRAMES);
+        if (ret < 0 && snd_pcm_recover(pcm, ret, 1) == 0) {
+            snd_pcm_writei(pcm, buf, PERIOD_FRAMES);
+        }
+
+        // The end of the sound is still in the device buffer, so find out
+        // how long until it has been played.
+        snd_pcm_sframes_t delay = 0;
+        if (sample_done && snd_pcm_delay(pcm, &delay) < 0) {
+            delay = (snd_pcm_sframes_t)DEVICE_LATENCY_US * PB_PCM_RATE / G_USEC_PER_SEC;
+        }
+
+        pthread_mutex_lock(&lock);
+        if (sample_done && sample_sound == NULL) {
+            sample_end_time = g_get_monotonic_time() + (gint64)MAX(delay, 0) * G_USEC_PER_SEC / PB_PCM_RATE;
+            // Never zero, since that means there is no sound
+            sample_end_time = MAX(sample_end_time, 1);
+        }
+    }
+    pthread_mutex_unlock(&lock);
+
+    snd_pcm_drop(pcm);
+
+    return NULL;
+}
+
+/**
+ * Opens the sound device and starts the playback thread. It is safe to call
+ * this more than once.
+ * @return              ::PBIO_SUCCESS or ::PBIO_ERROR_IO if there is no
+ *                      usable sound device.
+ */
+pbio_error_t pb_pcm_init(void) {
+    if (pcm) {
+        return PBIO_SUCCESS;
+    }
+
+    if (snd_pcm_open(&pcm, "default", SND_PCM_STREAM_PLAYBACK, 0) < 0) {
+        pcm = NULL;
+        return PBIO_ERROR_IO;
+    }
+
+    if (snd_pcm_set_params(pcm, SND_PCM_FORMAT_S16, SND_PCM_ACCESS_RW_INTERLEAVED,
+        1, PB_PCM_RATE, 1, DEVICE_LATENCY_US) < 0) {
+        snd_pcm_close(pcm);
+        pcm = NULL;
+        return PBIO_ERROR_IO;
+    }
+
+    stopping = false;
+    if (pthread_create(&pcm_thread, NULL, pcm_thread_func, NULL) != 0) {
+        snd_pcm_close(pcm);
+        pcm = NULL;
+        return PBIO_ERROR_IO;
+    }
+
+    cache = g_hash_table_new(g_str_hash, g_str_equal);
+
+    return PBIO_SUCCESS;
+}
+
+// Frees all cached sounds and the cache itself
+static void free_cache(void) {
+    pb_pcm_sound_t *sound;
+    while ((sound = g_queue_pop_head(&cache_lru))) {
+        g_free(sound->key);
+        g_free(sound->samples);
+        g_free(sound);
+    }
+    g_hash_table_destroy(cache);
+    cache = NULL;
+    cache_size = 0;
+}
+
+/**
+ * Stops the playback thread, closes the sound device and frees the cached
+ * sounds. pb_pcm_init() may be called again afterwards.
+ */
+void pb_pcm_deinit(void) {
+    if (!pcm) {
+        return;
+    }
+
+    pthread_mutex_lock(&lock);
+    stopping = true;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&lock);
+    pthread_join(pcm_thread, NULL);
+
+    snd_pcm_close(pcm);
+    pcm = NULL;
+
+    // Nothing plays any more, so the sounds can go
+    sample_sound = NULL;
+    free_cache();
+}
+
+static uint16_t get_u16(const uint8_t *data) {
+    return data[0] | data[1] << 8;
+}
+
+static uint32_t get_u32(const uint8_t *data) {
+    return data[0] | data[1] << 8 | data[2] << 16 | (uint32_t)data[3] << 24;
+}
+
+/**
+ * Decodes a WAV file in memory into a new sound. Sounds are converted to mono
+ * at ::PB_PCM_RATE, so that playing them needs no further conversion.
+ * @param [in]  wav     The contents of the WAV file
+ * @param [in]  size    The size of @p wav
+ * @param [out] sound   The new sound
+ * @return              ::PBIO_SUCCESS, ::PBIO_ERROR_INVALID_ARG if this is
+ *                      not a WAV file or ::PBIO_ERROR_NOT_SUPPORTED if it is
+ *                      not 8 or 16-bit PCM.
+ */
+pbio_error_t pb_pcm_new_sound(const uint8_t *wav, uint32_t size, pb_pcm_sound_t **sound) {
+    if (size < 12 || memcmp(wav, "RIFF", 4) != 0 || memcmp(wav + 8, "WAVE", 4) != 0) {
+        return PBIO_ERROR_INVALID_ARG;
+    }
+
+    uint16_t channels = 0;
+    uint16_t bits = 0;
+    uint32_t rate = 0;
+    const uint8_t *data = NULL;
+    uint32_t data_size = 0;
+
+    // Find the format and data chunks
+    uint32_t pos = 12;
+    while (pos + 8 <= size) {
+        uint32_t chunk_size = get_u32(wav + pos + 4);
+        const uint8_t *chunk = wav + pos + 8;
+        // Data written to a pipe, like espeak does, has an unknown size
+        if (chunk_size > size - pos - 8) {
+            chunk_size = size - pos - 8;
+        }
+
+        if (memcmp(wav + pos, "fmt ", 4) == 0 && chunk_size >= 16) {
+            if (get_u16(chunk) != 1) {
+                // Not PCM
+                return PBIO_ERROR_NOT_SUPPORTED;
+            }
+            channels = get_u16(chunk + 2);
+            rate = get_u32(chunk + 4);
+            bits = get_u16(chunk + 14);
+        } else if (memcmp(wav + pos, "data", 4) == 0) {
+            data = chunk;
+            data_size = chunk_size;
+            break;
+        }
+
+        // Chunks are padded to an even size
+        pos += 8 + chunk_size + (chunk_size & 1);
+    }
+
+    if (data == NULL || channels == 0 || rate == 0) {
+        return PBIO_ERROR_INVALID_ARG;
+    }
+    if (bits != 8 && bits != 16) {
+        return PBIO_ERROR_NOT_SUPPORTED;
+    }
+
+    uint32_t frame_size = channels * bits / 8;
+    uint32_t num_frames = data_size / frame_size;
+
+    pb_pcm_sound_t *new_sound = g_new0(pb_pcm_sound_t, 1);
+    new_sound->num_samples = (uint64_t)num_frames * PB_PCM_RATE / rate;
+    new_sound->samples = g_new(int16_t, new_sound->num_samples);
+
+    for (uint32_t i = 0; i < new_sound->num_samples; i++) {
+        // Linear interpolation between the two nearest source frames,
+        // with the position in 16.16 fixed point.
+        uint64_t src = ((uint64_t)i * rate << 16) / PB_PCM_RATE;
+        uint32_t index = src >> 16;
+        uint32_t frac = src & 0xFFFF;
+
+        int32_t values[2];
+        for (int j = 0; j < 2; j++) {
+            const uint8_t *frame = data + MIN(index + j, num_frames - 1) * frame_size;
+            int32_t sum = 0;
+            for (uint16_t c = 0; c < channels; c++) {
+                sum += bits == 8 ? (frame[c] - 128) * 256 : (int16_t)get_u16(frame + 2 * c);
+            }
+            values[j] = sum / channels;
+        }
+
+        new_sound->samples[i] = values[0] + (int32_t)(((int64_t)(values[1] - values[0]) * frac) >> 16);
+    }
+
+    *sound = new_sound;
+    return PBIO_SUCCESS;
+}
+
+/**
+ * Gets a sound that was decoded before.
+ * @param [in]  key     The file path or other key the sound was cached with
+ * @return              The sound or NULL if it is not in the cache
+ */
+pb_pcm_sound_t *pb_pcm_lookup(const char *key) {
+    if (!cache) {
+        return NULL;
+    }
+    pb_pcm_sound_t *sound = g_hash_table_lookup(cache, key);
+    if (sound) {
+        g_queue_unlink(&cache_lru, sound->link);
+        g_queue_push_head_link(&cache_lru, sound->link);
+    }
+    return sound;
+}
+
+static gsize get_sound_size(pb_pcm_sound_t *sound) {
+    return sound->num_samples * sizeof(*sound->samples);
+}
+
+// Drops the least recently used sounds until the cache fits in its size
+// limit. The sound that is playing and the given sound are kept.
+static void evict(pb_pcm_sound_t *keep) {
+    GList *link = cache_lru.tail;
+    while (cache_size > CACHE_MAX_SIZE && link) {
+        pb_pcm_sound_t *sound = link->data;
+        link = link->prev;
+
+        pthread_mutex_lock(&lock);
+        bool playing = sound == sample_sound;
+        pthread_mutex_unlock(&lock);
+        if (playing || sound == keep) {
+            continue;
+        }
+
+        g_queue_delete_link(&cache_lru, sound->link);
+        g_hash_table_remove(cache, sound->key);
+        cache_size -= get_sound_size(sound);
+        g_free(sound->key);
+        g_free(sound->samples);
+        g_free(sound);
+    }
+}
+
+/**
+ * Decodes a WAV file in memory and adds it to the cache, so that it can be
+ * found with pb_pcm_lookup() later on. If the cache is full, the least
+ * recently used sounds are dropped from it, so @p sound is only valid until
+ * the next sound is added.
+ * @param [in]  key     Key to cache the sound with
+ * @param [in]  wav     The contents of the WAV file
+ * @param [in]  size    The size of @p wav
+ * @param [out] sound   The new sound
+ * @return              ::PBIO_SUCCESS, ::PBIO_ERROR_INVALID_OP if the sound
+ *                      device is not open, or an error from pb_pcm_new_sound().
+ */
+pbio_error_t pb_pcm_add_wav(const char *key, const uint8_t *wav, uint32_t size, pb_pcm_sound_t **sound) {
+    if (!cache) {
+        return PBIO_ERROR_INVALID_OP;
+    }
+
+    pbio_error_t err = pb_pcm_new_sound(wav, size, sound);
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+
+    (*sound)->key = g_strdup(key);
+    g_queue_push_head(&cache_lru, *sound);
+    (*sound)->link = cache_lru.head;
+    g_hash_table_insert(cache, (*sound)->key, *sound);
+    cache_size += get_sound_size(*sound);
+    evict(*sound);
+    return PBIO_SUCCESS;
+}
+
+/**
+ * Gets the decoded sound for a WAV file. Files are only read and decoded the
+ * first time.
+ * @param [in]  path    Path to the file
+ * @param [out] sound   The sound
+ * @return              ::PBIO_SUCCESS, ::PBIO_ERROR_IO if the file can not be
+ *                      read, or an error from pb_pcm_add_wav().
+ */
+pbio_error_t pb_pcm_load_wav(const char *path, pb_pcm_sound_t **sound) {
+    *sound = pb_pcm_lookup(path);
+    if (*sound) {
+        return PBIO_SUCCESS;
+    }
+
+    gchar *contents;
+    gsize length;
+    if (!g_file_get_contents(path, &contents, &length, NULL)) {
+        return PBIO_ERROR_IO;
+    }
+
+    pbio_error_t err = pb_pcm_add_wav(path, (const uint8_t *)contents, length, sound);
+    g_free(contents);
+    return err;
+}
+
+/**
+ * Starts playing a sound without waiting for it to finish. This replaces the
+ * sound that is playing, if any. The sound is mixed with the tone, if any.
+ * @param [in]  sound   The sound
+ * @return              ::PBIO_SUCCESS or ::PBIO_ERROR_INVALID_OP if the sound
+ *                      device is not open.
+ */
+pbio_error_t pb_pcm_play(pb_pcm_sound_t *sound) {
+    if (!pcm) {
+        return PBIO_ERROR_INVALID_OP;
+    }
+
+    pthread_mutex_lock(&lock);
+    sample_sound = sound->num_samples ? sound : NULL;
+    sample_pos = 0;
+    sample_end_time = 0;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&lock);
+
+    return PBIO_SUCCESS;
+}
+
+/**
+ * Starts or stops a square wave tone that is mixed with the sound.
+ * @param [in]  frequency   Frequency (Hz) or 0 to stop
+ * @return                  ::PBIO_SUCCESS or ::PBIO_ERROR_INVALID_OP if the
+ *                          sound device is not open.
+ */
+pbio_error_t pb_pcm_set_tone(uint32_t frequency) {
+    if (!pcm) {
+        return PBIO_ERROR_INVALID_OP;
+    }
+
+    // Frequencies above half the sample rate can not be played
+    frequency = MIN(frequency, PB_PCM_RATE / 2);
+
+    pthread_mutex_lock(&lock);
+    tone_step = ((uint64_t)frequency << 32) / PB_PCM_RATE;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&lock);
+
+    return PBIO_SUCCESS;
+}
+
+/**
+ * Checks if a sound is still playing, including the part of it that is in
+ * the device buffer. The tone is not included. The playback thread wakes up
+ * the default glib main context when this becomes false, so callers can wait
+ * with g_main_context_iteration().
+ * @return              True if a sound is playing
+ */
+bool pb_pcm_is_playing(void) {
+    pthread_mutex_lock(&lock);
+    bool playing = sample_sound != NULL || sample_end_time != 0;
+    pthread_mutex_unlock(&lock);
+    return playing;
+}
+
+/**
+ * Stops the sound and the tone.
+ */
+void pb_pcm_stop(void) {
+    pthread_mutex_lock(&lock);
+    sample_sound = NULL;
+    sample_end_time = 0;
+    tone_step = 0;
+    pthread_mutex_unlock(&lock);
+    g_main_context_wakeup(g_main_context_default());
+}
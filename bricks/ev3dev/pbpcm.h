@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+// In-process PCM playback using ALSA.
+//
+// Sounds are decoded once into a cache and then mixed by a background
+// thread, so playback starts within one period of the sound device.
+
+#ifndef _PBPCM_H_
+#define _PBPCM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <pbio/error.h>
+
+// Sample rate of all decoded sounds and of the sound device
+#define PB_PCM_RATE (22050)
+
+typedef struct _pb_pcm_sound_t pb_pcm_sound_t;
+
+pbio_error_t pb_pcm_init(void);
+
+void pb_pcm_deinit(void);
+
+pb_pcm_sound_t *pb_pcm_lookup(const char *key);
+
+pbio_error_t pb_pcm_add_wav(const char *key, const uint8_t *wav, uint32_t size, pb_pcm_sound_t **sound);
+
+pbio_error_t pb_pcm_load_wav(const char *path, pb_pcm_sound_t **sound);
+
+pbio_error_t pb_pcm_new_sound(const uint8_t *wav, uint32_t size, pb_pcm_sound_t **sound);
+
+pbio_error_t pb_pcm_play(pb_pcm_sound_t *sound);
+
+pbio_error_t pb_pcm_set_tone(uint32_t frequency);
+
+bool pb_pcm_is_playing(void);
+
+void pb_pcm_stop(void);
+
+#endif // _PBPCM_H_
@@ -14,7 +14,9 @@
 #define PYBRICKS_PY_IODEVICES           (1)
 #define PYBRICKS_PY_PARAMETERS          (1)
 #define PYBRICKS_PY_PUPDEVICES          (1)
+#define PYBRICKS_PY_PUPDEVICES_TRAINING (0)
 #define PYBRICKS_PY_TOOLS               (1)
+#define PYBRICKS_PY_TOOLS_TASKS         (0)
 #define PYBRICKS_PY_ROBOTICS            (1)
 #define PYBRICKS_PY_UOS                 (1)
 
@@ -13,6 +13,7 @@
 #define PYBRICKS_PY_NXTDEVICES          (1)
 #define PYBRICKS_PY_PARAMETERS          (1)
 #define PYBRICKS_PY_TOOLS               (1)
+#define PYBRICKS_PY_TOOLS_TASKS         (1)
 #define PYBRICKS_PY_ROBOTICS            (1)
 #define PYBRICKS_PY_UOS                 (1)
 
@@ -156,6 +157,7 @@ extern const struct _mp_obj_module_t pb_module_nxtdevices;
 #define MP_STATE_PORT MP_STATE_VM
 
 #define MICROPY_PORT_ROOT_POINTERS \
-    const char *readline_hist[8];
+    const char *readline_hist[8]; \
+    PYBRICKS_ROBOTICS_ROOT_POINTERS
 
 #include "../pybricks_config.h"
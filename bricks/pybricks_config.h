@@ -64,6 +64,18 @@
 #define PYBRICKS_HUB_NAME "nxt"
 #elif PYBRICKS_HUB_PRIMEHUB
 #define PYBRICKS_HUB_NAME "primehub"
+#elif PYBRICKS_HUB_VIRTUALHUB
+#define PYBRICKS_HUB_NAME "virtualhub"
 #elif !NO_QSTR // qstr generator runs preprocessor on this file directly
 #error "Unknown hub type"
 #endif
+
+// Objects that the drivebase control loop uses in the background. They are
+// kept here because the loop outlives the DriveBase object that set them.
+#if PYBRICKS_PY_ROBOTICS
+#define PYBRICKS_ROBOTICS_ROOT_POINTERS \
+    mp_obj_t robotics_drivebase_gyro; \
+    mp_obj_t robotics_drivebase_sensor;
+#else
+#define PYBRICKS_ROBOTICS_ROOT_POINTERS
+#endif
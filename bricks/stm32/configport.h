@@ -220,6 +220,7 @@ static inline mp_uint_t disable_irq(void) {
 #define MP_STATE_PORT MP_STATE_VM
 
 #define MICROPY_PORT_ROOT_POINTERS \
-    const char *readline_hist[8];
+    const char *readline_hist[8]; \
+    PYBRICKS_ROBOTICS_ROOT_POINTERS
 
 #include "../pybricks_config.h"
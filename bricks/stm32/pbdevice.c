@@ -95,21 +95,25 @@ pbdevice_t *pbdevice_get_device(pbio_port_t port, pbio_iodev_type_id_t valid_id)
     return (pbdevice_t *)iodev;
 }
 
-void pbdevice_get_values(pbdevice_t *pbdev, uint8_t mode, int32_t *values) {
-
-    pbio_iodev_t *iodev = &pbdev->iodev;
+// Reads the values of the current mode
+static pbio_error_t get_values(pbio_iodev_t *iodev, int32_t *values) {
 
     uint8_t *data;
     uint8_t len;
     pbio_iodev_data_type_t type;
+    pbio_error_t err;
 
-    set_mode(iodev, mode);
-
-    pb_assert(pbio_iodev_get_data(iodev, &data));
-    pb_assert(pbio_iodev_get_data_format(iodev, iodev->mode, &len, &type));
+    err = pbio_iodev_get_data(iodev, &data);
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+    err = pbio_iodev_get_data_format(iodev, iodev->mode, &len, &type);
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
 
     if (len == 0) {
-        pb_assert(PBIO_ERROR_IO);
+        return PBIO_ERROR_IO;
     }
 
     for (uint8_t i = 0; i < len; i++) {
@@ -129,9 +133,32 @@ void pbdevice_get_values(pbdevice_t *pbdev, uint8_t mode, int32_t *values) {
                 break;
             #endif
             default:
-                pb_assert(PBIO_ERROR_IO);
+                return PBIO_ERROR_IO;
         }
     }
+
+    return PBIO_SUCCESS;
+}
+
+void pbdevice_get_values(pbdevice_t *pbdev, uint8_t mode, int32_t *values) {
+
+    pbio_iodev_t *iodev = &pbdev->iodev;
+
+    set_mode(iodev, mode);
+
+    pb_assert(get_values(iodev, values));
+}
+
+pbio_error_t pbdevice_get_values_nowait(pbdevice_t *pbdev, uint8_t mode, int32_t *values) {
+
+    pbio_iodev_t *iodev = &pbdev->iodev;
+
+    // Changing modes has to wait, so that is left to pbdevice_get_values()
+    if (iodev->mode != mode) {
+        return PBIO_ERROR_INVALID_OP;
+    }
+
+    return get_values(iodev, values);
 }
 
 void pbdevice_set_values(pbdevice_t *pbdev, uint8_t mode, int32_t *values, uint8_t num_values) {
@@ -196,6 +223,10 @@ void pbdevice_get_info(pbdevice_t *pbdev, pbio_port_t *port, pbio_iodev_type_id_
     *num_values = pbdev->iodev.info->mode_info[*mode].num_values;
 }
 
+void pbdevice_get_timestamp(pbdevice_t *pbdev, uint32_t *timestamp, uint32_t *seq) {
+    pb_assert(pbio_iodev_get_data_timestamp(&pbdev->iodev, timestamp, seq));
+}
+
 int8_t pbdevice_get_mode_id_from_str(pbdevice_t *pbdev, const char *mode_str) {
     pb_assert(PBIO_ERROR_NOT_IMPLEMENTED);
     return 0;
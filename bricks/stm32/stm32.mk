@@ -285,6 +285,7 @@ PBIO_SRC_C = $(addprefix lib/pbio/,\
 	drv/gpio/gpio_stm32f0.c \
 	drv/gpio/gpio_stm32f4.c \
 	drv/gpio/gpio_stm32l4.c \
+	drv/imu/imu_lsm6ds3tr_c_stm32_hal.c \
 	drv/ioport/ioport_lpf2.c \
 	drv/uart/uart_stm32_hal.c \
 	drv/uart/uart_stm32f0.c \
@@ -293,6 +294,7 @@ PBIO_SRC_C = $(addprefix lib/pbio/,\
 	platform/$(PBIO_PLATFORM)/clock.c \
 	platform/$(PBIO_PLATFORM)/platform.c \
 	platform/$(PBIO_PLATFORM)/sys.c \
+	src/attitude.c \
 	src/control.c \
 	src/dcmotor.c \
 	src/drivebase.c \
@@ -304,6 +306,7 @@ PBIO_SRC_C = $(addprefix lib/pbio/,\
 	src/main.c \
 	src/math.c \
 	src/motorpoll.c \
+	src/reflex.c \
 	src/servo.c \
 	src/tacho.c \
 	src/trajectory_ext.c \
@@ -23,13 +23,25 @@ int mp_hal_stdin_rx_chr(void) {
 
 // Send string of given length
 void mp_hal_stdout_tx_strn(const char *str, mp_uint_t len) {
-    uint8_t c;
-
-    while (len--) {
-        c = *str++;
-        while (pbsys_stdout_put_char(c) == PBIO_ERROR_AGAIN) {
+    uint32_t written;
+    pbio_error_t err;
+
+    while (len) {
+        err = pbsys_stdout_write((const uint8_t *)str, len, &written);
+        if (err == PBIO_ERROR_AGAIN) {
+            // buffer is full, so make sure it is being emptied
+            pbsys_stdout_flush();
             // only run pbio events here - don't want keyboard interrupt in middle of printf()
             MICROPY_VM_HOOK_LOOP
+            continue;
         }
+        if (err != PBIO_SUCCESS) {
+            // no stdout available (e.g. no connection), so drop the data
+            return;
+        }
+        str += written;
+        len -= written;
     }
+
+    pbsys_stdout_flush();
 }
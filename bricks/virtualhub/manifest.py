@@ -0,0 +1 @@
+freeze_as_mpy("./modules")
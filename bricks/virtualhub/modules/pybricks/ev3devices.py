@@ -0,0 +1,13 @@
+# SPDX-License-Identifier: MIT
+# Copyright (c) 2018-2020 The Pybricks Authors
+
+"""Classes for simulated LEGO MINDSTORMS EV3 Devices."""
+
+from ev3devices_c import (
+    InfraredSensor,
+    ColorSensor,
+    TouchSensor,
+    UltrasonicSensor,
+    GyroSensor,
+    Motor,
+)
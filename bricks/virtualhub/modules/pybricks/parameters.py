@@ -0,0 +1,6 @@
+# SPDX-License-Identifier: MIT
+# Copyright (c) 2018-2020 The Pybricks Authors
+
+"""Enum classes of parameters, used by modules in the Pybricks package."""
+
+from parameters_c import Direction, Stop, Color, Button, Port
@@ -0,0 +1,6 @@
+# SPDX-License-Identifier: MIT
+# Copyright (c) 2018-2020 The Pybricks Authors
+
+"""Pybricks robotics module."""
+
+from robotics_c import DriveBase
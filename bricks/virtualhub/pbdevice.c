@@ -0,0 +1,158 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#include "py/mphal.h"
+
+#include "pberror.h"
+#include "pbdevice.h"
+
+#include <pbio/config.h>
+
+#include <stdbool.h>
+#include <string.h>
+
+#include <contiki.h>
+
+#include <pbio/port.h>
+#include <pbio/iodev.h>
+
+// Sensors on the virtual hub see a robot that stands on a white table in an
+// empty room. What a sensor sees can be changed by writing values to a mode
+// with pbdevice_set_values(). Reading that mode then gives these values.
+
+#define VIRTUAL_NUM_MODES (8)
+
+struct _pbdevice_t {
+    /**
+     * The device ID
+     */
+    pbio_iodev_type_id_t type_id;
+    /**
+     * The port the device is attached to.
+     */
+    pbio_port_t port;
+    /**
+     * The current active mode.
+     */
+    uint8_t mode;
+    /**
+     * Time (us) of the most recent sample
+     */
+    uint32_t timestamp;
+    /**
+     * Sequence number of the most recent sample
+     */
+    uint32_t data_seq;
+    /**
+     * Values written by the program for each mode, if any
+     */
+    bool has_values[VIRTUAL_NUM_MODES];
+    int32_t values[VIRTUAL_NUM_MODES][PBIO_IODEV_MAX_DATA_SIZE];
+};
+
+pbdevice_t iodevices[4];
+
+// Fills in what the sensor sees if the program has not written anything
+static void get_scene_values(pbdevice_t *pbdev, uint8_t mode, int32_t *values) {
+    memset(values, 0, sizeof(int32_t) * PBIO_IODEV_MAX_DATA_SIZE);
+
+    switch (pbdev->type_id) {
+        case PBIO_IODEV_TYPE_ID_EV3_COLOR_SENSOR:
+            switch (mode) {
+                case PBIO_IODEV_MODE_EV3_COLOR_SENSOR__REFLECT:
+                    values[0] = 80;
+                    break;
+                case PBIO_IODEV_MODE_EV3_COLOR_SENSOR__AMBIENT:
+                    values[0] = 10;
+                    break;
+                case PBIO_IODEV_MODE_EV3_COLOR_SENSOR__COLOR:
+                    values[0] = 6; // White
+                    break;
+                case PBIO_IODEV_MODE_EV3_COLOR_SENSOR__RGB_RAW:
+                    values[0] = values[1] = values[2] = 300;
+                    break;
+            }
+            break;
+        case PBIO_IODEV_TYPE_ID_EV3_ULTRASONIC_SENSOR:
+            if (mode == PBIO_IODEV_MODE_EV3_ULTRASONIC_SENSOR__DIST_CM ||
+                mode == PBIO_IODEV_MODE_EV3_ULTRASONIC_SENSOR__SI_CM) {
+                values[0] = 2550; // Out of range
+            }
+            break;
+        case PBIO_IODEV_TYPE_ID_EV3_IR_SENSOR:
+            if (mode == PBIO_IODEV_MODE_EV3_INFRARED_SENSOR__PROX) {
+                values[0] = 100;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+pbdevice_t *pbdevice_get_device(pbio_port_t port, pbio_iodev_type_id_t valid_id) {
+    if (port < PBIO_PORT_1 || port > PBIO_PORT_4) {
+        pb_assert(PBIO_ERROR_INVALID_PORT);
+    }
+
+    pbdevice_t *pbdev = &iodevices[port - PBIO_PORT_1];
+
+    // Any device can be attached to a virtual port
+    pbdev->type_id = valid_id;
+    pbdev->port = port;
+
+    return pbdev;
+}
+
+pbio_error_t pbdevice_get_values_nowait(pbdevice_t *pbdev, uint8_t mode, int32_t *values) {
+    if (pbdev->mode != mode) {
+        return PBIO_ERROR_INVALID_OP;
+    }
+
+    if (mode < VIRTUAL_NUM_MODES && pbdev->has_values[mode]) {
+        memcpy(values, pbdev->values[mode], sizeof(pbdev->values[mode]));
+    } else {
+        get_scene_values(pbdev, mode, values);
+    }
+
+    pbdev->timestamp = clock_usecs();
+    pbdev->data_seq++;
+
+    return PBIO_SUCCESS;
+}
+
+void pbdevice_get_values(pbdevice_t *pbdev, uint8_t mode, int32_t *values) {
+    pbdev->mode = mode;
+    pb_assert(pbdevice_get_values_nowait(pbdev, mode, values));
+}
+
+void pbdevice_set_values(pbdevice_t *pbdev, uint8_t mode, int32_t *values, uint8_t num_values) {
+    if (mode >= VIRTUAL_NUM_MODES || num_values > PBIO_IODEV_MAX_DATA_SIZE) {
+        pb_assert(PBIO_ERROR_INVALID_ARG);
+    }
+    memset(pbdev->values[mode], 0, sizeof(pbdev->values[mode]));
+    memcpy(pbdev->values[mode], values, sizeof(int32_t) * num_values);
+    pbdev->has_values[mode] = true;
+}
+
+void pbdevice_set_power_supply(pbdevice_t *pbdev, int32_t duty) {
+}
+
+void pbdevice_get_info(pbdevice_t *pbdev, pbio_port_t *port, pbio_iodev_type_id_t *id, uint8_t *mode, uint8_t *num_values) {
+    *port = pbdev->port;
+    *id = pbdev->type_id;
+    *mode = pbdev->mode;
+    *num_values = PBIO_IODEV_MAX_DATA_SIZE;
+}
+
+void pbdevice_get_timestamp(pbdevice_t *pbdev, uint32_t *timestamp, uint32_t *seq) {
+    *timestamp = pbdev->timestamp;
+    *seq = pbdev->data_seq;
+}
+
+int8_t pbdevice_get_mode_id_from_str(pbdevice_t *pbdev, const char *mode_str) {
+    pb_assert(PBIO_ERROR_NOT_SUPPORTED);
+    return 0;
+}
+
+void pbdevice_color_light_on(pbdevice_t *pbdev, pbio_light_color_t color) {
+}
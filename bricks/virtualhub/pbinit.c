@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2018-2020 The Pybricks Authors
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <contiki.h>
+
+#include <pbio/config.h>
+#include <pbio/main.h>
+#include <pbio/motorpoll.h>
+
+#include "py/mpconfig.h"
+#include "py/mpthread.h"
+#include "py/runtime.h"
+
+#include "pbinit.h"
+#include "pbmotorevent.h"
+
+// Flag that indicates whether we are busy stopping the thread
+static volatile bool stopping_thread = false;
+static pthread_t task_caller_thread;
+
+// The background thread that keeps firing the task handler in real time, like
+// on ev3dev. It requests the etimer poll itself and then sleeps until the next
+// etimer deadline.
+static void *task_caller(void *arg) {
+    struct timespec ts;
+    int32_t delay;
+
+    while (!stopping_thread) {
+        MP_THREAD_GIL_ENTER();
+        etimer_request_poll();
+        while (pbio_do_one_event()) {
+        }
+        delay = PBIO_CONFIG_SERVO_PERIOD_MS;
+        if (etimer_pending()) {
+            delay = (int32_t)(etimer_next_expiration_time() - clock_time());
+            if (delay < 0) {
+                delay = 0;
+            } else if (delay > PBIO_CONFIG_SERVO_PERIOD_MS) {
+                delay = PBIO_CONFIG_SERVO_PERIOD_MS;
+            }
+        }
+        MP_THREAD_GIL_EXIT();
+
+        ts.tv_sec = 0;
+        ts.tv_nsec = delay * 1000000;
+        clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, NULL);
+    }
+
+    return NULL;
+}
+
+/**
+ * Runs the background tasks while advancing simulated time. Does nothing in
+ * real time, where the task caller thread does this.
+ * @param [in]  ms      How long to advance time (ms)
+ */
+void pybricks_advance_time(uint32_t ms) {
+    if (!clock_virtual_is_simulated()) {
+        return;
+    }
+    for (uint32_t i = 0; i < ms; i++) {
+        clock_virtual_advance(1000);
+        etimer_request_poll();
+        while (pbio_do_one_event()) {
+        }
+    }
+}
+
+// Pybricks initialization tasks
+void pybricks_init() {
+    // Simulated time runs as fast as possible, which is useful for
+    // benchmarks and tests. It only moves on while the program waits.
+    const char *simulated = getenv("PYBRICKS_SIMULATED_TIME");
+    clock_virtual_set_simulated(simulated && simulated[0] && simulated[0] != '0');
+
+    pbio_init();
+
+    // Simulated time only moves on in the event hook, so there is no thread
+    // that could wake up threads that wait for motor events.
+    if (!clock_virtual_is_simulated()) {
+        pthread_create(&task_caller_thread, NULL, task_caller, NULL);
+        pb_motor_event_start();
+    }
+}
+
+// Pybricks deinitialization tasks
+void pybricks_deinit() {
+    // Signal motor thread to stop and wait for it to do so.
+    if (!clock_virtual_is_simulated()) {
+        pb_motor_event_stop();
+        stopping_thread = true;
+        pthread_join(task_caller_thread, NULL);
+    }
+    pbio_deinit();
+}
+
+void pybricks_unhandled_exception() {
+    extern void _pbio_motorpoll_reset_all();
+    _pbio_motorpoll_reset_all();
+}
@@ -0,0 +1,15 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2018-2020 The Pybricks Authors
+
+#ifndef MICROPY_INCLUDED_PBINIT_H
+#define MICROPY_INCLUDED_PBINIT_H
+
+#include <stdint.h>
+
+void pybricks_init();
+
+void pybricks_deinit();
+
+void pybricks_advance_time(uint32_t ms);
+
+#endif // MICROPY_INCLUDED_PBINIT_H
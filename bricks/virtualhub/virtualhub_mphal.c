@@ -0,0 +1,171 @@
+/*
+ * This file is part of the MicroPython project, http://micropython.org/
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Damien P. George
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include <contiki.h>
+
+#include "py/mphal.h"
+#include "py/runtime.h"
+
+#include "pbinit.h"
+
+
+STATIC void sighandler(int signum) {
+    if (signum == SIGINT) {
+        if (MP_STATE_MAIN_THREAD(mp_pending_exception) == MP_OBJ_FROM_PTR(&MP_STATE_VM(mp_kbd_exception))) {
+            // this is the second time we are called, so die straight away
+            exit(1);
+        }
+        mp_obj_exception_clear_traceback(MP_OBJ_FROM_PTR(&MP_STATE_VM(mp_kbd_exception)));
+        MP_STATE_MAIN_THREAD(mp_pending_exception) = MP_OBJ_FROM_PTR(&MP_STATE_VM(mp_kbd_exception));
+    }
+}
+
+void mp_hal_set_interrupt_char(char c) {
+    // configure terminal settings to (not) let ctrl-C through
+    if (c == CHAR_CTRL_C) {
+        // enable signal handler
+        struct sigaction sa;
+        sa.sa_flags = 0;
+        sa.sa_handler = sighandler;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGINT, &sa, NULL);
+    } else {
+        // disable signal handler
+        struct sigaction sa;
+        sa.sa_flags = 0;
+        sa.sa_handler = SIG_DFL;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGINT, &sa, NULL);
+    }
+}
+
+#if MICROPY_USE_READLINE == 1
+
+#include <termios.h>
+
+static struct termios orig_termios;
+
+void mp_hal_stdio_mode_raw(void) {
+    // save and set terminal settings
+    tcgetattr(0, &orig_termios);
+    static struct termios termios;
+    termios = orig_termios;
+    termios.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+    termios.c_cflag = (termios.c_cflag & ~(CSIZE | PARENB)) | CS8;
+    termios.c_lflag = 0;
+    termios.c_cc[VMIN] = 1;
+    termios.c_cc[VTIME] = 0;
+    tcsetattr(0, TCSAFLUSH, &termios);
+}
+
+void mp_hal_stdio_mode_orig(void) {
+    // restore terminal settings
+    tcsetattr(0, TCSAFLUSH, &orig_termios);
+}
+
+#endif
+
+int mp_hal_stdin_rx_chr(void) {
+    unsigned char c;
+    int ret;
+    MP_THREAD_GIL_EXIT();
+    ret = read(STDIN_FILENO, &c, 1);
+    MP_THREAD_GIL_ENTER();
+    if (ret == 0) {
+        c = 4; // EOF, ctrl-D
+    } else if (c == '\n') {
+        c = '\r';
+    }
+    return c;
+}
+
+void mp_hal_stdout_tx_strn(const char *str, size_t len) {
+    MP_THREAD_GIL_EXIT();
+    int ret = write(STDOUT_FILENO, str, len);
+    MP_THREAD_GIL_ENTER();
+    (void)ret; // to suppress compiler warning
+}
+
+// cooked is same as uncooked because the terminal does some postprocessing
+void mp_hal_stdout_tx_strn_cooked(const char *str, size_t len) {
+    mp_hal_stdout_tx_strn(str, len);
+}
+
+void mp_hal_stdout_tx_str(const char *str) {
+    mp_hal_stdout_tx_strn(str, strlen(str));
+}
+
+mp_uint_t mp_hal_ticks_ms(void) {
+    return clock_to_msec(clock_time());
+}
+
+mp_uint_t mp_hal_ticks_us(void) {
+    return clock_usecs();
+}
+
+void mp_hal_delay_ms(mp_uint_t ms) {
+    if (clock_virtual_is_simulated()) {
+        mp_handle_pending(true);
+        pybricks_advance_time(ms);
+        return;
+    }
+    struct timespec ts = {
+        .tv_sec = ms / 1000,
+        .tv_nsec = ms % 1000 * 1000000,
+    };
+    struct timespec remain;
+    for (;;) {
+        mp_handle_pending(true);
+        MP_THREAD_GIL_EXIT();
+        int ret = clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, &remain);
+        MP_THREAD_GIL_ENTER();
+        if (ret == EINTR) {
+            ts = remain;
+            continue;
+        }
+        assert(ret == 0);
+        break;
+    }
+}
+
+void mp_hal_delay_us(mp_uint_t us) {
+    if (clock_virtual_is_simulated()) {
+        pybricks_advance_time((us + 999) / 1000);
+        return;
+    }
+    MP_THREAD_GIL_EXIT();
+    usleep(us);
+    MP_THREAD_GIL_ENTER();
+}
@@ -10,6 +10,7 @@
 #include "pbdevice.h"
 #include "pbobj.h"
 #include "pbkwarg.h"
+#include "modev3devices.h"
 #include "modparameters.h"
 
 #include "py/objtype.h"
@@ -409,23 +410,28 @@ STATIC const mp_obj_type_t ev3devices_UltrasonicSensor_type = {
     .locals_dict = (mp_obj_dict_t *)&ev3devices_UltrasonicSensor_locals_dict,
 };
 
-// pybricks.ev3devices.GyroSensor class object
-typedef struct _ev3devices_GyroSensor_obj_t {
-    mp_obj_base_t base;
-    pbio_port_t port; // FIXME: Shouldn't be here
-    pbdevice_t *pbdev;
-    pbio_direction_t direction;
-    mp_int_t offset;
-} ev3devices_GyroSensor_obj_t;
+// pybricks.ev3devices.GyroSensor (internal) Get raw angle or speed. Returns
+// true if the sensor stayed in the combined angle and speed mode.
+STATIC bool ev3devices_GyroSensor_get_raw(ev3devices_GyroSensor_obj_t *self, uint8_t mode, int32_t *raw) {
+    // While used as a drivebase heading source, the sensor stays in the mode
+    // that gives both angle and speed, so we don't disturb the drivebase.
+    int32_t values[2];
+    if (pbdevice_get_values_nowait(self->pbdev, PBIO_IODEV_MODE_EV3_GYRO_SENSOR__G_A, values) == PBIO_SUCCESS) {
+        *raw = mode == PBIO_IODEV_MODE_EV3_GYRO_SENSOR__RATE ? values[1] : values[0];
+        return true;
+    }
+    pbdevice_get_values(self->pbdev, mode, raw);
+    return false;
+}
 
 // pybricks.ev3devices.GyroSensor (internal) Get new offset  for new reset angle
-STATIC mp_int_t ev3devices_GyroSensor_get_angle_offset(pbdevice_t *pbdev, pbio_direction_t direction, mp_int_t new_angle) {
+STATIC mp_int_t ev3devices_GyroSensor_get_angle_offset(ev3devices_GyroSensor_obj_t *self, mp_int_t new_angle) {
     // Read raw sensor values
     int32_t raw_angle;
-    pbdevice_get_values(pbdev, PBIO_IODEV_MODE_EV3_GYRO_SENSOR__ANG, &raw_angle);
+    ev3devices_GyroSensor_get_raw(self, PBIO_IODEV_MODE_EV3_GYRO_SENSOR__ANG, &raw_angle);
 
     // Get new offset using arguments and raw values
-    if (direction == PBIO_DIRECTION_CLOCKWISE) {
+    if (self->direction == PBIO_DIRECTION_CLOCKWISE) {
         return raw_angle - new_angle;
     } else {
         return -raw_angle - new_angle;
@@ -447,7 +453,7 @@ STATIC mp_obj_t ev3devices_GyroSensor_make_new(const mp_obj_type_t *type, size_t
 
     self->pbdev = pbdevice_get_device(port_num, PBIO_IODEV_TYPE_ID_EV3_GYRO_SENSOR);
 
-    self->offset = ev3devices_GyroSensor_get_angle_offset(self->pbdev, self->direction, 0);
+    self->offset = ev3devices_GyroSensor_get_angle_offset(self, 0);
     return MP_OBJ_FROM_PTR(self);
 }
 
@@ -455,10 +461,10 @@ STATIC mp_obj_t ev3devices_GyroSensor_make_new(const mp_obj_type_t *type, size_t
 STATIC mp_obj_t ev3devices_GyroSensor_speed(mp_obj_t self_in) {
     ev3devices_GyroSensor_obj_t *self = MP_OBJ_TO_PTR(self_in);
     int32_t raw_speed;
-    pbdevice_get_values(self->pbdev, PBIO_IODEV_MODE_EV3_GYRO_SENSOR__RATE, &raw_speed);
-
-    // changing modes resets angle to 0
-    self->offset = 0;
+    if (!ev3devices_GyroSensor_get_raw(self, PBIO_IODEV_MODE_EV3_GYRO_SENSOR__RATE, &raw_speed)) {
+        // changing modes resets angle to 0
+        self->offset = 0;
+    }
 
     if (self->direction == PBIO_DIRECTION_CLOCKWISE) {
         return mp_obj_new_int(raw_speed);
@@ -472,7 +478,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_1(ev3devices_GyroSensor_speed_obj, ev3devices_Gyr
 STATIC mp_obj_t ev3devices_GyroSensor_angle(mp_obj_t self_in) {
     ev3devices_GyroSensor_obj_t *self = MP_OBJ_TO_PTR(self_in);
     int32_t raw_angle;
-    pbdevice_get_values(self->pbdev, PBIO_IODEV_MODE_EV3_GYRO_SENSOR__ANG, &raw_angle);
+    ev3devices_GyroSensor_get_raw(self, PBIO_IODEV_MODE_EV3_GYRO_SENSOR__ANG, &raw_angle);
 
     if (self->direction == PBIO_DIRECTION_CLOCKWISE) {
         return mp_obj_new_int(raw_angle - self->offset);
@@ -488,11 +494,48 @@ STATIC mp_obj_t ev3devices_GyroSensor_reset_angle(size_t n_args, const mp_obj_t
         ev3devices_GyroSensor_obj_t, self,
         PB_ARG_REQUIRED(angle));
 
-    self->offset = ev3devices_GyroSensor_get_angle_offset(self->pbdev, self->direction, pb_obj_get_int(angle));
+    self->offset = ev3devices_GyroSensor_get_angle_offset(self, pb_obj_get_int(angle));
     return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(ev3devices_GyroSensor_reset_angle_obj, 1, ev3devices_GyroSensor_reset_angle);
 
+// pybricks.ev3devices.GyroSensor (internal) Prepare for use as drivebase heading source
+void ev3devices_GyroSensor_start_heading(mp_obj_t self_in) {
+    ev3devices_GyroSensor_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+    // Get the current angle in the old mode
+    int32_t raw_angle;
+    ev3devices_GyroSensor_get_raw(self, PBIO_IODEV_MODE_EV3_GYRO_SENSOR__ANG, &raw_angle);
+    mp_int_t angle = self->direction == PBIO_DIRECTION_CLOCKWISE ? raw_angle - self->offset : -raw_angle - self->offset;
+
+    // Switch to the mode that gives angle and speed at once. This resets the
+    // raw angle, so keep the user angle where it was.
+    int32_t values[2];
+    pbdevice_get_values(self->pbdev, PBIO_IODEV_MODE_EV3_GYRO_SENSOR__G_A, values);
+    self->offset = ev3devices_GyroSensor_get_angle_offset(self, angle);
+}
+
+// pybricks.ev3devices.GyroSensor (internal) Heading source for drivebase
+pbio_error_t ev3devices_GyroSensor_get_heading(void *context, int32_t *heading, int32_t *heading_rate) {
+    ev3devices_GyroSensor_obj_t *self = context;
+
+    // This runs in the background, so it must not raise
+    int32_t values[2];
+    pbio_error_t err = pbdevice_get_values_nowait(self->pbdev, PBIO_IODEV_MODE_EV3_GYRO_SENSOR__G_A, values);
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+
+    if (self->direction == PBIO_DIRECTION_CLOCKWISE) {
+        *heading = values[0] * 1000;
+        *heading_rate = values[1] * 1000;
+    } else {
+        *heading = -values[0] * 1000;
+        *heading_rate = -values[1] * 1000;
+    }
+    return PBIO_SUCCESS;
+}
+
 // dir(pybricks.ev3devices.GyroSensor)
 STATIC const mp_rom_map_elem_t ev3devices_GyroSensor_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_angle),       MP_ROM_PTR(&ev3devices_GyroSensor_angle_obj)       },
@@ -502,13 +545,39 @@ STATIC const mp_rom_map_elem_t ev3devices_GyroSensor_locals_dict_table[] = {
 STATIC MP_DEFINE_CONST_DICT(ev3devices_GyroSensor_locals_dict, ev3devices_GyroSensor_locals_dict_table);
 
 // type(pybricks.ev3devices.GyroSensor)
-STATIC const mp_obj_type_t ev3devices_GyroSensor_type = {
+const mp_obj_type_t ev3devices_GyroSensor_type = {
     { &mp_type_type },
     .name = MP_QSTR_GyroSensor,
     .make_new = ev3devices_GyroSensor_make_new,
     .locals_dict = (mp_obj_dict_t *)&ev3devices_GyroSensor_locals_dict,
 };
 
+// Sensor value that can steer a drivebase in the background
+bool ev3devices_get_source(mp_obj_t sensor_in, pbdevice_source_t *source) {
+
+    source->index = 0;
+    source->divisor = 1;
+    source->out_of_range = 0;
+
+    if (mp_obj_is_type(sensor_in, &ev3devices_ColorSensor_type)) {
+        source->pbdev = ((ev3devices_ColorSensor_obj_t *)MP_OBJ_TO_PTR(sensor_in))->pbdev;
+        source->mode = PBIO_IODEV_MODE_EV3_COLOR_SENSOR__REFLECT;
+    } else if (mp_obj_is_type(sensor_in, &ev3devices_UltrasonicSensor_type)) {
+        source->pbdev = ((ev3devices_UltrasonicSensor_obj_t *)MP_OBJ_TO_PTR(sensor_in))->pbdev;
+        source->mode = PBIO_IODEV_MODE_EV3_ULTRASONIC_SENSOR__DIST_CM;
+    } else if (mp_obj_is_type(sensor_in, &ev3devices_InfraredSensor_type)) {
+        source->pbdev = ((ev3devices_InfraredSensor_obj_t *)MP_OBJ_TO_PTR(sensor_in))->pbdev;
+        source->mode = PBIO_IODEV_MODE_EV3_INFRARED_SENSOR__PROX;
+    } else {
+        return false;
+    }
+
+    // Switch to the right mode now, since the background reads can't
+    int32_t values[PBIO_IODEV_MAX_DATA_SIZE];
+    pbdevice_get_values(source->pbdev, source->mode, values);
+    return true;
+}
+
 // dir(pybricks.ev3devices)
 STATIC const mp_rom_map_elem_t ev3devices_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR___name__),         MP_ROM_QSTR(MP_QSTR_ev3devices)              },
@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#ifndef _PYBRICKS_EXTMOD_MODEV3DEVICES_H_
+#define _PYBRICKS_EXTMOD_MODEV3DEVICES_H_
+
+#include <pbio/dcmotor.h>
+
+#include "py/obj.h"
+
+#include "pbdevice.h"
+
+// pybricks.ev3devices.GyroSensor class object
+typedef struct _ev3devices_GyroSensor_obj_t {
+    mp_obj_base_t base;
+    pbio_port_t port; // FIXME: Shouldn't be here
+    pbdevice_t *pbdev;
+    pbio_direction_t direction;
+    mp_int_t offset;
+} ev3devices_GyroSensor_obj_t;
+
+const mp_obj_type_t ev3devices_GyroSensor_type;
+
+void ev3devices_GyroSensor_start_heading(mp_obj_t self_in);
+
+pbio_error_t ev3devices_GyroSensor_get_heading(void *context, int32_t *heading, int32_t *heading_rate);
+
+bool ev3devices_get_source(mp_obj_t sensor_in, pbdevice_source_t *source);
+
+#endif // _PYBRICKS_EXTMOD_MODEV3DEVICES_H_
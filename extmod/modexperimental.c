@@ -8,163 +8,142 @@
 
 #if PYBRICKS_PY_EXPERIMENTAL
 
+#include "py/mphal.h"
 #include "py/obj.h"
 #include "py/runtime.h"
 
 #if PYBRICKS_HUB_CPLUSHUB
 
-#include <lsm6ds3tr_c_reg.h>
-#include <stm32l4xx_hal.h>
-#include <stm32l4xx_ll_i2c.h>
+#include <pbdrv/imu.h>
+#include <pbio/attitude.h>
+
+#include "pberror.h"
+
+// How long to wait for the IMU to give data, such as while it starts (ms)
+#define IMU_TIMEOUT_MS (1000)
 
 typedef struct {
     mp_obj_base_t base;
-    stmdev_ctx_t ctx;
 } mod_experimental_IMU_obj_t;
 
-STATIC I2C_HandleTypeDef hi2c;
-
-void mod_experimental_IMU_handle_i2c_er_irq() {
-    HAL_I2C_ER_IRQHandler(&hi2c);
-}
-
-void mod_experimental_IMU_handle_i2c_ev_irq() {
-    HAL_I2C_EV_IRQHandler(&hi2c);
-}
-
-STATIC int32_t mod_experimental_IMU_write_reg(void *handle, uint8_t reg, uint8_t *data, uint16_t len) {
-    HAL_StatusTypeDef ret;
-
-    ret = HAL_I2C_Mem_Write(&hi2c, LSM6DS3TR_C_I2C_ADD_L, reg, I2C_MEMADD_SIZE_8BIT, data, len, 500);
-
-    return ret;
+// Raises OSError(ETIMEDOUT) if the IMU took too long to give data
+STATIC void mod_experimental_IMU_check_timeout(uint32_t start_time) {
+    if (mp_hal_ticks_ms() - start_time >= IMU_TIMEOUT_MS) {
+        pb_assert(PBIO_ERROR_TIMEDOUT);
+    }
 }
 
-STATIC int32_t mod_experimental_IMU_read_reg(void *handle, uint8_t reg, uint8_t *data, uint16_t len) {
-    HAL_StatusTypeDef ret;
-
-    ret = HAL_I2C_Mem_Read(&hi2c, LSM6DS3TR_C_I2C_ADD_L, reg, I2C_MEMADD_SIZE_8BIT, data, len, 500);
-
-    return ret;
+// Gets the latest sample that was collected by the IMU driver in the background
+STATIC void mod_experimental_IMU_get_sample(pbdrv_imu_sample_t *sample) {
+    pbio_error_t err;
+    uint32_t start_time = mp_hal_ticks_ms();
+    while ((err = pbdrv_imu_get_sample(sample)) == PBIO_ERROR_AGAIN) {
+        mod_experimental_IMU_check_timeout(start_time);
+        MICROPY_EVENT_POLL_HOOK
+    }
+    pb_assert(err);
 }
 
 STATIC mp_obj_t mod_experimental_IMU_make_new(const mp_obj_type_t *otype, size_t n_args, size_t n_kw, const mp_obj_t *args) {
     mod_experimental_IMU_obj_t *self = m_new_obj(mod_experimental_IMU_obj_t);
 
     self->base.type = (mp_obj_type_t *)otype;
-    self->ctx.write_reg = mod_experimental_IMU_write_reg;
-    self->ctx.read_reg = mod_experimental_IMU_read_reg;
-
-    if (hi2c.Instance == NULL) {
-        hi2c.Instance = I2C1;
-        // Clock is 5MHz, so these timing come out to 1 usec. When combined with
-        // internal delays, this is slightly slower than 400kHz
-        hi2c.Init.Timing = __LL_I2C_CONVERT_TIMINGS(0, 0, 0, 4, 4);
-        hi2c.Init.OwnAddress1 = 0;
-        hi2c.Init.AddressingMode = I2C_ADDRESSINGMODE_7BIT;
-        hi2c.Init.DualAddressMode = I2C_DUALADDRESS_DISABLE;
-        hi2c.Init.GeneralCallMode = I2C_GENERALCALL_DISABLE;
-        hi2c.Init.NoStretchMode = I2C_NOSTRETCH_DISABLE;
-        HAL_StatusTypeDef ret = HAL_I2C_Init(&hi2c);
-        if (ret != HAL_OK) {
-            hi2c.Instance = NULL;
-            mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("failed to init I2C"));
-        }
-    }
 
-    uint8_t id;
-    if (lsm6ds3tr_c_device_id_get(&self->ctx, &id) != 0) {
-        mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("failed to get device id"));
-    }
-
-    if (id != LSM6DS3TR_C_ID) {
-        mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("incorrect device id"));
-    }
-
-    // Init based on data polling example
-
-    /*
-     *  Restore default configuration
-     */
-    uint8_t rst;
-    lsm6ds3tr_c_reset_set(&self->ctx, PROPERTY_ENABLE);
-    do {
-        lsm6ds3tr_c_reset_get(&self->ctx, &rst);
-    } while (rst);
-    /*
-     *  Enable Block Data Update
-     */
-    lsm6ds3tr_c_block_data_update_set(&self->ctx, PROPERTY_ENABLE);
-    /*
-     * Set Output Data Rate
-     */
-    lsm6ds3tr_c_xl_data_rate_set(&self->ctx, LSM6DS3TR_C_XL_ODR_12Hz5);
-    lsm6ds3tr_c_gy_data_rate_set(&self->ctx, LSM6DS3TR_C_GY_ODR_12Hz5);
-    /*
-     * Set full scale
-     */
-    lsm6ds3tr_c_xl_full_scale_set(&self->ctx, LSM6DS3TR_C_2g);
-    lsm6ds3tr_c_gy_full_scale_set(&self->ctx, LSM6DS3TR_C_2000dps);
-
-    /*
-     * Configure filtering chain(No aux interface)
-     */
-    /* Accelerometer - analog filter */
-    lsm6ds3tr_c_xl_filter_analog_set(&self->ctx, LSM6DS3TR_C_XL_ANA_BW_400Hz);
-
-    /* Accelerometer - LPF1 path ( LPF2 not used )*/
-    // lsm6ds3tr_c_xl_lp1_bandwidth_set(&self->ctx, LSM6DS3TR_C_XL_LP1_ODR_DIV_4);
-
-    /* Accelerometer - LPF1 + LPF2 path */
-    lsm6ds3tr_c_xl_lp2_bandwidth_set(&self->ctx, LSM6DS3TR_C_XL_LOW_NOISE_LP_ODR_DIV_100);
-
-    /* Accelerometer - High Pass / Slope path */
-    // lsm6ds3tr_c_xl_reference_mode_set(&self->ctx, PROPERTY_DISABLE);
-    // lsm6ds3tr_c_xl_hp_bandwidth_set(&self->ctx, LSM6DS3TR_C_XL_HP_ODR_DIV_100);
-
-    /* Gyroscope - filtering chain */
-    lsm6ds3tr_c_gy_band_pass_set(&self->ctx, LSM6DS3TR_C_HP_260mHz_LP1_STRONG);
+    // Wait for the first sample so we know that the IMU is working
+    pbdrv_imu_sample_t sample;
+    mod_experimental_IMU_get_sample(&sample);
 
     return MP_OBJ_FROM_PTR(self);
 }
 
 STATIC mp_obj_t mod_experimental_IMU_accel(mp_obj_t self_in) {
-    mod_experimental_IMU_obj_t *self = MP_OBJ_TO_PTR(self_in);
-    int16_t data[3];
-
-    if (lsm6ds3tr_c_acceleration_raw_get(&self->ctx, (uint8_t *)data) != 0) {
-        mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("failed to read data"));
-    }
+    pbdrv_imu_sample_t sample;
+    mod_experimental_IMU_get_sample(&sample);
 
+    // mm/s^2 to g
     mp_obj_t values[3];
-    values[0] = mp_obj_new_float_from_f(lsm6ds3tr_c_from_fs2g_to_mg(data[0]) / 1000.0f);
-    values[1] = mp_obj_new_float_from_f(lsm6ds3tr_c_from_fs2g_to_mg(data[1]) / 1000.0f);
-    values[2] = mp_obj_new_float_from_f(lsm6ds3tr_c_from_fs2g_to_mg(data[2]) / 1000.0f);
+    values[0] = mp_obj_new_float_from_f(sample.accel[0] / 9806.65f);
+    values[1] = mp_obj_new_float_from_f(sample.accel[1] / 9806.65f);
+    values[2] = mp_obj_new_float_from_f(sample.accel[2] / 9806.65f);
 
     return mp_obj_new_tuple(3, values);
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_experimental_IMU_accel_obj, mod_experimental_IMU_accel);
 
 STATIC mp_obj_t mod_experimental_IMU_gyro(mp_obj_t self_in) {
-    mod_experimental_IMU_obj_t *self = MP_OBJ_TO_PTR(self_in);
-    int16_t data[3];
+    pbdrv_imu_sample_t sample;
+    mod_experimental_IMU_get_sample(&sample);
+
+    // mdps to dps
+    mp_obj_t values[3];
+    values[0] = mp_obj_new_float_from_f(sample.gyro[0] / 1000.0f);
+    values[1] = mp_obj_new_float_from_f(sample.gyro[1] / 1000.0f);
+    values[2] = mp_obj_new_float_from_f(sample.gyro[2] / 1000.0f);
+
+    return mp_obj_new_tuple(3, values);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_experimental_IMU_gyro_obj, mod_experimental_IMU_gyro);
 
-    if (lsm6ds3tr_c_angular_rate_raw_get(&self->ctx, (uint8_t *)data) != 0) {
-        mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("failed to read data"));
+// Gets the attitude estimate that is updated in the background
+STATIC pbio_attitude_t *mod_experimental_IMU_get_attitude(void) {
+    pbio_attitude_t *att;
+    pbio_error_t err;
+    uint32_t start_time = mp_hal_ticks_ms();
+    while ((err = pbio_attitude_get(&att)) == PBIO_ERROR_AGAIN) {
+        mod_experimental_IMU_check_timeout(start_time);
+        MICROPY_EVENT_POLL_HOOK
     }
+    pb_assert(err);
+    return att;
+}
+
+STATIC mp_obj_t mod_experimental_IMU_tilt(mp_obj_t self_in) {
+    int32_t pitch, roll;
+    pbio_attitude_get_tilt(mod_experimental_IMU_get_attitude(), &pitch, &roll);
+
+    mp_obj_t values[2];
+    values[0] = mp_obj_new_float_from_f(pitch / 1000.0f);
+    values[1] = mp_obj_new_float_from_f(roll / 1000.0f);
 
+    return mp_obj_new_tuple(2, values);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_experimental_IMU_tilt_obj, mod_experimental_IMU_tilt);
+
+STATIC mp_obj_t mod_experimental_IMU_heading(mp_obj_t self_in) {
+    int32_t heading, heading_rate;
+    pbio_attitude_get_heading(mod_experimental_IMU_get_attitude(), &heading, &heading_rate);
+    return mp_obj_new_float_from_f(heading / 1000.0f);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_experimental_IMU_heading_obj, mod_experimental_IMU_heading);
+
+STATIC mp_obj_t mod_experimental_IMU_reset_heading(size_t n_args, const mp_obj_t *args) {
+    mp_int_t heading = n_args > 1 ? mp_obj_get_int(args[1]) : 0;
+    pbio_attitude_reset_heading(mod_experimental_IMU_get_attitude(), heading * 1000);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_experimental_IMU_reset_heading_obj, 1, 2, mod_experimental_IMU_reset_heading);
+
+STATIC mp_obj_t mod_experimental_IMU_angular_velocity(mp_obj_t self_in) {
+    int32_t rate[3];
+    pbio_attitude_get_angular_velocity(mod_experimental_IMU_get_attitude(), rate);
+
+    // mdps to dps
     mp_obj_t values[3];
-    values[0] = mp_obj_new_float_from_f(lsm6ds3tr_c_from_fs2000dps_to_mdps(data[0]) / 1000.0f);
-    values[1] = mp_obj_new_float_from_f(lsm6ds3tr_c_from_fs2000dps_to_mdps(data[1]) / 1000.0f);
-    values[2] = mp_obj_new_float_from_f(lsm6ds3tr_c_from_fs2000dps_to_mdps(data[2]) / 1000.0f);
+    values[0] = mp_obj_new_float_from_f(rate[0] / 1000.0f);
+    values[1] = mp_obj_new_float_from_f(rate[1] / 1000.0f);
+    values[2] = mp_obj_new_float_from_f(rate[2] / 1000.0f);
 
     return mp_obj_new_tuple(3, values);
 }
-STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_experimental_IMU_gyro_obj, mod_experimental_IMU_gyro);
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_experimental_IMU_angular_velocity_obj, mod_experimental_IMU_angular_velocity);
 
 STATIC const mp_rom_map_elem_t mod_experimental_IMU_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_accel), MP_ROM_PTR(&mod_experimental_IMU_accel_obj) },
     { MP_ROM_QSTR(MP_QSTR_gyro), MP_ROM_PTR(&mod_experimental_IMU_gyro_obj) },
+    { MP_ROM_QSTR(MP_QSTR_angular_velocity), MP_ROM_PTR(&mod_experimental_IMU_angular_velocity_obj) },
+    { MP_ROM_QSTR(MP_QSTR_tilt), MP_ROM_PTR(&mod_experimental_IMU_tilt_obj) },
+    { MP_ROM_QSTR(MP_QSTR_heading), MP_ROM_PTR(&mod_experimental_IMU_heading_obj) },
+    { MP_ROM_QSTR(MP_QSTR_reset_heading), MP_ROM_PTR(&mod_experimental_IMU_reset_heading_obj) },
 };
 STATIC MP_DEFINE_CONST_DICT(mod_experimental_IMU_locals_dict, mod_experimental_IMU_locals_dict_table);
 
@@ -10,6 +10,8 @@
 #include "modbuiltins.h"
 #include "modbuiltins.h"
 
+#include "py/runtime.h"
+
 #include "pberror.h"
 #include "pbobj.h"
 
@@ -33,9 +35,10 @@ STATIC mp_obj_t hubs_EV3Brick_make_new(const mp_obj_type_t *type, size_t n_args,
     hubs_EV3Brick_obj_t *self = m_new_obj(hubs_EV3Brick_obj_t);
     self->base.type = (mp_obj_type_t *)type;
 
-    mp_obj_t screen_args[] = { MP_ROM_QSTR(MP_QSTR__screen_) };
-    self->screen = pb_type_ev3dev_Image.make_new(&pb_type_ev3dev_Image, 1, 0, screen_args);
-    self->speaker = pb_type_ev3dev_Speaker.make_new(&pb_type_ev3dev_Speaker, 0, 0, NULL);
+    // The screen and speaker are created when they are first used, because
+    // starting the graphics and sound takes a while.
+    self->screen = MP_OBJ_NULL;
+    self->speaker = MP_OBJ_NULL;
 
     // Create an instance of the Light class, representing the brick status light
     self->light = builtins_ColorLight_obj_make_new(NULL);
@@ -55,10 +58,48 @@ STATIC const mp_rom_map_elem_t hubs_EV3Brick_locals_dict_table[] = {
 };
 STATIC MP_DEFINE_CONST_DICT(hubs_EV3Brick_locals_dict, hubs_EV3Brick_locals_dict_table);
 
+// Gets the attributes of EV3Brick. The screen and speaker are created on first
+// use. The light is an instance attribute too. Everything else comes from the
+// locals dict, like for any other type.
+STATIC void hubs_EV3Brick_attr(mp_obj_t self_in, qstr attr, mp_obj_t *dest) {
+    if (dest[0] != MP_OBJ_NULL) {
+        // Attributes can't be changed or deleted
+        return;
+    }
+
+    hubs_EV3Brick_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+    switch (attr) {
+        case MP_QSTR_screen:
+            if (self->screen == MP_OBJ_NULL) {
+                mp_obj_t screen_args[] = { MP_ROM_QSTR(MP_QSTR__screen_) };
+                self->screen = pb_type_ev3dev_Image.make_new(&pb_type_ev3dev_Image, 1, 0, screen_args);
+            }
+            dest[0] = self->screen;
+            return;
+        case MP_QSTR_speaker:
+            if (self->speaker == MP_OBJ_NULL) {
+                self->speaker = pb_type_ev3dev_Speaker.make_new(&pb_type_ev3dev_Speaker, 0, 0, NULL);
+            }
+            dest[0] = self->speaker;
+            return;
+        case MP_QSTR_light:
+            dest[0] = self->light;
+            return;
+    }
+
+    // A type with an attr handler does not get the generic lookup, so do it here
+    mp_map_elem_t *elem = mp_map_lookup((mp_map_t *)&hubs_EV3Brick_locals_dict.map, MP_OBJ_NEW_QSTR(attr), MP_MAP_LOOKUP);
+    if (elem) {
+        mp_convert_member_lookup(self_in, mp_obj_get_type(self_in), elem->value, dest);
+    }
+}
+
 STATIC const mp_obj_type_t hubs_EV3Brick_type = {
     { &mp_type_type },
     .name = MP_QSTR_EV3Brick,
     .make_new = hubs_EV3Brick_make_new,
+    .attr = hubs_EV3Brick_attr,
     .locals_dict = (mp_obj_dict_t *)&hubs_EV3Brick_locals_dict,
 };
 
@@ -21,6 +21,18 @@
 
 #if PYBRICKS_PY_IODEVICES
 
+// Gets the receive time (same time base as utime.ticks_us) and
+// sequence number of the most recent sample as a tuple.
+STATIC mp_obj_t iodevices_get_timestamp(pbdevice_t *pbdev) {
+    uint32_t timestamp, seq;
+    pbdevice_get_timestamp(pbdev, &timestamp, &seq);
+
+    mp_obj_t ret[2];
+    ret[0] = mp_obj_new_int_from_uint(timestamp);
+    ret[1] = mp_obj_new_int_from_uint(seq);
+    return mp_obj_new_tuple(2, ret);
+}
+
 // Class structure for LUMPDevice
 typedef struct _iodevices_LUMPDevice_obj_t {
     mp_obj_base_t base;
@@ -112,10 +124,18 @@ STATIC mp_obj_t iodevices_LUMPDevice_write(size_t n_args, const mp_obj_t *pos_ar
 }
 MP_DEFINE_CONST_FUN_OBJ_KW(iodevices_LUMPDevice_write_obj, 1, iodevices_LUMPDevice_write);
 
+// pybricks.iodevices.LUMPDevice.timestamp
+STATIC mp_obj_t iodevices_LUMPDevice_timestamp(mp_obj_t self_in) {
+    iodevices_LUMPDevice_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    return iodevices_get_timestamp(self->pbdev);
+}
+MP_DEFINE_CONST_FUN_OBJ_1(iodevices_LUMPDevice_timestamp_obj, iodevices_LUMPDevice_timestamp);
+
 // dir(pybricks.iodevices.LUMPDevice)
 STATIC const mp_rom_map_elem_t iodevices_LUMPDevice_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_read),       MP_ROM_PTR(&iodevices_LUMPDevice_read_obj) },
     { MP_ROM_QSTR(MP_QSTR_write),      MP_ROM_PTR(&iodevices_LUMPDevice_write_obj)},
+    { MP_ROM_QSTR(MP_QSTR_timestamp),  MP_ROM_PTR(&iodevices_LUMPDevice_timestamp_obj)},
     { MP_ROM_QSTR(MP_QSTR_ID),         MP_ROM_ATTRIBUTE_OFFSET(iodevices_LUMPDevice_obj_t, id) },
 };
 STATIC MP_DEFINE_CONST_DICT(iodevices_LUMPDevice_locals_dict, iodevices_LUMPDevice_locals_dict_table);
@@ -584,9 +604,17 @@ STATIC mp_obj_t iodevices_Ev3devSensor_read(size_t n_args, const mp_obj_t *pos_a
 }
 MP_DEFINE_CONST_FUN_OBJ_KW(iodevices_Ev3devSensor_read_obj, 1, iodevices_Ev3devSensor_read);
 
+// pybricks.iodevices.Ev3devSensor.timestamp
+STATIC mp_obj_t iodevices_Ev3devSensor_timestamp(mp_obj_t self_in) {
+    iodevices_Ev3devSensor_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    return iodevices_get_timestamp(self->pbdev);
+}
+MP_DEFINE_CONST_FUN_OBJ_1(iodevices_Ev3devSensor_timestamp_obj, iodevices_Ev3devSensor_timestamp);
+
 // dir(pybricks.iodevices.Ev3devSensor)
 STATIC const mp_rom_map_elem_t iodevices_Ev3devSensor_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_read),         MP_ROM_PTR(&iodevices_Ev3devSensor_read_obj)                        },
+    { MP_ROM_QSTR(MP_QSTR_timestamp),    MP_ROM_PTR(&iodevices_Ev3devSensor_timestamp_obj)                   },
     { MP_ROM_QSTR(MP_QSTR_sensor_index), MP_ROM_ATTRIBUTE_OFFSET(iodevices_Ev3devSensor_obj_t, sensor_index) },
     { MP_ROM_QSTR(MP_QSTR_port_index),   MP_ROM_ATTRIBUTE_OFFSET(iodevices_Ev3devSensor_obj_t, port_index)   },
 };
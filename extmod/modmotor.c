@@ -19,9 +19,11 @@
 #include "modmotor.h"
 #include "modlogger.h"
 #include "modparameters.h"
+#include "modtools.h"
 #include "pberror.h"
 #include "pbobj.h"
 #include "pbkwarg.h"
+#include "pbmotorevent.h"
 
 // pybricks.builtins.DCMotor.__init__
 STATIC mp_obj_t motor_DCMotor_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args) {
@@ -148,16 +150,64 @@ const mp_obj_type_t motor_DCMotor_type = {
     .locals_dict = (mp_obj_dict_t *)&motor_DCMotor_locals_dict,
 };
 
-/* Wait for servo maneuver to complete */
-
-STATIC void wait_for_completion(pbio_servo_t *srv) {
-    pbio_error_t err;
-    while ((err = pbio_motorpoll_get_servo_status(srv)) == PBIO_ERROR_AGAIN && !pbio_control_is_done(&srv->control)) {
-        mp_hal_delay_ms(5);
+// Waits until the control loops emit an event after the given event count.
+void pb_motor_wait_for_event(uint32_t event_count) {
+    #if PYBRICKS_PORT_CONTROL_THREAD
+    // The control loops may run in another thread, which wakes us up
+    pb_motor_event_wait(event_count);
+    #else
+    // The control loops run in the event hook, which sleeps until the next tick
+    while (pbio_motorpoll_get_event_count() == event_count) {
+        MICROPY_EVENT_POLL_HOOK
     }
+    #endif
+}
+
+// Checks if the maneuver is done. Raises an exception if the control loop
+// stopped because of an error.
+bool motor_Motor_test_completion(mp_obj_t self_in, uint32_t end_time) {
+    motor_Motor_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    pbio_error_t err = pbio_motorpoll_get_servo_status(self->srv);
     if (err != PBIO_ERROR_AGAIN) {
         pb_assert(err);
+        return true;
     }
+    return pbio_control_is_done(&self->srv->control);
+}
+
+/* Wait for servo maneuver to complete */
+
+STATIC void wait_for_completion(motor_Motor_obj_t *self) {
+    for (;;) {
+        // Get the event count first, so no event is missed after the check
+        uint32_t event_count = pbio_motorpoll_get_event_count();
+        if (motor_Motor_test_completion(MP_OBJ_FROM_PTR(self), 0)) {
+            return;
+        }
+        pb_motor_wait_for_event(event_count);
+    }
+}
+
+#if PYBRICKS_PY_TOOLS_TASKS
+
+STATIC void motor_Motor_cancel(mp_obj_t self_in) {
+    motor_Motor_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    pbio_servo_stop(self->srv, PBIO_ACTUATION_COAST);
+}
+
+#endif // PYBRICKS_PY_TOOLS_TASKS
+
+// Waits for the maneuver to complete. In a task, this returns an awaitable
+// instead, so that other tasks can run in the mean time.
+STATIC mp_obj_t wait_or_await_completion(motor_Motor_obj_t *self) {
+    #if PYBRICKS_PY_TOOLS_TASKS
+    if (pb_module_tools_run_loop_is_active()) {
+        return pb_module_tools_awaitable_new(MP_OBJ_FROM_PTR(self), 0,
+            motor_Motor_test_completion, motor_Motor_cancel);
+    }
+    #endif
+    wait_for_completion(self);
+    return mp_const_none;
 }
 
 // pybricks.builtins.Motor.__init__
@@ -322,7 +372,7 @@ STATIC mp_obj_t motor_Motor_run_time(size_t n_args, const mp_obj_t *pos_args, mp
     pb_assert(pbio_servo_run_time(self->srv, speed_arg, time_arg, after_stop));
 
     if (mp_obj_is_true(wait)) {
-        wait_for_completion(self->srv);
+        return wait_or_await_completion(self);
     }
 
     return mp_const_none;
@@ -366,7 +416,7 @@ STATIC mp_obj_t motor_Motor_run_until_stalled(size_t n_args, const mp_obj_t *pos
 
         // In this command we always wait for completion, so we can return the
         // final angle below.
-        wait_for_completion(self->srv);
+        wait_for_completion(self);
 
         nlr_pop();
     } else {
@@ -408,7 +458,7 @@ STATIC mp_obj_t motor_Motor_run_angle(size_t n_args, const mp_obj_t *pos_args, m
     pb_assert(pbio_servo_run_angle(self->srv, speed_arg, angle_arg, after_stop));
 
     if (mp_obj_is_true(wait)) {
-        wait_for_completion(self->srv);
+        return wait_or_await_completion(self);
     }
 
     return mp_const_none;
@@ -432,7 +482,7 @@ STATIC mp_obj_t motor_Motor_run_target(size_t n_args, const mp_obj_t *pos_args,
     pb_assert(pbio_servo_run_target(self->srv, speed_arg, angle_arg, after_stop));
 
     if (mp_obj_is_true(wait)) {
-        wait_for_completion(self->srv);
+        return wait_or_await_completion(self);
     }
 
     return mp_const_none;
@@ -17,6 +17,10 @@ typedef struct _motor_Motor_obj_t {
 
 const mp_obj_type_t motor_Motor_type;
 
+bool motor_Motor_test_completion(mp_obj_t self_in, uint32_t end_time);
+
+void pb_motor_wait_for_event(uint32_t event_count);
+
 // pybricks.builtins.DCMotor class object
 typedef struct _motor_DCMotor_obj_t {
     mp_obj_base_t base;
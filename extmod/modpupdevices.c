@@ -25,6 +25,7 @@
 #include "modbuiltins.h"
 #include "modparameters.h"
 #include "modmotor.h"
+#include "modpupdevices.h"
 
 // Class structure for ColorDistanceSensor
 typedef struct _pupdevices_ColorDistanceSensor_obj_t {
@@ -291,6 +292,26 @@ STATIC mp_obj_t pupdevices_ColorSensor_color_map(size_t n_args, const mp_obj_t *
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(pupdevices_ColorSensor_color_map_obj, 1, pupdevices_ColorSensor_color_map);
 
+#if PYBRICKS_PY_PUPDEVICES_TRAINING
+// pybricks.pupdevices.ColorSensor.train
+STATIC mp_obj_t pupdevices_ColorSensor_train(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    PB_PARSE_ARGS_METHOD(n_args, pos_args, kw_args,
+        pupdevices_ColorSensor_obj_t, self,
+        PB_ARG_REQUIRED(color),
+        PB_ARG_DEFAULT_TRUE(surface));
+
+    // Read HSV, either with light on or off
+    int32_t hsv[4];
+    pupdevices_ColorSensor__get_hsv(self->pbdev, mp_obj_is_true(surface), hsv);
+
+    // Add it as a sample of the given color
+    pb_hsv_train(&self->color_map, color, hsv[0], hsv[1], hsv[2]);
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(pupdevices_ColorSensor_train_obj, 1, pupdevices_ColorSensor_train);
+#endif // PYBRICKS_PY_PUPDEVICES_TRAINING
+
 // pybricks.pupdevices.ColorSensor.reflection
 STATIC mp_obj_t pupdevices_ColorSensor_reflection(mp_obj_t self_in) {
     pupdevices_ColorSensor_obj_t *self = MP_OBJ_TO_PTR(self_in);
@@ -325,6 +346,9 @@ STATIC const mp_rom_map_elem_t pupdevices_ColorSensor_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_reflection),  MP_ROM_PTR(&pupdevices_ColorSensor_reflection_obj)           },
     { MP_ROM_QSTR(MP_QSTR_ambient),     MP_ROM_PTR(&pupdevices_ColorSensor_ambient_obj)              },
     { MP_ROM_QSTR(MP_QSTR_color_map),   MP_ROM_PTR(&pupdevices_ColorSensor_color_map_obj)            },
+    #if PYBRICKS_PY_PUPDEVICES_TRAINING
+    { MP_ROM_QSTR(MP_QSTR_train),       MP_ROM_PTR(&pupdevices_ColorSensor_train_obj)                },
+    #endif
 };
 STATIC MP_DEFINE_CONST_DICT(pupdevices_ColorSensor_locals_dict, pupdevices_ColorSensor_locals_dict_table);
 
@@ -584,6 +608,40 @@ STATIC const mp_obj_type_t pupdevices_Light_type = {
     .locals_dict = (mp_obj_dict_t *)&pupdevices_Light_locals_dict,
 };
 
+// Sensor value that can steer a drivebase in the background
+bool pupdevices_get_source(mp_obj_t sensor_in, pbdevice_source_t *source) {
+
+    int32_t values[PBIO_IODEV_MAX_DATA_SIZE];
+
+    source->out_of_range = 0;
+
+    if (mp_obj_is_type(sensor_in, &pupdevices_ColorDistanceSensor_type)) {
+        source->pbdev = ((pupdevices_ColorDistanceSensor_obj_t *)MP_OBJ_TO_PTR(sensor_in))->pbdev;
+        source->mode = PBIO_IODEV_MODE_PUP_COLOR_DISTANCE_SENSOR__SPEC1;
+        source->index = 3;
+        source->divisor = 1;
+    } else if (mp_obj_is_type(sensor_in, &pupdevices_ColorSensor_type)) {
+        // Same scaling as ColorSensor.reflection()
+        source->pbdev = ((pupdevices_ColorSensor_obj_t *)MP_OBJ_TO_PTR(sensor_in))->pbdev;
+        source->mode = PBIO_IODEV_MODE_PUP_COLOR_SENSOR__HSV;
+        source->index = 2;
+        source->divisor = 5;
+    } else if (mp_obj_is_type(sensor_in, &pupdevices_UltrasonicSensor_type)) {
+        source->pbdev = ((pupdevices_UltrasonicSensor_obj_t *)MP_OBJ_TO_PTR(sensor_in))->pbdev;
+        source->mode = PBIO_IODEV_MODE_PUP_ULTRASONIC_SENSOR__DISTL;
+        source->index = 0;
+        source->divisor = 1;
+        // Same as UltrasonicSensor.distance() when there is no echo
+        source->out_of_range = 3000;
+    } else {
+        return false;
+    }
+
+    // Switch to the right mode now, since the background reads can't
+    pbdevice_get_values(source->pbdev, source->mode, values);
+    return true;
+}
+
 // dir(pybricks.pupdevices)
 STATIC const mp_rom_map_elem_t pupdevices_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR___name__),            MP_ROM_QSTR(MP_QSTR_pupdevices)                  },
@@ -0,0 +1,13 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#ifndef _PYBRICKS_EXTMOD_MODPUPDEVICES_H_
+#define _PYBRICKS_EXTMOD_MODPUPDEVICES_H_
+
+#include "py/obj.h"
+
+#include "pbdevice.h"
+
+bool pupdevices_get_source(mp_obj_t sensor_in, pbdevice_source_t *source);
+
+#endif // _PYBRICKS_EXTMOD_MODPUPDEVICES_H_
@@ -5,6 +5,7 @@
 
 #include <math.h>
 
+#include <pbio/attitude.h>
 #include <pbio/drivebase.h>
 #include <pbio/motorpoll.h>
 
@@ -12,14 +13,23 @@
 #include "py/runtime.h"
 #include "py/obj.h"
 
+#include "pbdevice.h"
 #include "pberror.h"
 #include "pbobj.h"
 #include "pbkwarg.h"
 
 #include "modparameters.h"
 #include "modbuiltins.h"
+#if PYBRICKS_PY_EV3DEVICES
+#include "modev3devices.h"
+#endif
+#if PYBRICKS_PY_PUPDEVICES
+#include "modpupdevices.h"
+#endif
 #include "modmotor.h"
 #include "modlogger.h"
+#include "modrobotics.h"
+#include "modtools.h"
 
 #if PYBRICKS_PY_ROBOTICS
 
@@ -38,6 +48,10 @@ typedef struct _robotics_DriveBase_obj_t {
     int32_t turn_acceleration;
 } robotics_DriveBase_obj_t;
 
+// Sensor value that the drivebase follows. There is only one drivebase, and
+// the control loop may outlive the DriveBase object, so this is not part of it.
+STATIC pbdevice_source_t robotics_DriveBase_follow_source;
+
 // pybricks.robotics.DriveBase.__init__
 STATIC mp_obj_t robotics_DriveBase_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args) {
 
@@ -66,6 +80,10 @@ STATIC mp_obj_t robotics_DriveBase_make_new(const mp_obj_type_t *type, size_t n_
     // Create drivebase
     pb_assert(pbio_motorpoll_get_drivebase(&self->db));
     pb_assert(pbio_drivebase_setup(self->db, srv_left, srv_right, pb_obj_get_fix16(wheel_diameter), pb_obj_get_fix16(axle_track)));
+
+    // The setup cleared the heading and follow sources of any previous DriveBase
+    MP_STATE_PORT(robotics_drivebase_gyro) = mp_const_none;
+    MP_STATE_PORT(robotics_drivebase_sensor) = mp_const_none;
     pb_assert(pbio_motorpoll_set_drivebase_status(self->db, PBIO_ERROR_AGAIN));
 
     // Create an instance of the Logger class
@@ -88,14 +106,49 @@ STATIC mp_obj_t robotics_DriveBase_make_new(const mp_obj_type_t *type, size_t n_
     return MP_OBJ_FROM_PTR(self);
 }
 
-STATIC void wait_for_completion_drivebase(pbio_drivebase_t *db) {
-    pbio_error_t err;
-    while ((err = pbio_motorpoll_get_drivebase_status(db)) == PBIO_ERROR_AGAIN && (!pbio_control_is_done(&db->control_distance) || !pbio_control_is_done(&db->control_heading))) {
-        mp_hal_delay_ms(5);
-    }
+// Checks if the maneuver is done. Raises an exception if the control loop
+// stopped because of an error.
+bool robotics_DriveBase_test_completion(mp_obj_t self_in, uint32_t end_time) {
+    robotics_DriveBase_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    pbio_error_t err = pbio_motorpoll_get_drivebase_status(self->db);
     if (err != PBIO_ERROR_AGAIN) {
         pb_assert(err);
+        return true;
     }
+    return pbio_control_is_done(&self->db->control_distance) && pbio_control_is_done(&self->db->control_heading);
+}
+
+STATIC void wait_for_completion_drivebase(robotics_DriveBase_obj_t *self) {
+    for (;;) {
+        // Get the event count first, so no event is missed after the check
+        uint32_t event_count = pbio_motorpoll_get_event_count();
+        if (robotics_DriveBase_test_completion(MP_OBJ_FROM_PTR(self), 0)) {
+            return;
+        }
+        pb_motor_wait_for_event(event_count);
+    }
+}
+
+#if PYBRICKS_PY_TOOLS_TASKS
+
+STATIC void robotics_DriveBase_cancel(mp_obj_t self_in) {
+    robotics_DriveBase_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    pbio_drivebase_stop(self->db, PBIO_ACTUATION_COAST);
+}
+
+#endif // PYBRICKS_PY_TOOLS_TASKS
+
+// Waits for the maneuver to complete. In a task, this returns an awaitable
+// instead, so that other tasks can run in the mean time.
+STATIC mp_obj_t wait_or_await_completion_drivebase(robotics_DriveBase_obj_t *self) {
+    #if PYBRICKS_PY_TOOLS_TASKS
+    if (pb_module_tools_run_loop_is_active()) {
+        return pb_module_tools_awaitable_new(MP_OBJ_FROM_PTR(self), 0,
+            robotics_DriveBase_test_completion, robotics_DriveBase_cancel);
+    }
+    #endif
+    wait_for_completion_drivebase(self);
+    return mp_const_none;
 }
 
 // pybricks.robotics.DriveBase.straight
@@ -107,9 +160,7 @@ STATIC mp_obj_t robotics_DriveBase_straight(size_t n_args, const mp_obj_t *pos_a
     int32_t distance_val = pb_obj_get_int(distance);
     pb_assert(pbio_drivebase_straight(self->db, distance_val, self->straight_speed, self->straight_acceleration));
 
-    wait_for_completion_drivebase(self->db);
-
-    return mp_const_none;
+    return wait_or_await_completion_drivebase(self);
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(robotics_DriveBase_straight_obj, 1, robotics_DriveBase_straight);
 
@@ -122,9 +173,7 @@ STATIC mp_obj_t robotics_DriveBase_turn(size_t n_args, const mp_obj_t *pos_args,
     int32_t angle_val = pb_obj_get_int(angle);
     pb_assert(pbio_drivebase_turn(self->db, angle_val, self->turn_rate, self->turn_acceleration));
 
-    wait_for_completion_drivebase(self->db);
-
-    return mp_const_none;
+    return wait_or_await_completion_drivebase(self);
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(robotics_DriveBase_turn_obj, 1, robotics_DriveBase_turn);
 
@@ -145,6 +194,84 @@ STATIC mp_obj_t robotics_DriveBase_drive(size_t n_args, const mp_obj_t *pos_args
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(robotics_DriveBase_drive_obj, 1, robotics_DriveBase_drive);
 
+// pybricks.robotics.DriveBase.follow_path
+STATIC mp_obj_t robotics_DriveBase_follow_path(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    PB_PARSE_ARGS_METHOD(n_args, pos_args, kw_args,
+        robotics_DriveBase_obj_t, self,
+        PB_ARG_REQUIRED(path),
+        PB_ARG_DEFAULT_NONE(speed),
+        PB_ARG_DEFAULT_NONE(acceleration),
+        PB_ARG_DEFAULT_TRUE(wait));
+
+    // The path is a sequence of (distance, angle) segments
+    size_t num_segments;
+    mp_obj_t *segment_objs;
+    mp_obj_get_array(path, &num_segments, &segment_objs);
+    if (num_segments > PBIO_DRIVEBASE_PATH_MAX_SEGMENTS) {
+        pb_assert(PBIO_ERROR_INVALID_ARG);
+    }
+
+    pbio_drivebase_path_segment_t segments[PBIO_DRIVEBASE_PATH_MAX_SEGMENTS];
+    for (size_t i = 0; i < num_segments; i++) {
+        mp_obj_t *values;
+        mp_obj_get_array_fixed_n(segment_objs[i], 2, &values);
+        segments[i].distance = pb_obj_get_int(values[0]);
+        segments[i].angle = pb_obj_get_int(values[1]);
+    }
+
+    int32_t speed_val = pb_obj_get_default_int(speed, self->straight_speed);
+    int32_t acceleration_val = pb_obj_get_default_int(acceleration, self->straight_acceleration);
+
+    pb_assert(pbio_drivebase_follow_path(self->db, segments, num_segments, speed_val, acceleration_val));
+
+    if (mp_obj_is_true(wait)) {
+        return wait_or_await_completion_drivebase(self);
+    }
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(robotics_DriveBase_follow_path_obj, 1, robotics_DriveBase_follow_path);
+
+// pybricks.robotics.DriveBase.follow
+STATIC mp_obj_t robotics_DriveBase_follow(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    PB_PARSE_ARGS_METHOD(n_args, pos_args, kw_args,
+        robotics_DriveBase_obj_t, self,
+        PB_ARG_REQUIRED(sensor),
+        PB_ARG_REQUIRED(target),
+        PB_ARG_REQUIRED(kp),
+        PB_ARG_DEFAULT_INT(ki, 0),
+        PB_ARG_DEFAULT_INT(kd, 0),
+        PB_ARG_DEFAULT_NONE(speed));
+
+    // Get the sensor value that steers the drivebase
+    pbdevice_source_t source;
+    bool supported = false;
+    #if PYBRICKS_PY_EV3DEVICES
+    supported = supported || ev3devices_get_source(sensor, &source);
+    #endif
+    #if PYBRICKS_PY_PUPDEVICES
+    supported = supported || pupdevices_get_source(sensor, &source);
+    #endif
+    if (!supported) {
+        pb_assert(PBIO_ERROR_INVALID_ARG);
+    }
+
+    // The control loop only reads the source while holding the GIL, so it
+    // can be replaced while in use. Keep the sensor with it.
+    robotics_DriveBase_follow_source = source;
+    MP_STATE_PORT(robotics_drivebase_sensor) = sensor;
+
+    int32_t speed_val = pb_obj_get_default_int(speed, self->straight_speed);
+
+    // The sensor value is positive if it is above target, so this turns
+    // right when the sensor sees more than the target value.
+    pb_assert(pbio_drivebase_follow(self->db, pbdevice_source_get_value, &robotics_DriveBase_follow_source, pb_obj_get_int(target),
+        -pb_obj_get_fix16(kp), -pb_obj_get_fix16(ki), -pb_obj_get_fix16(kd), speed_val));
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(robotics_DriveBase_follow_obj, 1, robotics_DriveBase_follow);
+
 // pybricks.builtins.DriveBase.stop
 STATIC mp_obj_t robotics_DriveBase_stop(mp_obj_t self_in) {
     robotics_DriveBase_obj_t *self = MP_OBJ_TO_PTR(self_in);
@@ -203,6 +330,119 @@ STATIC mp_obj_t robotics_DriveBase_reset(mp_obj_t self_in) {
 }
 MP_DEFINE_CONST_FUN_OBJ_1(robotics_DriveBase_reset_obj, robotics_DriveBase_reset);
 
+// How long to wait for the first pose update (ms)
+#define POSE_TIMEOUT_MS (100)
+
+// pybricks.robotics.DriveBase.pose
+STATIC mp_obj_t robotics_DriveBase_pose(mp_obj_t self_in) {
+    robotics_DriveBase_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+    // Pose is integrated in the background, so it is valid after the first
+    // update. That update never comes if the control loop stopped.
+    int32_t x, y, theta;
+    pbio_error_t err;
+    uint32_t end_time = mp_hal_ticks_ms() + POSE_TIMEOUT_MS;
+    while ((err = pbio_drivebase_get_pose(self->db, &x, &y, &theta)) == PBIO_ERROR_AGAIN) {
+        pbio_error_t status = pbio_motorpoll_get_drivebase_status(self->db);
+        if (status != PBIO_ERROR_AGAIN) {
+            pb_assert(status);
+            pb_assert(PBIO_ERROR_INVALID_OP);
+        }
+        if ((int32_t)(mp_hal_ticks_ms() - end_time) >= 0) {
+            pb_assert(PBIO_ERROR_TIMEDOUT);
+        }
+        mp_hal_delay_ms(1);
+    }
+    pb_assert(err);
+
+    mp_obj_t ret[3];
+    ret[0] = mp_obj_new_int(x);
+    ret[1] = mp_obj_new_int(y);
+    ret[2] = mp_obj_new_int(theta);
+
+    return mp_obj_new_tuple(3, ret);
+}
+MP_DEFINE_CONST_FUN_OBJ_1(robotics_DriveBase_pose_obj, robotics_DriveBase_pose);
+
+// pybricks.robotics.DriveBase.reset_pose
+STATIC mp_obj_t robotics_DriveBase_reset_pose(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    PB_PARSE_ARGS_METHOD(n_args, pos_args, kw_args,
+        robotics_DriveBase_obj_t, self,
+        PB_ARG_DEFAULT_INT(x, 0),
+        PB_ARG_DEFAULT_INT(y, 0),
+        PB_ARG_DEFAULT_INT(angle, 0));
+
+    pb_assert(pbio_drivebase_reset_pose(self->db, pb_obj_get_int(x), pb_obj_get_int(y), pb_obj_get_int(angle)));
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(robotics_DriveBase_reset_pose_obj, 1, robotics_DriveBase_reset_pose);
+
+#if PBIO_CONFIG_ATTITUDE
+// How long to wait for the IMU to start giving samples (ms)
+#define IMU_TIMEOUT_MS (1000)
+
+// Heading source for drivebase using the hub IMU
+STATIC pbio_error_t robotics_DriveBase_get_imu_heading(void *context, int32_t *heading, int32_t *heading_rate) {
+    pbio_attitude_t *att;
+    pbio_error_t err = pbio_attitude_get(&att);
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+    pbio_attitude_get_heading(att, heading, heading_rate);
+
+    // The hub heading is counterclockwise positive
+    *heading = -*heading;
+    *heading_rate = -*heading_rate;
+    return PBIO_SUCCESS;
+}
+#endif // PBIO_CONFIG_ATTITUDE
+
+// pybricks.robotics.DriveBase.use_gyro
+STATIC mp_obj_t robotics_DriveBase_use_gyro(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    PB_PARSE_ARGS_METHOD(n_args, pos_args, kw_args,
+        robotics_DriveBase_obj_t, self,
+        PB_ARG_REQUIRED(gyro));
+
+    pbio_drivebase_heading_func_t func = NULL;
+    void *context = NULL;
+
+    #if PYBRICKS_PY_EV3DEVICES
+    if (mp_obj_is_type(gyro, &ev3devices_GyroSensor_type)) {
+        ev3devices_GyroSensor_start_heading(gyro);
+        func = ev3devices_GyroSensor_get_heading;
+        context = MP_OBJ_TO_PTR(gyro);
+    } else
+    #endif
+    if (mp_obj_is_true(gyro)) {
+        #if PBIO_CONFIG_ATTITUDE
+        // Wait for the IMU to start giving samples
+        pbio_attitude_t *att;
+        pbio_error_t err;
+        uint32_t start_time = mp_hal_ticks_ms();
+        while ((err = pbio_attitude_get(&att)) == PBIO_ERROR_AGAIN) {
+            if (mp_hal_ticks_ms() - start_time >= IMU_TIMEOUT_MS) {
+                pb_assert(PBIO_ERROR_TIMEDOUT);
+            }
+            MICROPY_EVENT_POLL_HOOK
+        }
+        pb_assert(err);
+        func = robotics_DriveBase_get_imu_heading;
+        #else
+        pb_assert(PBIO_ERROR_NOT_SUPPORTED);
+        #endif
+    }
+
+    pb_assert(pbio_drivebase_set_heading_source(self->db, func, context));
+
+    // The control loop keeps using the gyro after this DriveBase object may
+    // be gone, so keep the reference with the drivebase slot.
+    MP_STATE_PORT(robotics_drivebase_gyro) = func ? gyro : mp_const_none;
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(robotics_DriveBase_use_gyro_obj, 1, robotics_DriveBase_use_gyro);
+
 // pybricks.robotics.DriveBase.settings
 STATIC mp_obj_t robotics_DriveBase_settings(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
 
@@ -250,12 +490,17 @@ STATIC const mp_rom_map_elem_t robotics_DriveBase_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_straight),         MP_ROM_PTR(&robotics_DriveBase_straight_obj) },
     { MP_ROM_QSTR(MP_QSTR_turn),             MP_ROM_PTR(&robotics_DriveBase_turn_obj)     },
     { MP_ROM_QSTR(MP_QSTR_drive),            MP_ROM_PTR(&robotics_DriveBase_drive_obj)    },
+    { MP_ROM_QSTR(MP_QSTR_follow_path),      MP_ROM_PTR(&robotics_DriveBase_follow_path_obj) },
+    { MP_ROM_QSTR(MP_QSTR_follow),           MP_ROM_PTR(&robotics_DriveBase_follow_obj)   },
     { MP_ROM_QSTR(MP_QSTR_stop),             MP_ROM_PTR(&robotics_DriveBase_stop_obj)     },
     { MP_ROM_QSTR(MP_QSTR_distance),         MP_ROM_PTR(&robotics_DriveBase_distance_obj) },
     { MP_ROM_QSTR(MP_QSTR_angle),            MP_ROM_PTR(&robotics_DriveBase_angle_obj)    },
     { MP_ROM_QSTR(MP_QSTR_state),            MP_ROM_PTR(&robotics_DriveBase_state_obj)    },
     { MP_ROM_QSTR(MP_QSTR_reset),            MP_ROM_PTR(&robotics_DriveBase_reset_obj)    },
+    { MP_ROM_QSTR(MP_QSTR_pose),             MP_ROM_PTR(&robotics_DriveBase_pose_obj)     },
+    { MP_ROM_QSTR(MP_QSTR_reset_pose),       MP_ROM_PTR(&robotics_DriveBase_reset_pose_obj) },
     { MP_ROM_QSTR(MP_QSTR_settings),         MP_ROM_PTR(&robotics_DriveBase_settings_obj) },
+    { MP_ROM_QSTR(MP_QSTR_use_gyro),         MP_ROM_PTR(&robotics_DriveBase_use_gyro_obj) },
     { MP_ROM_QSTR(MP_QSTR_left),             MP_ROM_ATTRIBUTE_OFFSET(robotics_DriveBase_obj_t, left)            },
     { MP_ROM_QSTR(MP_QSTR_right),            MP_ROM_ATTRIBUTE_OFFSET(robotics_DriveBase_obj_t, right)           },
     { MP_ROM_QSTR(MP_QSTR_log),              MP_ROM_ATTRIBUTE_OFFSET(robotics_DriveBase_obj_t, logger)          },
@@ -265,7 +510,7 @@ STATIC const mp_rom_map_elem_t robotics_DriveBase_locals_dict_table[] = {
 STATIC MP_DEFINE_CONST_DICT(robotics_DriveBase_locals_dict, robotics_DriveBase_locals_dict_table);
 
 // type(pybricks.robotics.DriveBase)
-STATIC const mp_obj_type_t robotics_DriveBase_type = {
+const mp_obj_type_t robotics_DriveBase_type = {
     { &mp_type_type },
     .name = MP_QSTR_DriveBase,
     .make_new = robotics_DriveBase_make_new,
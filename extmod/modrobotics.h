@@ -0,0 +1,20 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#ifndef _PYBRICKS_EXTMOD_MODROBOTICS_H_
+#define _PYBRICKS_EXTMOD_MODROBOTICS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "py/obj.h"
+
+#if PYBRICKS_PY_ROBOTICS
+
+const mp_obj_type_t robotics_DriveBase_type;
+
+bool robotics_DriveBase_test_completion(mp_obj_t self_in, uint32_t end_time);
+
+#endif // PYBRICKS_PY_ROBOTICS
+
+#endif // _PYBRICKS_EXTMOD_MODROBOTICS_H_
@@ -1,17 +1,129 @@
 // SPDX-License-Identifier: MIT
 // Copyright (c) 2018-2020 The Pybricks Authors
 
+#include <pbio/motorpoll.h>
+
 #include "py/mphal.h"
+#include "py/mpstate.h"
+#include "py/mpthread.h"
 #include "py/runtime.h"
 #include "pberror.h"
 #include "pbobj.h"
 #include "pbkwarg.h"
 
+#include "modmotor.h"
+#include "modrobotics.h"
+#include "modtools.h"
+
+#if PYBRICKS_PY_TOOLS_TASKS
+
+// Tasks are generators that are resumed one after the other by run_task().
+// Methods that would normally block return an Awaitable instead while the
+// run loop is active, so that the task can wait for it with `yield from` (or
+// `await`, where available) while the other tasks keep running.
+
+// How long the run loop sleeps after all tasks have yielded. This is short
+// enough for the control loops to get the next command in time, while
+// still letting the hub idle in between.
+#define RUN_LOOP_INTERVAL_MS (1)
+
+// Thread that is in run_task(), or NULL if none is. Only this thread gets
+// awaitables, so other threads that use motors keep blocking as usual.
+STATIC mp_state_thread_t *run_loop_thread;
+
+STATIC mp_state_thread_t *get_current_thread(void) {
+    #if MICROPY_PY_THREAD
+    return mp_thread_get_state();
+    #else
+    return &mp_state_ctx.thread;
+    #endif
+}
+
+bool pb_module_tools_run_loop_is_active(void) {
+    return run_loop_thread == get_current_thread();
+}
+
+// Class structure for Awaitable
+typedef struct _tools_Awaitable_obj_t {
+    mp_obj_base_t base;
+    // The object whose operation is awaited, such as a motor
+    mp_obj_t obj;
+    uint32_t end_time;
+    pb_tools_awaitable_test_t test;
+    pb_tools_awaitable_cancel_t cancel;
+    bool done;
+} tools_Awaitable_obj_t;
+
+STATIC mp_obj_t tools_Awaitable_iternext(mp_obj_t self_in) {
+    tools_Awaitable_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    if (!self->done && !self->test(self->obj, self->end_time)) {
+        // Not done yet, so yield to the other tasks
+        return mp_const_none;
+    }
+    self->done = true;
+    return MP_OBJ_STOP_ITERATION;
+}
+
+// Called when the task that awaits this is cancelled
+STATIC mp_obj_t tools_Awaitable_close(mp_obj_t self_in) {
+    tools_Awaitable_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    if (!self->done) {
+        self->done = true;
+        if (self->cancel) {
+            self->cancel(self->obj);
+        }
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(tools_Awaitable_close_obj, tools_Awaitable_close);
+
+STATIC const mp_rom_map_elem_t tools_Awaitable_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR_close), MP_ROM_PTR(&tools_Awaitable_close_obj) },
+    #if MICROPY_PY_ASYNC_AWAIT
+    { MP_ROM_QSTR(MP_QSTR___await__), MP_ROM_PTR(&mp_identity_obj) },
+    #endif
+};
+STATIC MP_DEFINE_CONST_DICT(tools_Awaitable_locals_dict, tools_Awaitable_locals_dict_table);
+
+STATIC const mp_obj_type_t tools_Awaitable_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_Awaitable,
+    .getiter = mp_identity_getiter,
+    .iternext = tools_Awaitable_iternext,
+    .locals_dict = (mp_obj_dict_t *)&tools_Awaitable_locals_dict,
+};
+
+mp_obj_t pb_module_tools_awaitable_new(mp_obj_t obj, uint32_t end_time,
+    pb_tools_awaitable_test_t test, pb_tools_awaitable_cancel_t cancel) {
+    tools_Awaitable_obj_t *self = m_new_obj(tools_Awaitable_obj_t);
+    self->base.type = &tools_Awaitable_type;
+    self->obj = obj;
+    self->end_time = end_time;
+    self->test = test;
+    self->cancel = cancel;
+    self->done = false;
+    return MP_OBJ_FROM_PTR(self);
+}
+
+STATIC bool tools_wait_test(mp_obj_t obj, uint32_t end_time) {
+    return (int32_t)(mp_hal_ticks_ms() - end_time) >= 0;
+}
+
+#endif // PYBRICKS_PY_TOOLS_TASKS
+
 STATIC mp_obj_t tools_wait(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
     PB_PARSE_ARGS_FUNCTION(n_args, pos_args, kw_args,
         PB_ARG_REQUIRED(time));
 
     mp_int_t duration = pb_obj_get_int(time);
+
+    #if PYBRICKS_PY_TOOLS_TASKS
+    if (pb_module_tools_run_loop_is_active()) {
+        return pb_module_tools_awaitable_new(mp_const_none,
+            mp_hal_ticks_ms() + (duration > 0 ? duration : 0), tools_wait_test, NULL);
+    }
+    #endif
+
     if (duration > 0) {
         mp_hal_delay_ms(duration);
     }
@@ -93,6 +205,303 @@ STATIC const mp_obj_type_t tools_StopWatch_type = {
     .locals_dict = (mp_obj_dict_t *)&tools_StopWatch_locals_dict,
 };
 
+#if PYBRICKS_PY_TOOLS_TASKS
+
+// Cancels a task that has not finished
+STATIC void close_task(mp_obj_t task) {
+    mp_obj_t dest[2];
+    mp_load_method_maybe(task, MP_QSTR_close, dest);
+    if (dest[0] != MP_OBJ_NULL) {
+        mp_call_method_n_kw(0, 0, dest);
+    }
+}
+
+// Resumes a task once. Awaitables that have a result give it by raising
+// StopIteration, which counts as a normal return here.
+STATIC mp_vm_return_kind_t resume_task(mp_obj_t task, mp_obj_t *ret) {
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        mp_vm_return_kind_t kind = mp_resume(task, mp_const_none, MP_OBJ_NULL, ret);
+        nlr_pop();
+        return kind;
+    }
+    if (mp_obj_exception_match(MP_OBJ_FROM_PTR(nlr.ret_val), MP_OBJ_FROM_PTR(&mp_type_StopIteration))) {
+        *ret = mp_obj_exception_get_value(MP_OBJ_FROM_PTR(nlr.ret_val));
+        return MP_VM_RETURN_NORMAL;
+    }
+    nlr_jump(nlr.ret_val);
+}
+
+// Class structure for Multitask. Tasks that are done are set to MP_OBJ_NULL.
+typedef struct _tools_Multitask_obj_t {
+    mp_obj_base_t base;
+    bool race;
+    size_t num_tasks;
+    mp_obj_t tasks[];
+} tools_Multitask_obj_t;
+
+STATIC void tools_Multitask_close_all(tools_Multitask_obj_t *self) {
+    for (size_t i = 0; i < self->num_tasks; i++) {
+        mp_obj_t task = self->tasks[i];
+        if (task != MP_OBJ_NULL) {
+            self->tasks[i] = MP_OBJ_NULL;
+            close_task(task);
+        }
+    }
+}
+
+// Resumes each task that is not done yet once
+STATIC mp_obj_t tools_Multitask_iternext(mp_obj_t self_in) {
+    tools_Multitask_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+    bool all_done = true;
+    for (size_t i = 0; i < self->num_tasks; i++) {
+        if (self->tasks[i] == MP_OBJ_NULL) {
+            continue;
+        }
+
+        mp_obj_t ret;
+        mp_vm_return_kind_t kind = resume_task(self->tasks[i], &ret);
+
+        if (kind == MP_VM_RETURN_YIELD) {
+            all_done = false;
+            continue;
+        }
+
+        self->tasks[i] = MP_OBJ_NULL;
+
+        if (kind == MP_VM_RETURN_EXCEPTION) {
+            // One failing task cancels the others
+            tools_Multitask_close_all(self);
+            nlr_raise(ret);
+        }
+
+        if (self->race) {
+            tools_Multitask_close_all(self);
+            return MP_OBJ_STOP_ITERATION;
+        }
+    }
+
+    return all_done ? MP_OBJ_STOP_ITERATION : mp_const_none;
+}
+
+STATIC mp_obj_t tools_Multitask_close(mp_obj_t self_in) {
+    tools_Multitask_close_all(MP_OBJ_TO_PTR(self_in));
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(tools_Multitask_close_obj, tools_Multitask_close);
+
+STATIC const mp_rom_map_elem_t tools_Multitask_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR_close), MP_ROM_PTR(&tools_Multitask_close_obj) },
+    #if MICROPY_PY_ASYNC_AWAIT
+    { MP_ROM_QSTR(MP_QSTR___await__), MP_ROM_PTR(&mp_identity_obj) },
+    #endif
+};
+STATIC MP_DEFINE_CONST_DICT(tools_Multitask_locals_dict, tools_Multitask_locals_dict_table);
+
+STATIC const mp_obj_type_t tools_Multitask_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_Multitask,
+    .getiter = mp_identity_getiter,
+    .iternext = tools_Multitask_iternext,
+    .locals_dict = (mp_obj_dict_t *)&tools_Multitask_locals_dict,
+};
+
+// pybricks.tools.multitask(*tasks, race=False)
+// Combines tasks into one that runs them side by side. It finishes when all
+// tasks are done, or when the first one is done if race is True.
+STATIC mp_obj_t tools_multitask(size_t n_args, const mp_obj_t *args, mp_map_t *kw_args) {
+    tools_Multitask_obj_t *self = m_new_obj_var(tools_Multitask_obj_t, mp_obj_t, n_args);
+    self->base.type = &tools_Multitask_type;
+    self->num_tasks = n_args;
+    for (size_t i = 0; i < n_args; i++) {
+        self->tasks[i] = args[i];
+    }
+
+    mp_map_elem_t *race = mp_map_lookup(kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_race), MP_MAP_LOOKUP);
+    self->race = race && mp_obj_is_true(race->value);
+
+    return MP_OBJ_FROM_PTR(self);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(tools_multitask_obj, 0, tools_multitask);
+
+#if PBDRV_CONFIG_NUM_MOTOR_CONTROLLER != 0
+
+typedef struct _tools_maneuver_t {
+    // The object that was given by the user
+    mp_obj_t obj;
+    // The object and function that test whether its maneuver is done
+    mp_obj_t base;
+    pb_tools_awaitable_test_t test;
+} tools_maneuver_t;
+
+// Class structure for the maneuvers waited for by wait_any() or wait_all()
+typedef struct _tools_Maneuvers_obj_t {
+    mp_obj_base_t base;
+    bool any;
+    // Index of a maneuver that is done, once any of them is
+    size_t done_index;
+    size_t num_maneuvers;
+    tools_maneuver_t maneuvers[];
+} tools_Maneuvers_obj_t;
+
+// Gets the completion test of a Motor or DriveBase
+STATIC void tools_maneuver_init(tools_maneuver_t *maneuver, mp_obj_t obj) {
+    maneuver->obj = obj;
+    #if PYBRICKS_PY_ROBOTICS
+    if (mp_obj_is_obj(obj) && mp_obj_is_subclass_fast(MP_OBJ_FROM_PTR(mp_obj_get_type(obj)), MP_OBJ_FROM_PTR(&robotics_DriveBase_type))) {
+        maneuver->base = pb_obj_get_base_class_obj(obj, &robotics_DriveBase_type);
+        maneuver->test = robotics_DriveBase_test_completion;
+        return;
+    }
+    #endif
+    // Raises TypeError if this is not a Motor either
+    maneuver->base = pb_obj_get_base_class_obj(obj, &motor_Motor_type);
+    maneuver->test = motor_Motor_test_completion;
+}
+
+STATIC bool tools_Maneuvers_test(tools_Maneuvers_obj_t *self) {
+    for (size_t i = 0; i < self->num_maneuvers; i++) {
+        tools_maneuver_t *maneuver = &self->maneuvers[i];
+        bool done = maneuver->test(maneuver->base, 0);
+        if (done && self->any) {
+            self->done_index = i;
+            return true;
+        }
+        if (!done && !self->any) {
+            return false;
+        }
+    }
+    return !self->any;
+}
+
+// Gets the value returned by wait_any() or wait_all()
+STATIC mp_obj_t tools_Maneuvers_result(tools_Maneuvers_obj_t *self) {
+    if (self->any) {
+        return self->maneuvers[self->done_index].obj;
+    }
+    return mp_const_none;
+}
+
+// In a task, the maneuvers are awaited like an Awaitable. The result is given
+// to `yield from` as the value of StopIteration.
+STATIC mp_obj_t tools_Maneuvers_iternext(mp_obj_t self_in) {
+    tools_Maneuvers_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    if (!tools_Maneuvers_test(self)) {
+        // Not done yet, so yield to the other tasks
+        return mp_const_none;
+    }
+    mp_obj_t result = tools_Maneuvers_result(self);
+    if (result == mp_const_none) {
+        return MP_OBJ_STOP_ITERATION;
+    }
+    nlr_raise(mp_obj_new_exception_arg1(&mp_type_StopIteration, result));
+}
+
+#if MICROPY_PY_ASYNC_AWAIT
+STATIC const mp_rom_map_elem_t tools_Maneuvers_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR___await__), MP_ROM_PTR(&mp_identity_obj) },
+};
+STATIC MP_DEFINE_CONST_DICT(tools_Maneuvers_locals_dict, tools_Maneuvers_locals_dict_table);
+#endif
+
+// The maneuvers keep going if the task that awaits them is cancelled, since
+// the task did not start them, so this has no close() method.
+STATIC const mp_obj_type_t tools_Maneuvers_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_Maneuvers,
+    .getiter = mp_identity_getiter,
+    .iternext = tools_Maneuvers_iternext,
+    #if MICROPY_PY_ASYNC_AWAIT
+    .locals_dict = (mp_obj_dict_t *)&tools_Maneuvers_locals_dict,
+    #endif
+};
+
+STATIC mp_obj_t tools_wait_maneuvers(size_t n_args, const mp_obj_t *args, bool any) {
+    tools_Maneuvers_obj_t *self = m_new_obj_var(tools_Maneuvers_obj_t, tools_maneuver_t, n_args);
+    self->base.type = &tools_Maneuvers_type;
+    self->any = any;
+    self->done_index = 0;
+    self->num_maneuvers = n_args;
+    for (size_t i = 0; i < n_args; i++) {
+        tools_maneuver_init(&self->maneuvers[i], args[i]);
+    }
+
+    // In a task, the maneuvers are awaited instead
+    if (pb_module_tools_run_loop_is_active()) {
+        return MP_OBJ_FROM_PTR(self);
+    }
+
+    // Otherwise sleep until the control loops emit an event, and check again
+    for (;;) {
+        uint32_t event_count = pbio_motorpoll_get_event_count();
+        if (tools_Maneuvers_test(self)) {
+            break;
+        }
+        pb_motor_wait_for_event(event_count);
+    }
+
+    return tools_Maneuvers_result(self);
+}
+
+// pybricks.tools.wait_any(*maneuvers)
+// Waits until the maneuver of any of the given motors or drive bases is
+// done, and returns the first one of them that is done.
+STATIC mp_obj_t tools_wait_any(size_t n_args, const mp_obj_t *args) {
+    return tools_wait_maneuvers(n_args, args, true);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR(tools_wait_any_obj, 1, tools_wait_any);
+
+// pybricks.tools.wait_all(*maneuvers)
+// Waits until the maneuvers of all given motors and drive bases are done.
+STATIC mp_obj_t tools_wait_all(size_t n_args, const mp_obj_t *args) {
+    return tools_wait_maneuvers(n_args, args, false);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR(tools_wait_all_obj, 1, tools_wait_all);
+
+#endif // PBDRV_CONFIG_NUM_MOTOR_CONTROLLER
+
+// pybricks.tools.run_task(task)
+// Runs a task until it is done and returns its return value.
+STATIC mp_obj_t tools_run_task(mp_obj_t task) {
+    // There is only one run loop, so it can't be nested or used by two
+    // threads at once.
+    if (run_loop_thread) {
+        pb_assert(PBIO_ERROR_INVALID_OP);
+    }
+
+    run_loop_thread = get_current_thread();
+
+    mp_obj_t ret;
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        mp_vm_return_kind_t kind;
+        while ((kind = resume_task(task, &ret)) == MP_VM_RETURN_YIELD) {
+            // All tasks yielded, so give the background processes a turn
+            mp_hal_delay_ms(RUN_LOOP_INTERVAL_MS);
+        }
+        if (kind == MP_VM_RETURN_EXCEPTION) {
+            nlr_raise(ret);
+        }
+        nlr_pop();
+    } else {
+        run_loop_thread = NULL;
+        close_task(task);
+        nlr_jump(nlr.ret_val);
+    }
+
+    run_loop_thread = NULL;
+
+    // Iterators like multitask() finish without a return value
+    if (ret == MP_OBJ_STOP_ITERATION || ret == MP_OBJ_NULL) {
+        return mp_const_none;
+    }
+    return ret;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(tools_run_task_obj, tools_run_task);
+
+#endif // PYBRICKS_PY_TOOLS_TASKS
+
 /*
 tools module tables
 */
@@ -101,6 +510,14 @@ STATIC const mp_rom_map_elem_t tools_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR___name__),    MP_ROM_QSTR(MP_QSTR_tools)         },
     { MP_ROM_QSTR(MP_QSTR_wait),        MP_ROM_PTR(&tools_wait_obj)  },
     { MP_ROM_QSTR(MP_QSTR_StopWatch),   MP_ROM_PTR(&tools_StopWatch_type)  },
+    #if PYBRICKS_PY_TOOLS_TASKS
+    { MP_ROM_QSTR(MP_QSTR_multitask),   MP_ROM_PTR(&tools_multitask_obj)   },
+    { MP_ROM_QSTR(MP_QSTR_run_task),    MP_ROM_PTR(&tools_run_task_obj)    },
+    #if PBDRV_CONFIG_NUM_MOTOR_CONTROLLER != 0
+    { MP_ROM_QSTR(MP_QSTR_wait_any),    MP_ROM_PTR(&tools_wait_any_obj)    },
+    { MP_ROM_QSTR(MP_QSTR_wait_all),    MP_ROM_PTR(&tools_wait_all_obj)    },
+    #endif
+    #endif
 };
 STATIC MP_DEFINE_CONST_DICT(pb_module_tools_globals, tools_globals_table);
 
@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#ifndef _PYBRICKS_EXTMOD_MODTOOLS_H_
+#define _PYBRICKS_EXTMOD_MODTOOLS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "py/obj.h"
+
+#if PYBRICKS_PY_TOOLS_TASKS
+
+// Checks if the operation of obj that is being awaited is done. This may
+// raise an exception if the operation failed.
+typedef bool (*pb_tools_awaitable_test_t)(mp_obj_t obj, uint32_t end_time);
+
+// Stops the operation of obj when the task that awaits it is cancelled
+typedef void (*pb_tools_awaitable_cancel_t)(mp_obj_t obj);
+
+bool pb_module_tools_run_loop_is_active(void);
+
+mp_obj_t pb_module_tools_awaitable_new(mp_obj_t obj, uint32_t end_time,
+    pb_tools_awaitable_test_t test, pb_tools_awaitable_cancel_t cancel);
+
+#endif // PYBRICKS_PY_TOOLS_TASKS
+
+#endif // _PYBRICKS_EXTMOD_MODTOOLS_H_
@@ -16,12 +16,51 @@ pbdevice_t *pbdevice_get_device(pbio_port_t port, pbio_iodev_type_id_t valid_id)
 
 void pbdevice_get_values(pbdevice_t *pbdev, uint8_t mode, int32_t *values);
 
+// Like pbdevice_get_values(), but only if the device is already in the given
+// mode. Does not raise, so it can be used outside of the MicroPython VM.
+pbio_error_t pbdevice_get_values_nowait(pbdevice_t *pbdev, uint8_t mode, int32_t *values);
+
 void pbdevice_set_values(pbdevice_t *pbdev, uint8_t mode, int32_t *values, uint8_t num_values);
 
+// One value of a device mode, scaled down by the given divisor. Can be read in
+// the background with pbdevice_source_get_value(), once the device is in the
+// right mode. Sensors that give a negative value when nothing is in range
+// can set out_of_range to the value that is used instead, or 0 to keep it.
+typedef struct _pbdevice_source_t {
+    pbdevice_t *pbdev;
+    uint8_t mode;
+    uint8_t index;
+    int32_t divisor;
+    int32_t out_of_range;
+} pbdevice_source_t;
+
+// Matches pbio_reflex_source_t, with a pbdevice_source_t as the context
+static inline pbio_error_t pbdevice_source_get_value(void *context, int32_t *value) {
+    pbdevice_source_t *source = context;
+    int32_t values[PBIO_IODEV_MAX_DATA_SIZE];
+    pbio_error_t err = pbdevice_get_values_nowait(source->pbdev, source->mode, values);
+    if (err == PBIO_ERROR_INVALID_OP) {
+        // The program switched the sensor to another mode. Keep the last
+        // output until it is switched back.
+        return PBIO_ERROR_AGAIN;
+    }
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+    *value = values[source->index];
+    if (*value < 0 && source->out_of_range) {
+        *value = source->out_of_range;
+    }
+    *value /= source->divisor;
+    return PBIO_SUCCESS;
+}
+
 void pbdevice_set_power_supply(pbdevice_t *pbdev, int32_t duty);
 
 void pbdevice_get_info(pbdevice_t *pbdev, pbio_port_t *port, pbio_iodev_type_id_t *id, uint8_t *mode, uint8_t *num_values);
 
+void pbdevice_get_timestamp(pbdevice_t *pbdev, uint32_t *timestamp, uint32_t *seq);
+
 int8_t pbdevice_get_mode_id_from_str(pbdevice_t *pbdev, const char *mode_str);
 
 void pbdevice_color_light_on(pbdevice_t *pbdev, pbio_light_color_t color);
@@ -40,6 +40,11 @@ void pb_hsv_map_save_default(pb_hsv_map_t *map) {
     map->value_none = 0;
     map->value_black = 10;
     map->value_white = 60;
+    #if PYBRICKS_PY_PUPDEVICES_TRAINING
+    map->num_classes = 0;
+    map->table_valid = false;
+    map->table = NULL;
+    #endif
 }
 
 static void update_error(int32_t value, int32_t *min_error, mp_obj_t *color_match, int32_t compare, mp_obj_t color) {
@@ -61,9 +66,159 @@ static void update_error(int32_t value, int32_t *min_error, mp_obj_t *color_matc
     }
 }
 
-// Set initial default thresholds
+#if PYBRICKS_PY_PUPDEVICES_TRAINING
+
+// Number of bins in the lookup table
+#define TABLE_SIZE (PB_HSV_TABLE_HUE_BINS * PB_HSV_TABLE_SAT_BINS * PB_HSV_TABLE_VAL_BINS)
+
+// Sample count at which the sums of a class are halved, which keeps them in
+// range and gives more weight to recent samples
+#define CLASS_MAX_COUNT (4096)
+
+// Sine of 0, 15, ..., 90 degrees, scaled by 64
+static const uint8_t sin_table[] = {0, 17, 32, 45, 55, 62, 64};
+
+// Sine of an angle in degrees, scaled by 64, by linear interpolation
+static int32_t hsv_sin(int32_t angle) {
+    angle = ((angle % 360) + 360) % 360;
+    int32_t sign = 1;
+    if (angle >= 180) {
+        angle -= 180;
+        sign = -1;
+    }
+    if (angle > 90) {
+        angle = 180 - angle;
+    }
+    int32_t i = angle / 15;
+    int32_t frac = angle - i * 15;
+    int32_t result = sin_table[i];
+    if (frac) {
+        result += (sin_table[i + 1] - sin_table[i]) * frac / 15;
+    }
+    return sign * result;
+}
+
+// Maps HSV onto a cylinder, so that hue does not matter for grays and so
+// that red is close to red regardless of hue wrapping around
+static void hsv_to_xyz(int32_t hue, int32_t saturation, int32_t value, int32_t *x, int32_t *y, int32_t *z) {
+    *x = saturation * hsv_sin(hue + 90);
+    *y = saturation * hsv_sin(hue);
+    *z = value * 64;
+}
+
+// Finds the trained class nearest to the given color
+static uint8_t get_nearest_class(pb_hsv_map_t *map, int32_t hue, int32_t saturation, int32_t value) {
+    int32_t x, y, z;
+    hsv_to_xyz(hue, saturation, value, &x, &y, &z);
+
+    uint8_t nearest = 0;
+    int32_t min_error = INT32_MAX;
+    for (uint8_t i = 0; i < map->num_classes; i++) {
+        pb_hsv_class_t *c = &map->classes[i];
+        int32_t dx = x - c->sum_x / c->count;
+        int32_t dy = y - c->sum_y / c->count;
+        int32_t dz = z - c->sum_z / c->count;
+        int32_t error = dx * dx + dy * dy + dz * dz;
+        if (error < min_error) {
+            min_error = error;
+            nearest = i;
+        }
+    }
+    return nearest;
+}
+
+// Index of the lookup table bin that contains the given color
+static int32_t get_table_index(int32_t hue, int32_t saturation, int32_t value) {
+    int32_t h = (((hue % 360) + 360) % 360) * PB_HSV_TABLE_HUE_BINS / 360;
+    int32_t s = bound_percentage(saturation) * PB_HSV_TABLE_SAT_BINS / 101;
+    int32_t v = bound_percentage(value) * PB_HSV_TABLE_VAL_BINS / 101;
+    return (h * PB_HSV_TABLE_SAT_BINS + s) * PB_HSV_TABLE_VAL_BINS + v;
+}
+
+// Classifies the center of each bin, so that classifying a sample later on
+// takes just one table lookup
+static void build_table(pb_hsv_map_t *map) {
+    if (map->table == NULL) {
+        map->table = m_new(uint8_t, TABLE_SIZE / 2);
+    }
+
+    for (int32_t h = 0; h < PB_HSV_TABLE_HUE_BINS; h++) {
+        for (int32_t s = 0; s < PB_HSV_TABLE_SAT_BINS; s++) {
+            for (int32_t v = 0; v < PB_HSV_TABLE_VAL_BINS; v++) {
+                uint8_t nearest = get_nearest_class(map,
+                    (2 * h + 1) * 360 / PB_HSV_TABLE_HUE_BINS / 2,
+                    (2 * s + 1) * 101 / PB_HSV_TABLE_SAT_BINS / 2,
+                    (2 * v + 1) * 101 / PB_HSV_TABLE_VAL_BINS / 2);
+                int32_t index = (h * PB_HSV_TABLE_SAT_BINS + s) * PB_HSV_TABLE_VAL_BINS + v;
+                if (index % 2) {
+                    map->table[index / 2] = (map->table[index / 2] & 0x0F) | (nearest << 4);
+                } else {
+                    map->table[index / 2] = (map->table[index / 2] & 0xF0) | nearest;
+                }
+            }
+        }
+    }
+    map->table_valid = true;
+}
+
+// Add a labeled sample to the trained classes
+void pb_hsv_train(pb_hsv_map_t *map, mp_obj_t color, int32_t hue, int32_t saturation, int32_t value) {
+
+    // Find the class for this color, or add it if it is new
+    pb_hsv_class_t *c = NULL;
+    for (uint8_t i = 0; i < map->num_classes; i++) {
+        if (mp_obj_equal(map->classes[i].color, color)) {
+            c = &map->classes[i];
+            break;
+        }
+    }
+    if (c == NULL) {
+        if (map->num_classes == PB_HSV_MAX_CLASSES) {
+            pb_assert(PBIO_ERROR_INVALID_ARG);
+        }
+        c = &map->classes[map->num_classes++];
+        c->color = color;
+        c->count = 0;
+        c->sum_x = 0;
+        c->sum_y = 0;
+        c->sum_z = 0;
+    }
+
+    if (c->count == CLASS_MAX_COUNT) {
+        c->count /= 2;
+        c->sum_x /= 2;
+        c->sum_y /= 2;
+        c->sum_z /= 2;
+    }
+
+    int32_t x, y, z;
+    hsv_to_xyz(hue, bound_percentage(saturation), bound_percentage(value), &x, &y, &z);
+    c->count++;
+    c->sum_x += x;
+    c->sum_y += y;
+    c->sum_z += z;
+
+    // Rebuild the table when it is next used
+    map->table_valid = false;
+}
+
+#endif // PYBRICKS_PY_PUPDEVICES_TRAINING
+
+// Get the color that best matches the given HSV values
 mp_obj_t pb_hsv_get_color(pb_hsv_map_t *map, int32_t hue, int32_t saturation, int32_t value) {
 
+    #if PYBRICKS_PY_PUPDEVICES_TRAINING
+    // If colors have been trained, use the lookup table
+    if (map->num_classes > 0) {
+        if (!map->table_valid) {
+            build_table(map);
+        }
+        int32_t index = get_table_index(hue, saturation, value);
+        uint8_t nearest = (map->table[index / 2] >> (index % 2 * 4)) & 0x0F;
+        return map->classes[nearest].color;
+    }
+    #endif
+
     int32_t min_error = 1000;
     mp_obj_t color_match = mp_const_none;
 
@@ -208,5 +363,10 @@ void unpack_color_map(pb_hsv_map_t *map, mp_obj_t hues, mp_obj_t saturation, mp_
     map->value_none = none;
     map->value_black = black;
     map->value_white = white;
+
+    #if PYBRICKS_PY_PUPDEVICES_TRAINING
+    // A user specified map replaces any trained colors
+    map->num_classes = 0;
+    #endif
 }
 
@@ -4,6 +4,35 @@
 #ifndef _PBHSV_H_
 #define _PBHSV_H_
 
+#include <stdbool.h>
+
+#include "py/mpconfig.h"
+
+#ifndef PYBRICKS_PY_PUPDEVICES_TRAINING
+#define PYBRICKS_PY_PUPDEVICES_TRAINING (0)
+#endif
+
+#if PYBRICKS_PY_PUPDEVICES_TRAINING
+
+// Maximum number of distinct colors that can be trained
+#define PB_HSV_MAX_CLASSES (15)
+
+// Number of hue, saturation, and value bins in the lookup table
+#define PB_HSV_TABLE_HUE_BINS (24)
+#define PB_HSV_TABLE_SAT_BINS (8)
+#define PB_HSV_TABLE_VAL_BINS (16)
+
+// Trained color, with the sum of its samples in cylindrical HSV coordinates
+typedef struct _pb_hsv_class_t {
+    mp_obj_t color;
+    int32_t count;
+    int32_t sum_x;
+    int32_t sum_y;
+    int32_t sum_z;
+} pb_hsv_class_t;
+
+#endif // PYBRICKS_PY_PUPDEVICES_TRAINING
+
 typedef struct _pb_hsv_map_t {
     int32_t saturation_threshold;
     int32_t hue_red;
@@ -15,6 +44,13 @@ typedef struct _pb_hsv_map_t {
     int32_t value_none;
     int32_t value_black;
     int32_t value_white;
+    #if PYBRICKS_PY_PUPDEVICES_TRAINING
+    uint8_t num_classes;
+    bool table_valid;
+    pb_hsv_class_t classes[PB_HSV_MAX_CLASSES];
+    // Class index for each HSV bin, two bins per byte
+    uint8_t *table;
+    #endif
 } pb_hsv_map_t;
 
 int32_t bound_percentage(int32_t value);
@@ -26,4 +62,8 @@ void pb_hsv_map_save_default(pb_hsv_map_t *map);
 mp_obj_t pack_color_map(pb_hsv_map_t *map);
 void unpack_color_map(pb_hsv_map_t *map, mp_obj_t hues, mp_obj_t saturation, mp_obj_t values);
 
+#if PYBRICKS_PY_PUPDEVICES_TRAINING
+void pb_hsv_train(pb_hsv_map_t *map, mp_obj_t color, int32_t hue, int32_t saturation, int32_t value);
+#endif
+
 #endif // _PBHSV_H_
@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#ifndef _PBIO_NXTCOLOR_GPIO_H_
+#define _PBIO_NXTCOLOR_GPIO_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <pbio/error.h>
+
+// Pins that the NXT Color Sensor uses on one input port
+typedef struct {
+    const int digi0; // GPIO on wire 5
+    const int digi1; // GPIO on wire 6
+    const int adc_val; // ADC on wire 6 for getting reflection data
+    const int adc_con; // ADC on wire 1 for detecting sensor
+} nxtcolor_pininfo_t;
+
+// Pin operations. digi0 is the clock and digi1 is the data line.
+typedef enum {
+    NXTCOLOR_GPIO_CLOCK_LOW,
+    NXTCOLOR_GPIO_CLOCK_HIGH,
+    NXTCOLOR_GPIO_DATA_LOW,
+    NXTCOLOR_GPIO_DATA_HIGH,
+    // Stops driving the data line, so it can be read as digital or analog
+    NXTCOLOR_GPIO_DATA_INPUT,
+    // Reads the data line as an input and stores the next received bit
+    NXTCOLOR_GPIO_DATA_READ,
+} nxtcolor_gpio_op_t;
+
+typedef enum {
+    NXTCOLOR_GPIO_ADC_VAL,
+    NXTCOLOR_GPIO_ADC_CON,
+} nxtcolor_gpio_adc_t;
+
+typedef struct _nxtcolor_gpio_t nxtcolor_gpio_t;
+
+// Way to access the pins. Sensor code only gives lists of pin operations, so
+// a backend may run a whole list without going through the kernel for each
+// pin change. This also lets host builds replace the hardware with a mock.
+typedef struct {
+    const char *name;
+    // Gets the pins and ADCs ready for use without changing their state
+    pbio_error_t (*open)(nxtcolor_gpio_t *gpio);
+    // Runs the operations in order. Bits read with NXTCOLOR_GPIO_DATA_READ
+    // are stored LSB first in consecutive bytes of in, which must be zeroed.
+    pbio_error_t (*run)(nxtcolor_gpio_t *gpio, const uint8_t *ops, size_t num_ops, uint8_t *in);
+    pbio_error_t (*read_adc)(nxtcolor_gpio_t *gpio, nxtcolor_gpio_adc_t adc, int32_t *value);
+    void (*close)(nxtcolor_gpio_t *gpio);
+} nxtcolor_gpio_backend_t;
+
+struct _nxtcolor_gpio_t {
+    const nxtcolor_gpio_backend_t *backend;
+    const nxtcolor_pininfo_t *pins;
+    // File descriptors used by the backend, or -1 if not used
+    int fd_chip;
+    int fd_clock;
+    int fd_data;
+    int fd_data_dir;
+    int fd_pair;
+    int fd_adc[2];
+    bool clock_out;
+    bool data_out;
+    bool clock_level;
+    bool data_level;
+    // Backend specific data, such as for a mock
+    void *context;
+};
+
+extern const nxtcolor_gpio_backend_t nxtcolor_gpio_backend_chardev;
+extern const nxtcolor_gpio_backend_t nxtcolor_gpio_backend_sysfs;
+
+void nxtcolor_gpio_set_backend(const nxtcolor_gpio_backend_t *backend);
+
+pbio_error_t nxtcolor_gpio_open(nxtcolor_gpio_t *gpio, const nxtcolor_pininfo_t *pins);
+
+size_t nxtcolor_gpio_get_batch(const uint8_t *ops, size_t num_ops);
+
+pbio_error_t nxtcolor_gpio_run(nxtcolor_gpio_t *gpio, const uint8_t *ops, size_t num_ops, uint8_t *in);
+
+pbio_error_t nxtcolor_gpio_read_adc(nxtcolor_gpio_t *gpio, nxtcolor_gpio_adc_t adc, int32_t *value);
+
+void nxtcolor_gpio_close(nxtcolor_gpio_t *gpio);
+
+#endif // _PBIO_NXTCOLOR_GPIO_H_
@@ -6,6 +6,8 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <contiki.h>
+
 #include <ev3dev_stretch/lego_port.h>
 #include <ev3dev_stretch/lego_sensor.h>
 #include <ev3dev_stretch/sysfs.h>
@@ -27,6 +29,8 @@ struct _lego_sensor_t {
     FILE *f_num_values;
     FILE *f_bin_data_format;
     char modes[12][17];
+    uint32_t timestamp;
+    uint32_t data_seq;
     uint8_t bin_data[PBIO_IODEV_MAX_DATA_SIZE]  __attribute__((aligned(32)));
 };
 // Initialize an ev3dev sensor by opening the relevant sysfs attributes
@@ -297,11 +301,26 @@ pbio_error_t lego_sensor_get_bin_data(lego_sensor_t *sensor, uint8_t **bin_data)
         return PBIO_ERROR_IO;
     }
 
-    if (fread(sensor->bin_data, 1, BIN_DATA_SIZE, sensor->f_bin_data) < BIN_DATA_SIZE) {
+    uint8_t new_data[BIN_DATA_SIZE];
+    if (fread(new_data, 1, BIN_DATA_SIZE, sensor->f_bin_data) < BIN_DATA_SIZE) {
         return PBIO_ERROR_IO;
     }
 
+    // sysfs does not tell us when the kernel received a sample, so the best
+    // we can do is to stamp the data when we first see it change.
+    if (sensor->data_seq == 0 || memcmp(new_data, sensor->bin_data, BIN_DATA_SIZE)) {
+        memcpy(sensor->bin_data, new_data, BIN_DATA_SIZE);
+        sensor->timestamp = clock_usecs();
+        sensor->data_seq++;
+    }
+
     *bin_data = sensor->bin_data;
 
     return PBIO_SUCCESS;
 }
+
+// Get the time (us) and sequence number of the most recent data sample
+void lego_sensor_get_timestamp(lego_sensor_t *sensor, uint32_t *timestamp, uint32_t *seq) {
+    *timestamp = sensor->timestamp;
+    *seq = sensor->data_seq;
+}
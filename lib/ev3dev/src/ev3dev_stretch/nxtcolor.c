@@ -1,7 +1,6 @@
 // SPDX-License-Identifier: MIT
 // Copyright (c) 2019-2020 The Pybricks Authors
 
-#include <dirent.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
@@ -9,25 +8,15 @@
 #include <contiki.h>
 
 #include <ev3dev_stretch/lego_sensor.h>
-#include <ev3dev_stretch/sysfs.h>
+#include <ev3dev_stretch/nxtcolor_gpio.h>
 
 #include <pbio/port.h>
 #include <pbio/iodev.h>
 #include <pbio/light.h>
 
-#define IN (0)
-#define OUT (1)
-
 #define min(a, b) ((a) < (b) ? (a) : (b))
 #define max(a, b) ((a) > (b) ? (a) : (b))
 
-typedef struct {
-    const int digi0; // GPIO on wire 5
-    const int digi1; // GPIO on wire 6
-    const int adc_val; // ADC on wire 6 for getting reflection data
-    const int adc_con; // ADC on wire 1 for detecting sensor
-} nxtcolor_pininfo_t;
-
 static const nxtcolor_pininfo_t pininfo[4] = {
     [PBIO_PORT_1 - PBIO_PORT_1] = {
         .digi0 = 2,
@@ -74,14 +63,7 @@ typedef struct _nxtcolor_t {
     uint32_t raw_max;
     uint16_t crc;
     uint32_t wait_start;
-    const nxtcolor_pininfo_t *pins;
-    FILE *f_digi0_val;
-    FILE *f_digi0_dir;
-    FILE *f_digi1_val;
-    FILE *f_digi1_dir;
-    bool digi1_dir;
-    FILE *f_adc_val;
-    FILE *f_adc_con;
+    nxtcolor_gpio_t gpio;
 } nxtcolor_t;
 
 nxtcolor_t nxtcolorsensors[4];
@@ -109,46 +91,10 @@ pbio_error_t nxtcolor_wait(nxtcolor_t *nxtcolor, uint32_t ms) {
     }
 }
 
-static pbio_error_t nxtcolor_set_digi0(nxtcolor_t *nxtcolor, bool val) {
-    return sysfs_write_int(nxtcolor->f_digi0_val, val);
-}
-
-static pbio_error_t nxtcolor_set_digi1(nxtcolor_t *nxtcolor, bool val) {
-
-    pbio_error_t err;
-
-    // First, ensure it is set as a digital out
-    if (nxtcolor->digi1_dir == IN) {
-        err = sysfs_write_str(nxtcolor->f_digi1_dir, "out");
-        if (err != PBIO_SUCCESS) {
-            return err;
-        }
-        nxtcolor->digi1_dir = OUT;
-    }
-    // Set the requested state
-    return sysfs_write_int(nxtcolor->f_digi1_val, val);
-}
-
-static pbio_error_t nxtcolor_get_digi1(nxtcolor_t *nxtcolor, bool *val) {
-
-    pbio_error_t err;
 
-    // First, ensure it is set as a digital in
-    if (nxtcolor->digi1_dir == OUT) {
-        err = sysfs_write_str(nxtcolor->f_digi1_dir, "in");
-        if (err != PBIO_SUCCESS) {
-            return err;
-        }
-        nxtcolor->digi1_dir = IN;
-    }
-    // Get the state
-    int bit;
-    err = sysfs_read_int(nxtcolor->f_digi1_val, &bit);
-    if (err != PBIO_SUCCESS) {
-        return err;
-    }
-    *val = bit == 1;
-    return PBIO_SUCCESS;
+static pbio_error_t nxtcolor_set_digi0(nxtcolor_t *nxtcolor, bool val) {
+    uint8_t op = val ? NXTCOLOR_GPIO_CLOCK_HIGH : NXTCOLOR_GPIO_CLOCK_LOW;
+    return nxtcolor_gpio_run(&nxtcolor->gpio, &op, 1, NULL);
 }
 
 static pbio_error_t nxtcolor_get_adc(nxtcolor_t *nxtcolor, uint32_t *analog) {
@@ -156,181 +102,99 @@ static pbio_error_t nxtcolor_get_adc(nxtcolor_t *nxtcolor, uint32_t *analog) {
     pbio_error_t err;
 
     // First, ensure it is set as an input
-    if (nxtcolor->digi1_dir == OUT) {
-        err = sysfs_write_str(nxtcolor->f_digi1_dir, "in");
-        if (err != PBIO_SUCCESS) {
-            return err;
-        }
-        nxtcolor->digi1_dir = IN;
+    static const uint8_t ops[] = {
+        NXTCOLOR_GPIO_DATA_INPUT,
+    };
+    err = nxtcolor_gpio_run(&nxtcolor->gpio, ops, sizeof(ops), NULL);
+    if (err != PBIO_SUCCESS) {
+        return err;
     }
     // Get the state
-    return sysfs_read_int(nxtcolor->f_adc_val, (int *)analog);
+    return nxtcolor_gpio_read_adc(&nxtcolor->gpio, NXTCOLOR_GPIO_ADC_VAL, (int32_t *)analog);
 }
 
 static pbio_error_t nxtcolor_reset(nxtcolor_t *nxtcolor)
 {
-    pbio_error_t err;
-
-    // Reset sequence init
-    err = nxtcolor_set_digi0(nxtcolor, 0);
-    if (err != PBIO_SUCCESS) {
-        return err;
-    }
-    err = nxtcolor_set_digi1(nxtcolor, 1);
-    if (err != PBIO_SUCCESS) {
-        return err;
-    }
-
-    // Toggle digi0 several times
-    err = nxtcolor_set_digi0(nxtcolor, 1);
-    if (err != PBIO_SUCCESS) {
-        return err;
-    }
-    err = nxtcolor_set_digi0(nxtcolor, 0);
-    if (err != PBIO_SUCCESS) {
-        return err;
-    }
-    err = nxtcolor_set_digi0(nxtcolor, 1);
-    if (err != PBIO_SUCCESS) {
-        return err;
-    }
-    err = nxtcolor_set_digi0(nxtcolor, 0);
-    if (err != PBIO_SUCCESS) {
-        return err;
-    }
-
-    return PBIO_SUCCESS;
+    static const uint8_t ops[] = {
+        // Reset sequence init
+        NXTCOLOR_GPIO_CLOCK_LOW,
+        NXTCOLOR_GPIO_DATA_HIGH,
+        // Toggle digi0 several times
+        NXTCOLOR_GPIO_CLOCK_HIGH,
+        NXTCOLOR_GPIO_CLOCK_LOW,
+        NXTCOLOR_GPIO_CLOCK_HIGH,
+        NXTCOLOR_GPIO_CLOCK_LOW,
+    };
+    return nxtcolor_gpio_run(&nxtcolor->gpio, ops, sizeof(ops), NULL);
 }
 
+#define READ_BIT_OPS NXTCOLOR_GPIO_CLOCK_HIGH, NXTCOLOR_GPIO_DATA_READ, NXTCOLOR_GPIO_CLOCK_LOW
+
 static pbio_error_t nxtcolor_read_byte(nxtcolor_t *nxtcolor, uint8_t *msg)
 {
-    pbio_error_t err;
+    static const uint8_t ops[] = {
+        // Set data back to input
+        NXTCOLOR_GPIO_DATA_INPUT,
+        // Read 8 bits while toggling the "clock"
+        READ_BIT_OPS, READ_BIT_OPS, READ_BIT_OPS, READ_BIT_OPS,
+        READ_BIT_OPS, READ_BIT_OPS, READ_BIT_OPS, READ_BIT_OPS,
+    };
     *msg = 0;
-
-    // Set data back to input
-    bool bit;
-    err = nxtcolor_get_digi1(nxtcolor, &bit);
-    if (err != PBIO_SUCCESS) {
-        return err;
-    }
-
-    // Read 8 bits while toggling the "clock"
-    for (uint8_t i = 0; i < 8; i++) {
-        err = nxtcolor_set_digi0(nxtcolor, 1);
-        if (err != PBIO_SUCCESS) {
-            return err;
-        }
-        *msg = *msg >> 1;
-        err = nxtcolor_get_digi1(nxtcolor, &bit);
-        if (err != PBIO_SUCCESS) {
-            return err;
-        }
-        if (bit) {
-            *msg |= 0x80;
-        }
-        err = nxtcolor_set_digi0(nxtcolor, 0);
-        if (err != PBIO_SUCCESS) {
-            return err;
-        }
-    }
-    return PBIO_SUCCESS;
+    return nxtcolor_gpio_run(&nxtcolor->gpio, ops, sizeof(ops), msg);
 }
 
 static pbio_error_t nxtcolor_send_byte(nxtcolor_t *nxtcolor, uint8_t msg)
 {
-    pbio_error_t err;
+    uint8_t ops[2 + 8 * 3];
+    uint8_t n = 0;
 
     // Init both pins as low
-    err = nxtcolor_set_digi0(nxtcolor, 0);
-    if (err != PBIO_SUCCESS) {
-        return err;
-    }
-    err = nxtcolor_set_digi1(nxtcolor, 0);
-    if (err != PBIO_SUCCESS) {
-        return err;
-    }
+    ops[n++] = NXTCOLOR_GPIO_CLOCK_LOW;
+    ops[n++] = NXTCOLOR_GPIO_DATA_LOW;
 
-    for (uint8_t i = 0; i < 8; i++)
-	{
-        // Set data pin
-        err = nxtcolor_set_digi1(nxtcolor, msg & 1);
-        if (err != PBIO_SUCCESS) {
-            return err;
-        }
-		msg = msg >> 1;
-
-        // Set clock high
-        err = nxtcolor_set_digi0(nxtcolor, 1);
-        if (err != PBIO_SUCCESS) {
-            return err;
-        }
-
-        // Set clock low
-        err = nxtcolor_set_digi0(nxtcolor, 0);
-        if (err != PBIO_SUCCESS) {
-            return err;
-        }
-	}
+    for (uint8_t i = 0; i < 8; i++) {
+        // Set data pin, then toggle the clock
+        ops[n++] = msg & 1 ? NXTCOLOR_GPIO_DATA_HIGH : NXTCOLOR_GPIO_DATA_LOW;
+        ops[n++] = NXTCOLOR_GPIO_CLOCK_HIGH;
+        ops[n++] = NXTCOLOR_GPIO_CLOCK_LOW;
+        msg = msg >> 1;
+    }
 
-    return PBIO_SUCCESS;
+    return nxtcolor_gpio_run(&nxtcolor->gpio, ops, n, NULL);
 }
 
 static pbio_error_t nxtcolor_init_fs(nxtcolor_t *nxtcolor, pbio_port_t port) {
 
     pbio_error_t err;
 
-    // Get the pin info for this port
-    nxtcolor->pins = &pininfo[port-PBIO_PORT_1];
-
-    // Open the sysfs files for this sensor
-    err = sysfs_open(&nxtcolor->f_digi0_val, "/sys/class/gpio/gpio%d/%s", nxtcolor->pins->digi0, "value", "w");
-    if (err != PBIO_SUCCESS) {
-        return err;
-    }
-    err = sysfs_open(&nxtcolor->f_digi0_dir, "/sys/class/gpio/gpio%d/%s", nxtcolor->pins->digi0, "direction", "w");
-    if (err != PBIO_SUCCESS) {
-        return err;
-    }
-    err = sysfs_open(&nxtcolor->f_digi1_val, "/sys/class/gpio/gpio%d/%s", nxtcolor->pins->digi1, "value", "r+");
-    if (err != PBIO_SUCCESS) {
-        return err;
-    }
-    err = sysfs_open(&nxtcolor->f_digi1_dir, "/sys/class/gpio/gpio%d/%s", nxtcolor->pins->digi1, "direction", "w");
-    if (err != PBIO_SUCCESS) {
-        return err;
-    }
-    err = sysfs_open(&nxtcolor->f_adc_con, "/sys/bus/iio/devices/iio:device0/in_voltage%d_raw%s", nxtcolor->pins->adc_con, "", "r");
-    if (err != PBIO_SUCCESS) {
-        return err;
-    }
-    err = sysfs_open(&nxtcolor->f_adc_val, "/sys/bus/iio/devices/iio:device0/in_voltage%d_raw%s", nxtcolor->pins->adc_val, "", "r");
+    // Open the pins for this port
+    err = nxtcolor_gpio_open(&nxtcolor->gpio, &pininfo[port-PBIO_PORT_1]);
     if (err != PBIO_SUCCESS) {
         return err;
     }
 
     // Verify that the sensor is indeed attached
     int32_t adc_con;
-    err = sysfs_read_int(nxtcolor->f_adc_con, &adc_con);
-    if (adc_con > 50) {
-        return PBIO_ERROR_NO_DEV;
+    err = nxtcolor_gpio_read_adc(&nxtcolor->gpio, NXTCOLOR_GPIO_ADC_CON, &adc_con);
+    if (err == PBIO_SUCCESS && adc_con > 50) {
+        err = PBIO_ERROR_NO_DEV;
     }
 
-    // Digi0 is always an output pin. Init as low
-    err = sysfs_write_str(nxtcolor->f_digi0_dir, "out");
-    if (err != PBIO_SUCCESS) {
-        return err;
+    // Digi0 is always an output pin. Digi1 can be set as output, or read as
+    // digital, and analog. Init both as low.
+    if (err == PBIO_SUCCESS) {
+        static const uint8_t ops[] = {
+            NXTCOLOR_GPIO_CLOCK_LOW,
+            NXTCOLOR_GPIO_DATA_LOW,
+        };
+        err = nxtcolor_gpio_run(&nxtcolor->gpio, ops, sizeof(ops), NULL);
     }
-    err = nxtcolor_set_digi0(nxtcolor, 0);
+
+    // Close the pins again so that we can start over on the next try
     if (err != PBIO_SUCCESS) {
-        return err;
+        nxtcolor_gpio_close(&nxtcolor->gpio);
     }
-    // Digi1 can be set as output, or read as digital, and analog. Init as low.
-    err = nxtcolor_set_digi1(nxtcolor, 0);
-    if (err != PBIO_SUCCESS) {
-        return err;
-    }
-
-    return PBIO_SUCCESS;
+    return err;
 }
 
 static pbio_error_t nxtcolor_init(nxtcolor_t *nxtcolor, pbio_port_t port) {
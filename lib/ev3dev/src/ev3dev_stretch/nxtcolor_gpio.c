@@ -0,0 +1,490 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+// Pin access for the NXT Color Sensor
+//
+// The sensor protocol toggles the clock line three times for each bit, so the
+// cost of each pin change adds up quickly. The GPIO character device changes
+// a line with a single ioctl. While the sensor is sent data, both lines are
+// outputs and share one line handle, so level changes that may happen at the
+// same time are done with a single ioctl. This is not possible while reading,
+// because the kernel ABI gives all lines of a handle the same direction, so
+// each direction change requests new handles. The sysfs GPIO files are used
+// if the lines are not available that way, for example when they are exported
+// in sysfs. They take one write per pin change. Both backends use raw file
+// descriptors so that there is no stdio buffering or number formatting and
+// seeking in between.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <linux/gpio.h>
+#include <sys/ioctl.h>
+
+#include <ev3dev_stretch/nxtcolor_gpio.h>
+
+#define GPIO_CHIP_PATH "/dev/gpiochip0"
+#define GPIO_CONSUMER "pybricks-nxtcolor"
+#define MAX_PATH_LENGTH 60
+
+// Backend chosen with nxtcolor_gpio_set_backend(), or NULL for the default
+static const nxtcolor_gpio_backend_t *backend_override;
+
+static void close_fd(int *fd) {
+    if (*fd >= 0) {
+        close(*fd);
+        *fd = -1;
+    }
+}
+
+static void close_fds(nxtcolor_gpio_t *gpio) {
+    close_fd(&gpio->fd_chip);
+    close_fd(&gpio->fd_clock);
+    close_fd(&gpio->fd_data);
+    close_fd(&gpio->fd_data_dir);
+    close_fd(&gpio->fd_pair);
+    close_fd(&gpio->fd_adc[NXTCOLOR_GPIO_ADC_VAL]);
+    close_fd(&gpio->fd_adc[NXTCOLOR_GPIO_ADC_CON]);
+}
+
+static pbio_error_t open_path(int *fd, int flags, const char *pathpat, int n, const char *attribute) {
+    char path[MAX_PATH_LENGTH];
+    snprintf(path, MAX_PATH_LENGTH, pathpat, n, attribute);
+    *fd = open(path, flags | O_CLOEXEC);
+    return *fd < 0 ? PBIO_ERROR_IO : PBIO_SUCCESS;
+}
+
+static pbio_error_t open_adcs(nxtcolor_gpio_t *gpio) {
+    pbio_error_t err;
+    err = open_path(&gpio->fd_adc[NXTCOLOR_GPIO_ADC_VAL], O_RDONLY, "/sys/bus/iio/devices/iio:device0/in_voltage%d_raw%s", gpio->pins->adc_val, "");
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+    return open_path(&gpio->fd_adc[NXTCOLOR_GPIO_ADC_CON], O_RDONLY, "/sys/bus/iio/devices/iio:device0/in_voltage%d_raw%s", gpio->pins->adc_con, "");
+}
+
+// Reads a number from a sysfs attribute in a single system call
+static pbio_error_t read_int(int fd, int32_t *value) {
+    char buf[16];
+    ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+    if (n <= 0) {
+        return PBIO_ERROR_IO;
+    }
+    buf[n] = '\0';
+    *value = strtol(buf, NULL, 10);
+    return PBIO_SUCCESS;
+}
+
+// Writes a string to a sysfs attribute in a single system call
+static pbio_error_t write_str(int fd, const char *str) {
+    size_t len = strlen(str);
+    return pwrite(fd, str, len, 0) == (ssize_t)len ? PBIO_SUCCESS : PBIO_ERROR_IO;
+}
+
+static pbio_error_t read_adc(nxtcolor_gpio_t *gpio, nxtcolor_gpio_adc_t adc, int32_t *value) {
+    return read_int(gpio->fd_adc[adc], value);
+}
+
+// Stores the next received bit in the input buffer
+static void store_bit(uint8_t *in, size_t *num_bits, bool bit) {
+    if (bit) {
+        in[*num_bits / 8] |= 1 << (*num_bits % 8);
+    }
+    (*num_bits)++;
+}
+
+// GPIO character device
+
+// Requests lines with the same direction, replacing the handle in fd. Each
+// request sets the direction and, for outputs, the levels in one go.
+static pbio_error_t chardev_request(nxtcolor_gpio_t *gpio, int *fd, const int *offsets, const bool *levels, uint32_t lines, bool out) {
+    struct gpiohandle_request req;
+
+    close_fd(fd);
+
+    memset(&req, 0, sizeof(req));
+    for (uint32_t i = 0; i < lines; i++) {
+        req.lineoffsets[i] = offsets[i];
+        req.default_values[i] = levels[i];
+    }
+    req.lines = lines;
+    req.flags = out ? GPIOHANDLE_REQUEST_OUTPUT : GPIOHANDLE_REQUEST_INPUT;
+    strncpy(req.consumer_label, GPIO_CONSUMER, sizeof(req.consumer_label) - 1);
+
+    if (ioctl(gpio->fd_chip, GPIO_GET_LINEHANDLE_IOCTL, &req) < 0) {
+        return PBIO_ERROR_IO;
+    }
+    *fd = req.fd;
+    return PBIO_SUCCESS;
+}
+
+static pbio_error_t chardev_request_clock(nxtcolor_gpio_t *gpio, bool out) {
+    pbio_error_t err = chardev_request(gpio, &gpio->fd_clock, &gpio->pins->digi0, &gpio->clock_level, 1, out);
+    gpio->clock_out = out && err == PBIO_SUCCESS;
+    return err;
+}
+
+static pbio_error_t chardev_request_data(nxtcolor_gpio_t *gpio, bool out) {
+    pbio_error_t err = chardev_request(gpio, &gpio->fd_data, &gpio->pins->digi1, &gpio->data_level, 1, out);
+    gpio->data_out = out && err == PBIO_SUCCESS;
+    return err;
+}
+
+// Drives both lines with one handle, so they can change with one ioctl
+static pbio_error_t chardev_request_pair(nxtcolor_gpio_t *gpio) {
+    const int offsets[] = { gpio->pins->digi0, gpio->pins->digi1 };
+    const bool levels[] = { gpio->clock_level, gpio->data_level };
+
+    // The lines can only be requested once they are released
+    close_fd(&gpio->fd_clock);
+    close_fd(&gpio->fd_data);
+
+    pbio_error_t err = chardev_request(gpio, &gpio->fd_pair, offsets, levels, 2, true);
+    gpio->clock_out = err == PBIO_SUCCESS;
+    gpio->data_out = err == PBIO_SUCCESS;
+    return err;
+}
+
+static pbio_error_t chardev_set(int fd, const bool *levels, uint32_t lines) {
+    struct gpiohandle_data data;
+    memset(&data, 0, sizeof(data));
+    for (uint32_t i = 0; i < lines; i++) {
+        data.values[i] = levels[i];
+    }
+    return ioctl(fd, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data) < 0 ? PBIO_ERROR_IO : PBIO_SUCCESS;
+}
+
+static pbio_error_t chardev_get(int fd, bool *level) {
+    struct gpiohandle_data data;
+    if (ioctl(fd, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data) < 0) {
+        return PBIO_ERROR_IO;
+    }
+    *level = data.values[0];
+    return PBIO_SUCCESS;
+}
+
+// Drives the lines to the levels in gpio. Lines that are not changed keep
+// their direction.
+static pbio_error_t chardev_set_levels(nxtcolor_gpio_t *gpio, bool clock_changed, bool data_changed) {
+    if (gpio->fd_pair >= 0) {
+        const bool levels[] = { gpio->clock_level, gpio->data_level };
+        return chardev_set(gpio->fd_pair, levels, 2);
+    }
+
+    // Use one handle for both lines as soon as both are outputs
+    if ((clock_changed || gpio->clock_out) && (data_changed || gpio->data_out)) {
+        return chardev_request_pair(gpio);
+    }
+
+    if (clock_changed) {
+        return gpio->clock_out ? chardev_set(gpio->fd_clock, &gpio->clock_level, 1) : chardev_request_clock(gpio, true);
+    }
+    return gpio->data_out ? chardev_set(gpio->fd_data, &gpio->data_level, 1) : chardev_request_data(gpio, true);
+}
+
+// Stops driving the data line, which means the lines need their own handles
+static pbio_error_t chardev_set_data_input(nxtcolor_gpio_t *gpio) {
+    if (gpio->fd_pair >= 0) {
+        close_fd(&gpio->fd_pair);
+        pbio_error_t err = chardev_request_clock(gpio, true);
+        if (err != PBIO_SUCCESS) {
+            return err;
+        }
+    }
+    return chardev_request_data(gpio, false);
+}
+
+static pbio_error_t chardev_open(nxtcolor_gpio_t *gpio) {
+    pbio_error_t err;
+
+    err = open_adcs(gpio);
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+
+    gpio->fd_chip = open(GPIO_CHIP_PATH, O_RDWR | O_CLOEXEC);
+    if (gpio->fd_chip < 0) {
+        return PBIO_ERROR_NOT_SUPPORTED;
+    }
+
+    // All sensor pins are on the first chip, with offsets equal to their
+    // global GPIO numbers.
+    struct gpiochip_info info;
+    if (ioctl(gpio->fd_chip, GPIO_GET_CHIPINFO_IOCTL, &info) < 0) {
+        return PBIO_ERROR_IO;
+    }
+    if ((int)info.lines <= gpio->pins->digi0 || (int)info.lines <= gpio->pins->digi1) {
+        return PBIO_ERROR_NOT_SUPPORTED;
+    }
+
+    // Claim both lines without driving them. This fails if they are in use
+    // elsewhere, in which case the sysfs backend can be used instead.
+    err = chardev_request_clock(gpio, false);
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+    return chardev_request_data(gpio, false);
+}
+
+static pbio_error_t chardev_run(nxtcolor_gpio_t *gpio, const uint8_t *ops, size_t num_ops, uint8_t *in) {
+    pbio_error_t err = PBIO_SUCCESS;
+    size_t num_bits = 0;
+
+    for (size_t i = 0; i < num_ops && err == PBIO_SUCCESS;) {
+        // Change as many levels at once as the protocol allows
+        size_t num_levels = nxtcolor_gpio_get_batch(ops + i, num_ops - i);
+        if (num_levels > 0) {
+            bool clock_changed = false;
+            bool data_changed = false;
+            for (size_t j = i; j < i + num_levels; j++) {
+                if (ops[j] == NXTCOLOR_GPIO_CLOCK_LOW || ops[j] == NXTCOLOR_GPIO_CLOCK_HIGH) {
+                    gpio->clock_level = ops[j] == NXTCOLOR_GPIO_CLOCK_HIGH;
+                    clock_changed = true;
+                } else {
+                    gpio->data_level = ops[j] == NXTCOLOR_GPIO_DATA_HIGH;
+                    data_changed = true;
+                }
+            }
+            err = chardev_set_levels(gpio, clock_changed, data_changed);
+            i += num_levels;
+            continue;
+        }
+
+        bool level;
+        switch (ops[i]) {
+            case NXTCOLOR_GPIO_DATA_INPUT:
+            case NXTCOLOR_GPIO_DATA_READ:
+                if (gpio->data_out) {
+                    err = chardev_set_data_input(gpio);
+                    if (err != PBIO_SUCCESS) {
+                        break;
+                    }
+                }
+                if (ops[i] == NXTCOLOR_GPIO_DATA_READ) {
+                    err = chardev_get(gpio->fd_data, &level);
+                    store_bit(in, &num_bits, level);
+                }
+                break;
+            default:
+                err = PBIO_ERROR_INVALID_ARG;
+                break;
+        }
+        i++;
+    }
+    return err;
+}
+
+const nxtcolor_gpio_backend_t nxtcolor_gpio_backend_chardev = {
+    .name = "chardev",
+    .open = chardev_open,
+    .run = chardev_run,
+    .read_adc = read_adc,
+    .close = close_fds,
+};
+
+// sysfs GPIO files
+
+static pbio_error_t sysfs_open(nxtcolor_gpio_t *gpio) {
+    pbio_error_t err;
+
+    err = open_adcs(gpio);
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+    err = open_path(&gpio->fd_clock, O_WRONLY, "/sys/class/gpio/gpio%d/%s", gpio->pins->digi0, "value");
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+    err = open_path(&gpio->fd_data, O_RDWR, "/sys/class/gpio/gpio%d/%s", gpio->pins->digi1, "value");
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+    return open_path(&gpio->fd_data_dir, O_WRONLY, "/sys/class/gpio/gpio%d/%s", gpio->pins->digi1, "direction");
+}
+
+// Makes the clock an output. This is done only once, so the direction file
+// is not kept open.
+static pbio_error_t sysfs_set_clock_out(nxtcolor_gpio_t *gpio, bool level) {
+    int fd;
+    pbio_error_t err = open_path(&fd, O_WRONLY, "/sys/class/gpio/gpio%d/%s", gpio->pins->digi0, "direction");
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+    err = write_str(fd, level ? "high" : "low");
+    close(fd);
+    return err;
+}
+
+static pbio_error_t sysfs_run(nxtcolor_gpio_t *gpio, const uint8_t *ops, size_t num_ops, uint8_t *in) {
+    pbio_error_t err = PBIO_SUCCESS;
+    size_t num_bits = 0;
+
+    for (size_t i = 0; i < num_ops && err == PBIO_SUCCESS; i++) {
+        int32_t value;
+        bool level;
+        switch (ops[i]) {
+            case NXTCOLOR_GPIO_CLOCK_LOW:
+            case NXTCOLOR_GPIO_CLOCK_HIGH:
+                level = ops[i] == NXTCOLOR_GPIO_CLOCK_HIGH;
+                if (gpio->clock_out) {
+                    err = write_str(gpio->fd_clock, level ? "1" : "0");
+                    break;
+                }
+                err = sysfs_set_clock_out(gpio, level);
+                gpio->clock_out = err == PBIO_SUCCESS;
+                break;
+            case NXTCOLOR_GPIO_DATA_LOW:
+            case NXTCOLOR_GPIO_DATA_HIGH:
+                level = ops[i] == NXTCOLOR_GPIO_DATA_HIGH;
+                if (gpio->data_out) {
+                    err = write_str(gpio->fd_data, level ? "1" : "0");
+                    break;
+                }
+                // Writing the level to the direction sets both at once
+                err = write_str(gpio->fd_data_dir, level ? "high" : "low");
+                gpio->data_out = err == PBIO_SUCCESS;
+                break;
+            case NXTCOLOR_GPIO_DATA_INPUT:
+            case NXTCOLOR_GPIO_DATA_READ:
+                if (gpio->data_out) {
+                    err = write_str(gpio->fd_data_dir, "in");
+                    if (err != PBIO_SUCCESS) {
+                        break;
+                    }
+                    gpio->data_out = false;
+                }
+                if (ops[i] == NXTCOLOR_GPIO_DATA_READ) {
+                    err = read_int(gpio->fd_data, &value);
+                    store_bit(in, &num_bits, value == 1);
+                }
+                break;
+            default:
+                err = PBIO_ERROR_INVALID_ARG;
+                break;
+        }
+    }
+    return err;
+}
+
+const nxtcolor_gpio_backend_t nxtcolor_gpio_backend_sysfs = {
+    .name = "sysfs",
+    .open = sysfs_open,
+    .run = sysfs_run,
+    .read_adc = read_adc,
+    .close = close_fds,
+};
+
+/**
+ * Sets the backend used by sensors that are opened after this call. This is
+ * meant for mocks and benchmarks on a host. Use NULL to go back to the
+ * default, which is the character device if it is available, or else sysfs.
+ */
+void nxtcolor_gpio_set_backend(const nxtcolor_gpio_backend_t *backend) {
+    backend_override = backend;
+}
+
+static pbio_error_t open_backend(nxtcolor_gpio_t *gpio, const nxtcolor_gpio_backend_t *backend) {
+    gpio->backend = backend;
+    gpio->fd_chip = -1;
+    gpio->fd_clock = -1;
+    gpio->fd_data = -1;
+    gpio->fd_data_dir = -1;
+    gpio->fd_pair = -1;
+    gpio->fd_adc[NXTCOLOR_GPIO_ADC_VAL] = -1;
+    gpio->fd_adc[NXTCOLOR_GPIO_ADC_CON] = -1;
+    gpio->clock_out = false;
+    gpio->data_out = false;
+    gpio->clock_level = false;
+    gpio->data_level = false;
+
+    pbio_error_t err = backend->open(gpio);
+    if (err != PBIO_SUCCESS) {
+        backend->close(gpio);
+    }
+    return err;
+}
+
+/**
+ * Opens the pins of a sensor. This does not change the state of the pins.
+ * @param [in]  gpio        The pin state
+ * @param [in]  pins        The pins to use
+ * @return                  ::PBIO_SUCCESS or an error if no backend can
+ *                          access the pins.
+ */
+pbio_error_t nxtcolor_gpio_open(nxtcolor_gpio_t *gpio, const nxtcolor_pininfo_t *pins) {
+    gpio->pins = pins;
+
+    if (backend_override) {
+        return open_backend(gpio, backend_override);
+    }
+    if (open_backend(gpio, &nxtcolor_gpio_backend_chardev) == PBIO_SUCCESS) {
+        return PBIO_SUCCESS;
+    }
+    return open_backend(gpio, &nxtcolor_gpio_backend_sysfs);
+}
+
+/**
+ * Gets how many level changes at the start of a list of pin operations can
+ * be done at the same time. Each line changes at most once, and a rising
+ * clock edge always comes after earlier changes, so that the data line is
+ * stable by the time the sensor reads it.
+ * @param [in]  ops         The operations, of type ::nxtcolor_gpio_op_t
+ * @param [in]  num_ops     The number of operations
+ * @return                  The number of operations that can be combined,
+ *                          or 0 if the first one is not a level change.
+ */
+size_t nxtcolor_gpio_get_batch(const uint8_t *ops, size_t num_ops) {
+    bool clock_changed = false;
+    bool data_changed = false;
+
+    for (size_t i = 0; i < num_ops; i++) {
+        switch (ops[i]) {
+            case NXTCOLOR_GPIO_CLOCK_HIGH:
+                if (i > 0) {
+                    return i;
+                }
+            // fallthrough
+            case NXTCOLOR_GPIO_CLOCK_LOW:
+                if (clock_changed) {
+                    return i;
+                }
+                clock_changed = true;
+                break;
+            case NXTCOLOR_GPIO_DATA_LOW:
+            case NXTCOLOR_GPIO_DATA_HIGH:
+                if (data_changed) {
+                    return i;
+                }
+                data_changed = true;
+                break;
+            default:
+                return i;
+        }
+    }
+    return num_ops;
+}
+
+/**
+ * Runs a list of pin operations.
+ * @param [in]  gpio        The pin state
+ * @param [in]  ops         The operations, of type ::nxtcolor_gpio_op_t
+ * @param [in]  num_ops     The number of operations
+ * @param [out] in          Buffer for bits that are read, LSB first. It must
+ *                          be zeroed by the caller. May be NULL if nothing
+ *                          is read.
+ * @return                  ::PBIO_SUCCESS or an I/O error
+ */
+pbio_error_t nxtcolor_gpio_run(nxtcolor_gpio_t *gpio, const uint8_t *ops, size_t num_ops, uint8_t *in) {
+    return gpio->backend->run(gpio, ops, num_ops, in);
+}
+
+pbio_error_t nxtcolor_gpio_read_adc(nxtcolor_gpio_t *gpio, nxtcolor_gpio_adc_t adc, int32_t *value) {
+    return gpio->backend->read_adc(gpio, adc, value);
+}
+
+void nxtcolor_gpio_close(nxtcolor_gpio_t *gpio) {
+    gpio->backend->close(gpio);
+}
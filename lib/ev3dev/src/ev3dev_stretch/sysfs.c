@@ -8,6 +8,7 @@
 
 #include <ev3dev_stretch/lego_sensor.h>
 
+#include <pbdrv/ioport.h>
 #include <pbio/port.h>
 #include <pbio/iodev.h>
 
@@ -16,6 +17,15 @@
 
 // Get the ev3dev sensor number for a given port
 pbio_error_t sysfs_get_number(pbio_port_t port, const char *rdir, int *sysfs_number) {
+    // Use the udev device index if it knows about this port and class. This
+    // avoids opening the address attribute of every device in the class. If
+    // the index has no device, it may just not have seen the event for it
+    // yet, so scan sysfs to be sure.
+    if (strncmp(rdir, "/sys/class/", strlen("/sys/class/")) == 0 &&
+        pbdrv_ioport_ev3dev_get_number(port, rdir + strlen("/sys/class/"), sysfs_number) == PBIO_SUCCESS) {
+        return PBIO_SUCCESS;
+    }
+
     // Open lego-sensor directory in sysfs
     DIR *d_sensor;
     struct dirent *entry;
@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#include <pbdrv/config.h>
+
+#if PBDRV_CONFIG_COUNTER_VIRTUAL
+
+#include <stdint.h>
+
+#include <contiki.h>
+
+#include <pbio/util.h>
+#include <pbio/port.h>
+#include "counter.h"
+
+#include "../virtual/motor_virtual.h"
+
+typedef struct {
+    pbdrv_counter_dev_t dev;
+    pbdrv_motor_sim_t *sim;
+} private_data_t;
+
+static private_data_t private_data[PBDRV_CONFIG_COUNTER_VIRTUAL_NUM_DEV];
+
+static pbio_error_t pbdrv_counter_virtual_get_count(pbdrv_counter_dev_t *dev, int32_t *count) {
+    private_data_t *data = PBIO_CONTAINER_OF(dev, private_data_t, dev);
+
+    *count = pbdrv_motor_sim_get_count(data->sim, clock_usecs());
+
+    return PBIO_SUCCESS;
+}
+
+static pbio_error_t pbdrv_counter_virtual_get_rate(pbdrv_counter_dev_t *dev, int32_t *rate) {
+    private_data_t *data = PBIO_CONTAINER_OF(dev, private_data_t, dev);
+
+    *rate = pbdrv_motor_sim_get_rate(data->sim, clock_usecs());
+
+    return PBIO_SUCCESS;
+}
+
+static pbio_error_t counter_virtual_init() {
+    for (int i = 0; i < PBDRV_CONFIG_COUNTER_VIRTUAL_NUM_DEV; i++) {
+        private_data_t *data = &private_data[i];
+
+        // Each counter is the encoder of the virtual motor on the same port
+        pbio_error_t err = pbdrv_motor_virtual_get_sim(PBDRV_CONFIG_FIRST_MOTOR_PORT + i, &data->sim);
+        if (err != PBIO_SUCCESS) {
+            return err;
+        }
+        data->dev.get_count = pbdrv_counter_virtual_get_count;
+        data->dev.get_rate = pbdrv_counter_virtual_get_rate;
+        data->dev.initalized = true;
+
+        pbdrv_counter_register(i, &data->dev);
+    }
+
+    return PBIO_SUCCESS;
+}
+
+static pbio_error_t counter_virtual_exit() {
+    for (int i = 0; i < PBDRV_CONFIG_COUNTER_VIRTUAL_NUM_DEV; i++) {
+        private_data_t *data = &private_data[i];
+
+        data->dev.initalized = false;
+        pbdrv_counter_unregister(&data->dev);
+    }
+    return PBIO_SUCCESS;
+}
+
+const pbdrv_counter_drv_t pbdrv_counter_virtual_drv = {
+    .init = counter_virtual_init,
+    .exit = counter_virtual_exit,
+};
+
+#endif // PBDRV_CONFIG_COUNTER_VIRTUAL
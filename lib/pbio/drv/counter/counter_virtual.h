@@ -0,0 +1,22 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#ifndef _PBDRV_COUNTER_VIRTUAL_H_
+#define _PBDRV_COUNTER_VIRTUAL_H_
+
+#include <pbdrv/config.h>
+
+#if PBDRV_CONFIG_COUNTER_VIRTUAL
+
+#include "counter.h"
+
+#if !PBDRV_CONFIG_COUNTER_VIRTUAL_NUM_DEV
+#error Platform must define PBDRV_CONFIG_COUNTER_VIRTUAL_NUM_DEV
+#endif
+
+// defined in counter_virtual.c
+extern const pbdrv_counter_drv_t pbdrv_counter_virtual_drv;
+
+#endif // PBDRV_CONFIG_COUNTER_VIRTUAL
+
+#endif // _PBDRV_COUNTER_VIRTUAL_H_
@@ -1118,6 +1118,25 @@ pbio_error_t pbdrv_bluetooth_tx(uint8_t c) {
     return PBIO_SUCCESS;
 }
 
+pbio_error_t pbdrv_bluetooth_tx_buf(const uint8_t *data, uint32_t size, uint32_t *written) {
+    pbio_error_t err;
+    uint32_t i;
+
+    for (i = 0; i < size; i++) {
+        err = pbdrv_bluetooth_tx(data[i]);
+        if (err == PBIO_ERROR_AGAIN && i > 0) {
+            break;
+        }
+        if (err != PBIO_SUCCESS) {
+            return err;
+        }
+    }
+
+    *written = i;
+
+    return PBIO_SUCCESS;
+}
+
 static PT_THREAD(uart_service_send_data(struct pt *pt))
 {
     PT_BEGIN(pt);
@@ -0,0 +1,284 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+// Driver for the LSM6DS3TR-C IMU connected to an STM32 I2C peripheral.
+//
+// Samples are collected by the chip in its FIFO at a high rate. A background
+// process periodically drains the FIFO using interrupt-driven I2C transfers
+// and keeps a short, timestamped history of samples.
+//
+// Platform should override HAL_I2C_MspInit() to configure pin mux and enable
+// the I2C interrupts. The I2C interrupt handlers should call the
+// pbdrv_imu_lsm6ds3tr_c_stm32_hal_handle_i2c_*_irq() functions.
+
+#include <pbdrv/config.h>
+
+#if PBDRV_CONFIG_IMU_LSM6DS3TR_C_STM32_HAL
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <contiki.h>
+#include <lsm6ds3tr_c_reg.h>
+
+#include <pbdrv/imu.h>
+#include <pbio/error.h>
+
+#include STM32_HAL_H
+
+#include "imu_lsm6ds3tr_c_stm32_hal.h"
+
+#define IMU_POLL_PERIOD_MS      10      // FIFO polling period in milliseconds
+#define IMU_ODR_HZ              416     // must match the ODR settings below
+#define IMU_SAMPLE_PERIOD_US    (1000000 / IMU_ODR_HZ)
+#define IMU_WORDS_PER_SAMPLE    6       // gyro x, y, z then accel x, y, z
+#define IMU_MAX_READ_SAMPLES    16      // max samples per FIFO transfer
+#define IMU_HISTORY_SIZE        32      // must be a power of 2!
+#define IMU_I2C_TIMEOUT_MS      100     // timeout for blocking transfers during init
+
+// LSB sizes for the full scale settings below
+#define IMU_GYRO_MDPS_PER_LSB   70      // 2000 dps full scale
+#define IMU_ACCEL_UMS2_PER_LSB  2393    // 8 g full scale, 0.244 mg/LSB in um/s^2
+
+static I2C_HandleTypeDef pbdrv_imu_hi2c;
+static stmdev_ctx_t pbdrv_imu_ctx;
+static volatile bool pbdrv_imu_xfer_done;
+static volatile bool pbdrv_imu_xfer_err;
+static pbio_error_t pbdrv_imu_err = PBIO_ERROR_AGAIN;
+
+static uint8_t pbdrv_imu_fifo_status[4];
+static int16_t pbdrv_imu_fifo_data[IMU_MAX_READ_SAMPLES * IMU_WORDS_PER_SAMPLE];
+
+// words of the sample that is currently being assembled from the FIFO
+static int16_t pbdrv_imu_partial[IMU_WORDS_PER_SAMPLE];
+
+static pbdrv_imu_sample_t pbdrv_imu_history[IMU_HISTORY_SIZE];
+// sequence number of the most recent sample in history or 0 if none yet
+static uint32_t pbdrv_imu_last_seq;
+
+PROCESS(pbdrv_imu_process, "IMU");
+
+pbio_error_t pbdrv_imu_get_sample(pbdrv_imu_sample_t *sample) {
+    if (pbdrv_imu_err != PBIO_SUCCESS) {
+        return pbdrv_imu_err;
+    }
+
+    if (pbdrv_imu_last_seq == 0) {
+        return PBIO_ERROR_AGAIN;
+    }
+
+    *sample = pbdrv_imu_history[pbdrv_imu_last_seq & (IMU_HISTORY_SIZE - 1)];
+
+    return PBIO_SUCCESS;
+}
+
+pbio_error_t pbdrv_imu_read_samples(uint32_t *seq, pbdrv_imu_sample_t *samples, uint32_t *count) {
+    uint32_t n = 0;
+
+    if (pbdrv_imu_err == PBIO_ERROR_NO_DEV) {
+        *count = 0;
+        return PBIO_ERROR_NO_DEV;
+    }
+
+    uint32_t next = *seq + 1;
+
+    // skip samples that are no longer in the history
+    if (pbdrv_imu_last_seq - *seq > IMU_HISTORY_SIZE) {
+        next = pbdrv_imu_last_seq - IMU_HISTORY_SIZE + 1;
+    }
+
+    while (n < *count && (int32_t)(pbdrv_imu_last_seq - next) >= 0) {
+        samples[n++] = pbdrv_imu_history[next & (IMU_HISTORY_SIZE - 1)];
+        *seq = next++;
+    }
+
+    *count = n;
+
+    return PBIO_SUCCESS;
+}
+
+void pbdrv_imu_lsm6ds3tr_c_stm32_hal_handle_i2c_er_irq() {
+    HAL_I2C_ER_IRQHandler(&pbdrv_imu_hi2c);
+}
+
+void pbdrv_imu_lsm6ds3tr_c_stm32_hal_handle_i2c_ev_irq() {
+    HAL_I2C_EV_IRQHandler(&pbdrv_imu_hi2c);
+}
+
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c) {
+    pbdrv_imu_xfer_done = true;
+    process_poll(&pbdrv_imu_process);
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c) {
+    pbdrv_imu_xfer_err = true;
+    pbdrv_imu_xfer_done = true;
+    process_poll(&pbdrv_imu_process);
+}
+
+// Blocking register access, only used during initialization
+
+static int32_t pbdrv_imu_write_reg(void *handle, uint8_t reg, uint8_t *data, uint16_t len) {
+    return HAL_I2C_Mem_Write(&pbdrv_imu_hi2c, LSM6DS3TR_C_I2C_ADD_L, reg,
+        I2C_MEMADD_SIZE_8BIT, data, len, IMU_I2C_TIMEOUT_MS);
+}
+
+static int32_t pbdrv_imu_read_reg(void *handle, uint8_t reg, uint8_t *data, uint16_t len) {
+    return HAL_I2C_Mem_Read(&pbdrv_imu_hi2c, LSM6DS3TR_C_I2C_ADD_L, reg,
+        I2C_MEMADD_SIZE_8BIT, data, len, IMU_I2C_TIMEOUT_MS);
+}
+
+// Starts an interrupt-driven read. Completion is signaled by pbdrv_imu_xfer_done.
+static bool pbdrv_imu_read_begin(uint8_t reg, void *data, uint16_t len) {
+    pbdrv_imu_xfer_done = false;
+    pbdrv_imu_xfer_err = false;
+    return HAL_I2C_Mem_Read_IT(&pbdrv_imu_hi2c, LSM6DS3TR_C_I2C_ADD_L, reg,
+        I2C_MEMADD_SIZE_8BIT, data, len) == HAL_OK;
+}
+
+static pbio_error_t pbdrv_imu_init(void) {
+    stmdev_ctx_t *ctx = &pbdrv_imu_ctx;
+
+    pbdrv_imu_hi2c.Instance = PBDRV_CONFIG_IMU_LSM6DS3TR_C_STM32_HAL_I2C_INSTANCE;
+    pbdrv_imu_hi2c.Init.Timing = PBDRV_CONFIG_IMU_LSM6DS3TR_C_STM32_HAL_I2C_TIMING;
+    pbdrv_imu_hi2c.Init.OwnAddress1 = 0;
+    pbdrv_imu_hi2c.Init.AddressingMode = I2C_ADDRESSINGMODE_7BIT;
+    pbdrv_imu_hi2c.Init.DualAddressMode = I2C_DUALADDRESS_DISABLE;
+    pbdrv_imu_hi2c.Init.GeneralCallMode = I2C_GENERALCALL_DISABLE;
+    pbdrv_imu_hi2c.Init.NoStretchMode = I2C_NOSTRETCH_DISABLE;
+    if (HAL_I2C_Init(&pbdrv_imu_hi2c) != HAL_OK) {
+        return PBIO_ERROR_IO;
+    }
+
+    ctx->write_reg = pbdrv_imu_write_reg;
+    ctx->read_reg = pbdrv_imu_read_reg;
+
+    uint8_t id;
+    if (lsm6ds3tr_c_device_id_get(ctx, &id) != 0 || id != LSM6DS3TR_C_ID) {
+        return PBIO_ERROR_NO_DEV;
+    }
+
+    // Restore default configuration
+    uint8_t rst;
+    lsm6ds3tr_c_reset_set(ctx, PROPERTY_ENABLE);
+    do {
+        if (lsm6ds3tr_c_reset_get(ctx, &rst) != 0) {
+            return PBIO_ERROR_IO;
+        }
+    } while (rst);
+
+    int32_t ret = 0;
+
+    ret |= lsm6ds3tr_c_block_data_update_set(ctx, PROPERTY_ENABLE);
+    ret |= lsm6ds3tr_c_xl_full_scale_set(ctx, LSM6DS3TR_C_8g);
+    ret |= lsm6ds3tr_c_gy_full_scale_set(ctx, LSM6DS3TR_C_2000dps);
+    ret |= lsm6ds3tr_c_xl_filter_analog_set(ctx, LSM6DS3TR_C_XL_ANA_BW_400Hz);
+    ret |= lsm6ds3tr_c_gy_band_pass_set(ctx, LSM6DS3TR_C_HP_DISABLE_LP1_NORMAL);
+
+    // Gyro and accel both go into the FIFO without decimation, so each
+    // sample is 6 words: gyro x, y, z followed by accel x, y, z.
+    ret |= lsm6ds3tr_c_fifo_gy_batch_set(ctx, LSM6DS3TR_C_FIFO_GY_NO_DEC);
+    ret |= lsm6ds3tr_c_fifo_xl_batch_set(ctx, LSM6DS3TR_C_FIFO_XL_NO_DEC);
+    ret |= lsm6ds3tr_c_fifo_data_rate_set(ctx, LSM6DS3TR_C_FIFO_416Hz);
+    ret |= lsm6ds3tr_c_fifo_mode_set(ctx, LSM6DS3TR_C_STREAM_MODE);
+
+    ret |= lsm6ds3tr_c_xl_data_rate_set(ctx, LSM6DS3TR_C_XL_ODR_416Hz);
+    ret |= lsm6ds3tr_c_gy_data_rate_set(ctx, LSM6DS3TR_C_GY_ODR_416Hz);
+
+    return ret ? PBIO_ERROR_IO : PBIO_SUCCESS;
+}
+
+// Parses FIFO words into samples. *first_idx* is the position in the sample
+// pattern of the first word and *backlog* is the number of samples still in
+// the FIFO after these words, which is used to estimate the timestamps.
+static void pbdrv_imu_handle_fifo_data(uint16_t num_words, uint16_t first_idx, uint16_t backlog, uint32_t now) {
+    uint16_t idx = first_idx;
+    uint16_t num_samples = (first_idx + num_words) / IMU_WORDS_PER_SAMPLE;
+
+    for (uint16_t i = 0; i < num_words; i++) {
+        pbdrv_imu_partial[idx++] = pbdrv_imu_fifo_data[i];
+
+        if (idx < IMU_WORDS_PER_SAMPLE) {
+            continue;
+        }
+        idx = 0;
+
+        uint32_t seq = pbdrv_imu_last_seq + 1;
+        pbdrv_imu_sample_t *sample = &pbdrv_imu_history[seq & (IMU_HISTORY_SIZE - 1)];
+
+        for (int j = 0; j < 3; j++) {
+            sample->gyro[j] = pbdrv_imu_partial[j] * IMU_GYRO_MDPS_PER_LSB;
+            sample->accel[j] = pbdrv_imu_partial[j + 3] * IMU_ACCEL_UMS2_PER_LSB / 1000;
+        }
+
+        num_samples--;
+        sample->timestamp = now - (backlog + num_samples) * IMU_SAMPLE_PERIOD_US;
+        sample->seq = seq;
+        pbdrv_imu_last_seq = seq;
+    }
+}
+
+PROCESS_THREAD(pbdrv_imu_process, ev, data) {
+    static struct etimer timer;
+    static uint16_t num_words;
+    static uint16_t pattern;
+    static uint16_t backlog;
+    static uint32_t now;
+
+    PROCESS_BEGIN();
+
+    pbdrv_imu_err = pbdrv_imu_init();
+    if (pbdrv_imu_err != PBIO_SUCCESS) {
+        pbdrv_imu_err = PBIO_ERROR_NO_DEV;
+        PROCESS_EXIT();
+    }
+
+    etimer_set(&timer, clock_from_msec(IMU_POLL_PERIOD_MS));
+
+    for (;;) {
+        PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_TIMER && etimer_expired(&timer));
+        etimer_reset(&timer);
+
+        do {
+            // Find out how much data is waiting and where in the pattern it starts
+            if (!pbdrv_imu_read_begin(LSM6DS3TR_C_FIFO_STATUS1, pbdrv_imu_fifo_status, 4)) {
+                break;
+            }
+            PROCESS_WAIT_UNTIL(pbdrv_imu_xfer_done);
+            if (pbdrv_imu_xfer_err) {
+                break;
+            }
+            now = clock_usecs();
+
+            num_words = pbdrv_imu_fifo_status[0] | (pbdrv_imu_fifo_status[1] & 0x07) << 8;
+            pattern = pbdrv_imu_fifo_status[2] | (pbdrv_imu_fifo_status[3] & 0x03) << 8;
+
+            if (num_words == 0) {
+                break;
+            }
+
+            if (num_words > IMU_MAX_READ_SAMPLES * IMU_WORDS_PER_SAMPLE) {
+                backlog = (num_words - IMU_MAX_READ_SAMPLES * IMU_WORDS_PER_SAMPLE) / IMU_WORDS_PER_SAMPLE;
+                num_words = IMU_MAX_READ_SAMPLES * IMU_WORDS_PER_SAMPLE;
+            } else {
+                backlog = 0;
+            }
+
+            // FIFO_DATA_OUT rolls over, so we can read many words at once
+            if (!pbdrv_imu_read_begin(LSM6DS3TR_C_FIFO_DATA_OUT_L, pbdrv_imu_fifo_data, num_words * 2)) {
+                break;
+            }
+            PROCESS_WAIT_UNTIL(pbdrv_imu_xfer_done);
+            if (pbdrv_imu_xfer_err) {
+                break;
+            }
+
+            pbdrv_imu_handle_fifo_data(num_words, pattern, backlog, now);
+        } while (backlog);
+    }
+
+    PROCESS_END();
+}
+
+#endif // PBDRV_CONFIG_IMU_LSM6DS3TR_C_STM32_HAL
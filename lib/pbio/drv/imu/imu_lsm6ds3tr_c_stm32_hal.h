@@ -0,0 +1,10 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#ifndef _PBDRV_IMU_LSM6DS3TR_C_STM32_HAL_H_
+#define _PBDRV_IMU_LSM6DS3TR_C_STM32_HAL_H_
+
+void pbdrv_imu_lsm6ds3tr_c_stm32_hal_handle_i2c_er_irq();
+void pbdrv_imu_lsm6ds3tr_c_stm32_hal_handle_i2c_ev_irq();
+
+#endif // _PBDRV_IMU_LSM6DS3TR_C_STM32_HAL_H_
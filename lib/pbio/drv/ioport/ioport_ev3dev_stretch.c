@@ -11,14 +11,23 @@
 #include <poll.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <contiki.h>
 #include <libudev.h>
 #include <uthash.h>
 
+#include <pbdrv/ioport.h>
 #include <pbio/error.h>
 #include <pbio/iodev.h>
 #include <pbio/port.h>
+#include <pbio/util.h>
+
+#include "ioport_ev3dev_stretch_index.h"
+
+// How often the udev monitor is checked for added and removed devices (ms)
+#define MONITOR_POLL_INTERVAL_MS (10)
 
 typedef struct {
     const char *name;
@@ -28,17 +37,75 @@ typedef struct {
 
 static ev3dev_port_t *ev3dev_ports;
 
-PROCESS(pbdrv_ioport_ev3dev_stretch_process, "ev3dev-stretch I/O port");
+static uint32_t device_index_generation;
 
-static void add_port(struct udev_device *device) {
-    ev3dev_port_t *new_port;
+// Devices that are counted in the index. Receiving is enabled before the
+// initial scan, so a device can be both found by the scan and reported by the
+// monitor. This makes sure that it is only counted once.
+typedef struct {
+    char *syspath;
+    pbdrv_ioport_ev3dev_index_device_t device;
+    UT_hash_handle hh;
+} ev3dev_indexed_device_t;
 
-    new_port = malloc(sizeof(*new_port));
-    new_port->name = udev_device_get_property_value(device, "LEGO_ADDRESS");
-    new_port->device = udev_device_ref(device);
-    HASH_ADD_STR(ev3dev_ports, name, new_port);
+static ev3dev_indexed_device_t *indexed_devices;
+
+// Adds or removes a device in the index
+static void update_index(struct udev_device *device, bool add) {
+    const char *syspath = udev_device_get_syspath(device);
+    if (!syspath) {
+        return;
+    }
+
+    ev3dev_indexed_device_t *indexed;
+    HASH_FIND_STR(indexed_devices, syspath, indexed);
+
+    if (!add) {
+        if (!indexed) {
+            return;
+        }
+        // The details are taken from when the device was added, since the
+        // attributes of a removed device can no longer be read.
+        pbdrv_ioport_ev3dev_index_remove(&indexed->device);
+        HASH_DEL(indexed_devices, indexed);
+        free(indexed->syspath);
+        free(indexed);
+        return;
+    }
+
+    // Already counted, such as by the initial scan
+    if (indexed) {
+        return;
+    }
+
+    // Sensors and motors have the same address as their port, or the port
+    // address followed by more details, like ev3-ports:in1:i2c1
+    const char *address = udev_device_get_property_value(device, "LEGO_ADDRESS");
+    if (!address) {
+        address = udev_device_get_sysattr_value(device, "address");
+    }
+    pbdrv_ioport_ev3dev_index_device_t details;
+    if (!pbdrv_ioport_ev3dev_index_parse(udev_device_get_subsystem(device), address, udev_device_get_sysnum(device), &details)) {
+        return;
+    }
+
+    indexed = malloc(sizeof(*indexed));
+    if (!indexed) {
+        return;
+    }
+    indexed->syspath = strdup(syspath);
+    if (!indexed->syspath) {
+        free(indexed);
+        return;
+    }
+    indexed->device = details;
+    HASH_ADD_STR(indexed_devices, syspath, indexed);
+
+    pbdrv_ioport_ev3dev_index_add(&indexed->device);
 }
 
+PROCESS(pbdrv_ioport_ev3dev_stretch_process, "ev3dev-stretch I/O port");
+
 static ev3dev_port_t *find_port(const char *name) {
     ev3dev_port_t *found_port;
 
@@ -46,6 +113,26 @@ static ev3dev_port_t *find_port(const char *name) {
     return found_port;
 }
 
+static void add_port(struct udev_device *device) {
+    ev3dev_port_t *new_port;
+    const char *name;
+
+    // Receiving is enabled before the initial scan, so the same port can be
+    // both found by the scan and reported by the monitor
+    name = udev_device_get_property_value(device, "LEGO_ADDRESS");
+    if (!name || find_port(name)) {
+        return;
+    }
+
+    new_port = malloc(sizeof(*new_port));
+    if (!new_port) {
+        return;
+    }
+    new_port->name = name;
+    new_port->device = udev_device_ref(device);
+    HASH_ADD_STR(ev3dev_ports, name, new_port);
+}
+
 static void remove_port(struct udev_device *device) {
     ev3dev_port_t *remove_port;
     const char *name;
@@ -108,6 +195,15 @@ pbio_error_t pbdrv_ioport_ev3dev_get_syspath(pbio_port_t port, const char **sysp
     return PBIO_SUCCESS;
 }
 
+/**
+ * Gets a number that changes each time that a device is added, removed or
+ * changed. Code that waits for a device can compare this to an earlier value
+ * to see if it is worth checking again.
+ */
+uint32_t pbdrv_ioport_ev3dev_get_generation(void) {
+    return device_index_generation;
+}
+
 PROCESS_THREAD(pbdrv_ioport_ev3dev_stretch_process, ev, data) {
     static struct udev *udev;
     static struct udev_monitor *monitor;
@@ -136,16 +232,21 @@ PROCESS_THREAD(pbdrv_ioport_ev3dev_stretch_process, ev, data) {
         PROCESS_EXIT();
     }
 
-    ret = udev_enumerate_add_match_subsystem(enumerate, "lego-port");
-    if (ret < 0) {
-        errno = -ret;
-        perror("udev_enumerate_add_match_subsystem failed");
-        PROCESS_EXIT();
+    for (size_t i = 0; i < PBDRV_IOPORT_EV3DEV_INDEX_NUM_SUBSYSTEMS; i++) {
+        ret = udev_enumerate_add_match_subsystem(enumerate, pbdrv_ioport_ev3dev_index_subsystems[i]);
+        if (ret < 0) {
+            errno = -ret;
+            perror("udev_enumerate_add_match_subsystem failed");
+            PROCESS_EXIT();
+        }
+        udev_monitor_filter_add_match_subsystem_devtype(monitor, pbdrv_ioport_ev3dev_index_subsystems[i], NULL);
     }
 
-    udev_monitor_filter_add_match_subsystem_devtype(monitor, "lego-port", NULL);
+    // Start receiving before scanning, so that no device is missed
     udev_monitor_enable_receiving(monitor);
 
+    pbdrv_ioport_ev3dev_index_reset();
+
     ret = udev_enumerate_scan_devices(enumerate);
     if (ret < 0) {
         errno = -ret;
@@ -164,12 +265,17 @@ PROCESS_THREAD(pbdrv_ioport_ev3dev_stretch_process, ev, data) {
             continue;
         }
 
-        add_port(device);
+        if (!strcmp(udev_device_get_subsystem(device), "lego-port")) {
+            add_port(device);
+        }
+        update_index(device, true);
         udev_device_unref(device);
     }
+    udev_enumerate_unref(enumerate);
+    pbdrv_ioport_ev3dev_index_set_ready();
 
-    // poll for added/removed devices every 100 milliseconds
-    etimer_set(&timer, clock_from_msec(100));
+    // poll for added/removed devices
+    etimer_set(&timer, clock_from_msec(MONITOR_POLL_INTERVAL_MS));
 
     while (true) {
         struct udev_device *device;
@@ -178,23 +284,28 @@ PROCESS_THREAD(pbdrv_ioport_ev3dev_stretch_process, ev, data) {
         PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_TIMER && etimer_expired(&timer));
         etimer_reset(&timer);
 
-        device = udev_monitor_receive_device(monitor);
-        if (!device) {
-            continue;
+        // Handle all events that arrived since the last poll. The monitor
+        // socket does not block, so this stops when there are no more.
+        while ((device = udev_monitor_receive_device(monitor))) {
+            action = udev_device_get_action(device);
+            if (action) {
+                bool is_port = !strcmp(udev_device_get_subsystem(device), "lego-port");
+                if (strcmp(action, "add") == 0) {
+                    if (is_port) {
+                        add_port(device);
+                    }
+                    update_index(device, true);
+                }
+                if (strcmp(action, "remove") == 0) {
+                    if (is_port) {
+                        remove_port(device);
+                    }
+                    update_index(device, false);
+                }
+                device_index_generation++;
+            }
+            udev_device_unref(device);
         }
-
-        action = udev_device_get_action(device);
-        if (!action) {
-            continue;
-        }
-
-        if (strcmp(action, "add") == 0) {
-            add_port(device);
-        }
-        if (strcmp(action, "remove") == 0) {
-            remove_port(device);
-        }
-        udev_device_unref(device);
     }
 
     PROCESS_END();
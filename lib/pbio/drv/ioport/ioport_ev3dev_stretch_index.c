@@ -0,0 +1,192 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+// ev3dev-stretch device numbers by port
+//
+// This keeps track of which sensor or motor number belongs to each port, so
+// that opening a device does not have to scan sysfs. The udev monitor in the
+// I/O port driver feeds it. It has no other dependencies, so it can be tested
+// on a host.
+
+#include <pbdrv/config.h>
+
+#if PBDRV_CONFIG_IOPORT_EV3DEV_STRETCH_INDEX
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pbdrv/ioport.h>
+#include <pbio/error.h>
+#include <pbio/port.h>
+
+#include "ioport_ev3dev_stretch_index.h"
+
+// Classes of devices that are indexed by the port they are attached to
+const char *const pbdrv_ioport_ev3dev_index_subsystems[PBDRV_IOPORT_EV3DEV_INDEX_NUM_SUBSYSTEMS] = {
+    "lego-port",
+    "lego-sensor",
+    "tacho-motor",
+    "dc-motor",
+};
+
+// Input ports 1 to 4 followed by output ports A to D
+#define NUM_INDEXED_PORTS (8)
+
+// Values in the device index that are not device numbers
+#define NUMBER_NONE (-1)
+#define NUMBER_UNKNOWN (-2)
+
+typedef struct {
+    // Number of the device in its class, or one of the values above
+    int number;
+    // Number of devices of this class on this port
+    uint8_t count;
+    // Whether the device with the number above is exactly at the port
+    bool exact;
+} ev3dev_index_entry_t;
+
+// Device numbers by subsystem and port, kept up to date by the udev monitor.
+// This is only used from the pbio event loop or while holding the GIL, so
+// there is no need for a lock.
+static ev3dev_index_entry_t device_index[PBDRV_IOPORT_EV3DEV_INDEX_NUM_SUBSYSTEMS][NUM_INDEXED_PORTS];
+static bool device_index_ready;
+
+static int get_subsystem_index(const char *subsystem) {
+    if (!subsystem) {
+        return -1;
+    }
+    for (int i = 0; i < PBDRV_IOPORT_EV3DEV_INDEX_NUM_SUBSYSTEMS; i++) {
+        if (!strcmp(subsystem, pbdrv_ioport_ev3dev_index_subsystems[i])) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int get_port_index(pbio_port_t port) {
+    if (port >= PBIO_PORT_1 && port <= PBIO_PORT_4) {
+        return port - PBIO_PORT_1;
+    }
+    if (port >= PBIO_PORT_A && port <= PBIO_PORT_D) {
+        return port - PBIO_PORT_A + 4;
+    }
+    return -1;
+}
+
+/**
+ * Empties the index. Numbers can't be looked up until the index is ready.
+ */
+void pbdrv_ioport_ev3dev_index_reset(void) {
+    for (int s = 0; s < PBDRV_IOPORT_EV3DEV_INDEX_NUM_SUBSYSTEMS; s++) {
+        for (int p = 0; p < NUM_INDEXED_PORTS; p++) {
+            device_index[s][p].number = NUMBER_NONE;
+            device_index[s][p].count = 0;
+            device_index[s][p].exact = false;
+        }
+    }
+    device_index_ready = false;
+}
+
+/**
+ * Marks the index as complete, once all present devices are added.
+ */
+void pbdrv_ioport_ev3dev_index_set_ready(void) {
+    device_index_ready = true;
+}
+
+/**
+ * Gets where a device goes in the index.
+ * @param [in]  subsystem   Device class, such as "lego-sensor"
+ * @param [in]  address     Device address, such as "ev3-ports:in1" or
+ *                          "ev3-ports:in1:i2c1" for a device behind a port
+ * @param [in]  sysnum      Number of the device in its class, such as "2"
+ * @param [out] device      Where the device goes in the index
+ * @return                  True if the device is indexed, false if not
+ */
+bool pbdrv_ioport_ev3dev_index_parse(const char *subsystem, const char *address, const char *sysnum, pbdrv_ioport_ev3dev_index_device_t *device) {
+    device->subsystem = get_subsystem_index(subsystem);
+    if (device->subsystem < 0 || !address || !sysnum) {
+        return false;
+    }
+
+    char port_char;
+    if (sscanf(address, "ev3-ports:%*[a-z]%c", &port_char) < 1) {
+        return false;
+    }
+    device->port = get_port_index(port_char);
+    if (device->port < 0) {
+        return false;
+    }
+
+    device->number = atoi(sysnum);
+    device->exact = !strchr(address + strlen("ev3-ports:"), ':');
+    return true;
+}
+
+/**
+ * Adds a device to the index. Each device must be added only once.
+ * @param [in]  device      Device from ::pbdrv_ioport_ev3dev_index_parse
+ */
+void pbdrv_ioport_ev3dev_index_add(const pbdrv_ioport_ev3dev_index_device_t *device) {
+    ev3dev_index_entry_t *entry = &device_index[device->subsystem][device->port];
+    entry->count++;
+    if (entry->count == 1 || device->exact) {
+        entry->number = device->number;
+        entry->exact = device->exact;
+    } else if (!entry->exact) {
+        // Several devices behind the same port, so let the caller search
+        entry->number = NUMBER_UNKNOWN;
+    }
+}
+
+/**
+ * Removes a device that was added to the index.
+ * @param [in]  device      Same details as when the device was added
+ */
+void pbdrv_ioport_ev3dev_index_remove(const pbdrv_ioport_ev3dev_index_device_t *device) {
+    ev3dev_index_entry_t *entry = &device_index[device->subsystem][device->port];
+    if (entry->count == 0) {
+        return;
+    }
+    entry->count--;
+    if (entry->count == 0) {
+        entry->number = NUMBER_NONE;
+        entry->exact = false;
+    } else if (entry->number == device->number) {
+        entry->number = NUMBER_UNKNOWN;
+        entry->exact = false;
+    }
+}
+
+/**
+ * Gets the number of the device of a class that is attached to a port,
+ * without scanning sysfs.
+ * @param [in]  port        The port
+ * @param [in]  subsystem   Device class, such as "lego-sensor"
+ * @param [out] number      The device number, such as 2 for sensor2
+ * @return                  ::PBIO_SUCCESS if found, ::PBIO_ERROR_NO_DEV if
+ *                          there is no such device on the port, or
+ *                          ::PBIO_ERROR_NOT_SUPPORTED if the index can't tell,
+ *                          in which case the caller should scan sysfs.
+ */
+pbio_error_t pbdrv_ioport_ev3dev_get_number(pbio_port_t port, const char *subsystem, int *number) {
+    int s = get_subsystem_index(subsystem);
+    int p = get_port_index(port);
+    if (!device_index_ready || s < 0 || p < 0) {
+        return PBIO_ERROR_NOT_SUPPORTED;
+    }
+
+    int found = device_index[s][p].number;
+    if (found == NUMBER_UNKNOWN) {
+        return PBIO_ERROR_NOT_SUPPORTED;
+    }
+    if (found == NUMBER_NONE) {
+        return PBIO_ERROR_NO_DEV;
+    }
+    *number = found;
+    return PBIO_SUCCESS;
+}
+
+#endif // PBDRV_CONFIG_IOPORT_EV3DEV_STRETCH_INDEX
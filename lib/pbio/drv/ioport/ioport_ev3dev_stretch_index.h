@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#ifndef _IOPORT_EV3DEV_STRETCH_INDEX_H_
+#define _IOPORT_EV3DEV_STRETCH_INDEX_H_
+
+#include <stdbool.h>
+
+#include <pbdrv/config.h>
+
+// Number of classes of devices that are indexed by port
+#define PBDRV_IOPORT_EV3DEV_INDEX_NUM_SUBSYSTEMS (4)
+
+// Where a device is in the index
+typedef struct {
+    // Index of the device class in pbdrv_ioport_ev3dev_index_subsystems
+    int subsystem;
+    // Index of the port that the device is attached to
+    int port;
+    // Number of the device in its class, such as 2 for sensor2
+    int number;
+    // Whether the address of the device is the port itself, rather than a
+    // device behind it, such as an I2C sensor
+    bool exact;
+} pbdrv_ioport_ev3dev_index_device_t;
+
+extern const char *const pbdrv_ioport_ev3dev_index_subsystems[PBDRV_IOPORT_EV3DEV_INDEX_NUM_SUBSYSTEMS];
+
+void pbdrv_ioport_ev3dev_index_reset(void);
+
+void pbdrv_ioport_ev3dev_index_set_ready(void);
+
+bool pbdrv_ioport_ev3dev_index_parse(const char *subsystem, const char *address, const char *sysnum, pbdrv_ioport_ev3dev_index_device_t *device);
+
+void pbdrv_ioport_ev3dev_index_add(const pbdrv_ioport_ev3dev_index_device_t *device);
+
+void pbdrv_ioport_ev3dev_index_remove(const pbdrv_ioport_ev3dev_index_device_t *device);
+
+#endif // _IOPORT_EV3DEV_STRETCH_INDEX_H_
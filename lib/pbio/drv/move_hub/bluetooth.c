@@ -73,9 +73,12 @@ static uint16_t pybricks_service_handle, pybricks_char_handle;
 
 // nRF UART GATT service handles
 static uint16_t uart_service_handle, uart_rx_char_handle, uart_tx_char_handle;
-// nRF UART tx is in progress
-static bool uart_tx_busy;
-// buffer to queue UART tx data
+// ring buffer to queue UART tx data, must be a power of 2!
+#define UART_TX_RING_BUF_SIZE 256
+static uint8_t uart_tx_ring_buf[UART_TX_RING_BUF_SIZE];
+static volatile uint16_t uart_tx_ring_buf_head;
+static uint16_t uart_tx_ring_buf_tail;
+// data for the characteristic notification currently being sent
 static uint8_t uart_tx_buf[NRF_CHAR_SIZE];
 // bytes used in uart_tx_buf
 static uint8_t uart_tx_buf_size;
@@ -612,30 +615,43 @@ static PT_THREAD(set_discoverable(struct pt *pt)) {
     PT_END(pt);
 }
 
-pbio_error_t pbdrv_bluetooth_tx(uint8_t c) {
+pbio_error_t pbdrv_bluetooth_tx_buf(const uint8_t *data, uint32_t size, uint32_t *written) {
     // make sure we have a Bluetooth connection
     if (!conn_handle) {
         return PBIO_ERROR_INVALID_OP;
     }
 
-    // can't add the the buffer if tx is in progress or buffer is full
-    if (uart_tx_busy || uart_tx_buf_size == NRF_CHAR_SIZE) {
+    uint16_t head = uart_tx_ring_buf_head;
+    uint16_t space = (uart_tx_ring_buf_tail - head - 1) & (UART_TX_RING_BUF_SIZE - 1);
+
+    if (space == 0) {
         return PBIO_ERROR_AGAIN;
     }
 
-    // append the char
-    uart_tx_buf[uart_tx_buf_size] = c;
-    uart_tx_buf_size++;
+    if (size > space) {
+        size = space;
+    }
 
-    // poke the process to start tx soon-ish. This way, we can accumulate up to
-    // NRF_CHAR_SIZE bytes before actually transmitting
-    // TODO: it probably would be better to poll here instead of using events
-    // so that we don't fill up the event queue with 20 events
-    process_post(&pbdrv_bluetooth_hci_process, PROCESS_EVENT_MSG, NULL);
+    for (uint32_t i = 0; i < size; i++) {
+        uart_tx_ring_buf[head] = data[i];
+        head = (head + 1) & (UART_TX_RING_BUF_SIZE - 1);
+    }
+    uart_tx_ring_buf_head = head;
+
+    *written = size;
+
+    // Polling instead of posting an event means that any number of writes
+    // before the process runs again only wake it up once.
+    process_poll(&pbdrv_bluetooth_hci_process);
 
     return PBIO_SUCCESS;
 }
 
+pbio_error_t pbdrv_bluetooth_tx(uint8_t c) {
+    uint32_t written;
+    return pbdrv_bluetooth_tx_buf(&c, 1, &written);
+}
+
 static PT_THREAD(uart_service_send_data(struct pt *pt))
 {
     tBleStatus ret;
@@ -697,14 +713,21 @@ PROCESS_THREAD(pbdrv_bluetooth_hci_process, ev, data) {
                 // just occasionally checking to see if we are still connected
                 continue;
             }
-            if (ev == PROCESS_EVENT_MSG && uart_tx_buf_size) {
-                uart_tx_busy = true;
-                PROCESS_PT_SPAWN(&child_pt, uart_service_send_data(&child_pt));
-                uart_tx_busy = false;
+            // send queued data as back-to-back notifications until the ring
+            // buffer is empty
+            while (conn_handle && uart_tx_ring_buf_head != uart_tx_ring_buf_tail) {
                 uart_tx_buf_size = 0;
+                while (uart_tx_buf_size < NRF_CHAR_SIZE && uart_tx_ring_buf_head != uart_tx_ring_buf_tail) {
+                    uart_tx_buf[uart_tx_buf_size++] = uart_tx_ring_buf[uart_tx_ring_buf_tail];
+                    uart_tx_ring_buf_tail = (uart_tx_ring_buf_tail + 1) & (UART_TX_RING_BUF_SIZE - 1);
+                }
+                PROCESS_PT_SPAWN(&child_pt, uart_service_send_data(&child_pt));
             }
         }
 
+        // drop anything that was not sent before disconnecting
+        uart_tx_ring_buf_tail = uart_tx_ring_buf_head;
+
         // reset Bluetooth chip
         GPIOB->BRR = GPIO_BRR_BR_6;
     }
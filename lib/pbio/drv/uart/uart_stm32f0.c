@@ -6,6 +6,11 @@
 // There are no hardware buffers on the UARTs, so we implement a ring buffer
 // to queue received data until it is read. No extra buffering is needed for
 // transmitting.
+//
+// If the platform provides a DMA channel for a UART, the ring buffer is filled
+// by circular DMA instead of one interrupt per byte. The idle line interrupt
+// and the DMA half/full transfer interrupts let us know when a chunk of data
+// is ready, which is typically once per LUMP message.
 
 #include "pbdrv/config.h"
 
@@ -44,6 +49,8 @@ typedef struct {
     struct etimer tx_timer;
     volatile pbio_error_t rx_result;
     volatile pbio_error_t tx_result;
+    DMA_Channel_TypeDef *rx_dma;
+    uint8_t rx_dma_ch;
     uint8_t irq;
     bool initalized;
 } pbdrv_uart_t;
@@ -181,8 +188,14 @@ pbio_error_t pbdrv_uart_set_baud_rate(pbdrv_uart_dev_t *uart_dev, uint32_t baud)
 void pbdrv_uart_stm32f0_handle_irq(uint8_t id) {
     pbdrv_uart_t *uart = &pbdrv_uart[id];
 
+    // line went idle after receiving data, so DMA has a chunk for us
+    if (uart->USART->CR1 & USART_CR1_IDLEIE && uart->USART->ISR & USART_ISR_IDLE) {
+        uart->USART->ICR = USART_ICR_IDLECF;
+        process_poll(&pbdrv_uart_process);
+    }
+
     // receive next byte
-    if (uart->USART->ISR & USART_ISR_RXNE) {
+    if (uart->USART->CR1 & USART_CR1_RXNEIE && uart->USART->ISR & USART_ISR_RXNE) {
         // REVISIT: Do we need to have an overrun error when the ring buffer gets full?
         uart->rx_ring_buf[uart->rx_ring_buf_head] = uart->USART->RDR;
         uart->rx_ring_buf_head = (uart->rx_ring_buf_head + 1) & (UART_RING_BUF_SIZE - 1);
@@ -207,10 +220,28 @@ void pbdrv_uart_stm32f0_handle_irq(uint8_t id) {
     }
 }
 
+void pbdrv_uart_stm32f0_handle_dma_irq(uint8_t id) {
+    pbdrv_uart_t *uart = &pbdrv_uart[id];
+    uint8_t shift = 4 * (uart->rx_dma_ch - 1);
+
+    // ring buffer is half full or wrapped around
+    if (DMA1->ISR & ((DMA_ISR_HTIF1 | DMA_ISR_TCIF1) << shift)) {
+        DMA1->IFCR = DMA_IFCR_CGIF1 << shift;
+        process_poll(&pbdrv_uart_process);
+    }
+}
+
 static void handle_poll() {
     for (int i = 0; i < PBDRV_CONFIG_UART_STM32F0_NUM_UART; i++) {
         pbdrv_uart_t *uart = &pbdrv_uart[i];
 
+        if (uart->rx_dma) {
+            // DMA counts down from the buffer size, wrapping around when it
+            // reaches 0, so this gives the index of the next byte it will write.
+            // The count can briefly read 0 right at the wraparound.
+            uart->rx_ring_buf_head = (UART_RING_BUF_SIZE - uart->rx_dma->CNDTR) & (UART_RING_BUF_SIZE - 1);
+        }
+
         // if receive is pending and we have not received all bytes yet...
         if (uart->rx_buf && uart->rx_result == PBIO_ERROR_AGAIN && uart->rx_buf_index < uart->rx_buf_size) {
             // copy all available bytes to rx_buf
@@ -237,6 +268,9 @@ static void handle_exit() {
     for (int i = 0; i < PBDRV_CONFIG_UART_STM32F0_NUM_UART; i++) {
         pbdrv_uart_t *uart = &pbdrv_uart[i];
         NVIC_DisableIRQ(uart->irq);
+        if (uart->rx_dma) {
+            uart->rx_dma->CCR &= ~DMA_CCR_EN;
+        }
     }
 }
 
@@ -252,9 +286,30 @@ PROCESS_THREAD(pbdrv_uart_process, ev, data) {
 
         uart->USART = pdata->uart,
         uart->irq = pdata->irq,
+        uart->rx_dma = pdata->rx_dma;
+        uart->rx_dma_ch = pdata->rx_dma_ch;
 
         uart->USART->CR3 |= USART_CR3_OVRDIS;
-        uart->USART->CR1 |= USART_CR1_RXNEIE | USART_CR1_TE | USART_CR1_RE | USART_CR1_UE;
+
+        if (uart->rx_dma) {
+            RCC->AHBENR |= RCC_AHBENR_DMAEN;
+
+            // peripheral to memory, 8-bit, circular, irq on half/full transfer
+            uart->rx_dma->CCR = 0;
+            uart->rx_dma->CPAR = (uint32_t)&uart->USART->RDR;
+            uart->rx_dma->CMAR = (uint32_t)uart->rx_ring_buf;
+            uart->rx_dma->CNDTR = UART_RING_BUF_SIZE;
+            uart->rx_dma->CCR = DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_HTIE | DMA_CCR_TCIE | DMA_CCR_EN;
+
+            NVIC_SetPriority(pdata->rx_dma_irq, 0);
+            NVIC_EnableIRQ(pdata->rx_dma_irq);
+
+            uart->USART->CR3 |= USART_CR3_DMAR;
+            uart->USART->CR1 |= USART_CR1_IDLEIE | USART_CR1_TE | USART_CR1_RE | USART_CR1_UE;
+        } else {
+            uart->USART->CR1 |= USART_CR1_RXNEIE | USART_CR1_TE | USART_CR1_RE | USART_CR1_UE;
+        }
+
         NVIC_SetPriority(uart->irq, 0);
         NVIC_EnableIRQ(uart->irq);
 
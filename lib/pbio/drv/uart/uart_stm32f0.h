@@ -11,10 +11,17 @@
 typedef struct {
     USART_TypeDef *uart;
     uint8_t irq;
+    /** DMA channel used for receiving or NULL to use RXNE interrupts instead */
+    DMA_Channel_TypeDef *rx_dma;
+    /** DMA1 channel number (1 to 5) of *rx_dma* */
+    uint8_t rx_dma_ch;
+    /** Interrupt shared by *rx_dma* */
+    uint8_t rx_dma_irq;
 } pbdrv_uart_stm32f0_platform_data_t;
 
 extern const pbdrv_uart_stm32f0_platform_data_t pbdrv_uart_stm32f0_platform_data[PBDRV_CONFIG_UART_STM32F0_NUM_UART];
 
 void pbdrv_uart_stm32f0_handle_irq(uint8_t id);
+void pbdrv_uart_stm32f0_handle_dma_irq(uint8_t id);
 
 #endif // _UART_STM32F0_H_
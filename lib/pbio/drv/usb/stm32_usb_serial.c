@@ -9,6 +9,7 @@
 
 #include <pbio/error.h>
 #include <pbio/util.h>
+#include <pbsys/sys.h>
 
 #include <contiki.h>
 #include <contiki-lib.h>
@@ -214,6 +215,25 @@ pbio_error_t pbsys_stdout_put_char(uint8_t c) {
     return PBIO_SUCCESS;
 }
 
+pbio_error_t pbsys_stdout_write(const uint8_t *data, uint32_t size, uint32_t *written) {
+    uint32_t i;
+
+    for (i = 0; i < size; i++) {
+        if (ringbuf_put(&stdout_buf, data[i]) == 0) {
+            break;
+        }
+    }
+
+    *written = i;
+
+    return i ? PBIO_SUCCESS : PBIO_ERROR_AGAIN;
+}
+
+void pbsys_stdout_flush(void) {
+    // send now instead of waiting for the next timer tick
+    process_poll(&pbdrv_usb_process);
+}
+
 pbio_error_t pbsys_stdin_get_char(uint8_t *c) {
     if (ringbuf_elements(&stdin_buf) == 0) {
         return PBIO_ERROR_AGAIN;
@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#include <pbdrv/config.h>
+
+#if PBDRV_CONFIG_MOTOR
+
+#include <stdbool.h>
+
+#include <contiki.h>
+
+#include <pbdrv/motor.h>
+#include <pbio/config.h>
+
+#include "motor_virtual.h"
+
+#define NUM_MOTOR (PBDRV_CONFIG_LAST_MOTOR_PORT - PBDRV_CONFIG_FIRST_MOTOR_PORT + 1)
+
+static pbdrv_motor_sim_t motor_sim[NUM_MOTOR];
+
+/**
+ * Gets the simulation behind a virtual motor, so that its parameters and load
+ * can be changed.
+ * @param [in]  port    The motor port
+ * @param [out] sim     The simulated motor
+ * @return              ::PBIO_SUCCESS if the call was successful,
+ *                      ::PBIO_ERROR_INVALID_PORT if port is not a valid port
+ */
+pbio_error_t pbdrv_motor_virtual_get_sim(pbio_port_t port, pbdrv_motor_sim_t **sim) {
+    if (port < PBDRV_CONFIG_FIRST_MOTOR_PORT || port > PBDRV_CONFIG_LAST_MOTOR_PORT) {
+        return PBIO_ERROR_INVALID_PORT;
+    }
+    *sim = &motor_sim[port - PBDRV_CONFIG_FIRST_MOTOR_PORT];
+    return PBIO_SUCCESS;
+}
+
+void _pbdrv_motor_init(void) {
+    for (int i = 0; i < NUM_MOTOR; i++) {
+        pbdrv_motor_sim_reset(&motor_sim[i], clock_usecs());
+    }
+}
+
+#if PBIO_CONFIG_ENABLE_DEINIT
+void _pbdrv_motor_deinit(void) {
+}
+#endif
+
+pbio_error_t pbdrv_motor_coast(pbio_port_t port) {
+    pbdrv_motor_sim_t *sim;
+    pbio_error_t err = pbdrv_motor_virtual_get_sim(port, &sim);
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+    pbdrv_motor_sim_coast(sim, clock_usecs());
+    return PBIO_SUCCESS;
+}
+
+pbio_error_t pbdrv_motor_set_duty_cycle(pbio_port_t port, int16_t duty_cycle) {
+    pbdrv_motor_sim_t *sim;
+    pbio_error_t err = pbdrv_motor_virtual_get_sim(port, &sim);
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+    if (duty_cycle < -PBDRV_MAX_DUTY || duty_cycle > PBDRV_MAX_DUTY) {
+        return PBIO_ERROR_INVALID_ARG;
+    }
+    pbdrv_motor_sim_set_duty_cycle(sim, clock_usecs(), duty_cycle);
+    return PBIO_SUCCESS;
+}
+
+pbio_error_t pbdrv_motor_get_id(pbio_port_t port, pbio_iodev_type_id_t *id) {
+    if (port < PBDRV_CONFIG_FIRST_MOTOR_PORT || port > PBDRV_CONFIG_LAST_MOTOR_PORT) {
+        return PBIO_ERROR_INVALID_PORT;
+    }
+    // The default simulation parameters are those of this motor
+    *id = PBIO_IODEV_TYPE_ID_EV3_LARGE_MOTOR;
+    return PBIO_SUCCESS;
+}
+
+pbio_error_t pbdrv_motor_setup(pbio_port_t port, bool is_servo) {
+    if (port < PBDRV_CONFIG_FIRST_MOTOR_PORT || port > PBDRV_CONFIG_LAST_MOTOR_PORT) {
+        return PBIO_ERROR_INVALID_PORT;
+    }
+    return PBIO_SUCCESS;
+}
+
+#endif // PBDRV_CONFIG_MOTOR
@@ -0,0 +1,144 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#include <pbdrv/config.h>
+
+#if PBDRV_CONFIG_MOTOR_SIM
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <pbdrv/motor.h>
+
+#include "motor_sim.h"
+
+#define SIM_PI (3.14159265358979323846)
+
+// Default parameters resemble an EV3 Large Motor without load, with a stall
+// torque of about 0.4 Nm and a no-load speed of about 170 RPM at 9V.
+static const pbdrv_motor_sim_t sim_default = {
+    .k = 0.49,
+    .resistance = 11.0,
+    .inertia = 0.0011,
+    .friction_viscous = 0.0005,
+    .friction_coulomb = 0.02,
+    .voltage_max = 9.0,
+    .coasting = true,
+};
+
+void pbdrv_motor_sim_reset(pbdrv_motor_sim_t *sim, uint32_t time_now) {
+    *sim = sim_default;
+    sim->time = time_now;
+}
+
+static double sim_sign(double value) {
+    return value > 0 ? 1.0 : (value < 0 ? -1.0 : 0.0);
+}
+
+static double sim_abs(double value) {
+    return value < 0 ? -value : value;
+}
+
+// Advances the simulation by one integration step of dt seconds
+static void sim_integrate(pbdrv_motor_sim_t *sim, double dt) {
+
+    // The electrical time constant is much shorter than the step, so the
+    // current follows the voltage directly. Braking shorts the winding, which
+    // is the same as applying zero volts. Coasting disconnects it.
+    if (sim->coasting) {
+        sim->current = 0;
+    } else {
+        double voltage = sim->voltage_max * sim->duty_cycle / PBDRV_MAX_DUTY;
+        sim->current = (voltage - sim->k * sim->speed) / sim->resistance;
+    }
+
+    double torque = sim->k * sim->current - sim->load - sim->friction_viscous * sim->speed;
+
+    // Coulomb friction holds the shaft still until the torque overcomes it,
+    // and it never makes the shaft reverse by itself.
+    if (sim->speed == 0) {
+        if (sim_abs(torque) <= sim->friction_coulomb) {
+            torque = 0;
+        } else {
+            torque -= sim_sign(torque) * sim->friction_coulomb;
+        }
+        sim->speed = torque / sim->inertia * dt;
+    } else {
+        double speed_prev = sim->speed;
+        torque -= sim_sign(speed_prev) * sim->friction_coulomb;
+        sim->speed += torque / sim->inertia * dt;
+        if (sim_sign(sim->speed) != sim_sign(speed_prev)) {
+            sim->speed = 0;
+        }
+    }
+
+    sim->angle += sim->speed * dt;
+
+    // End stops absorb all momentum
+    if (sim->has_limits) {
+        if (sim->angle > sim->angle_max) {
+            sim->angle = sim->angle_max;
+            if (sim->speed > 0) {
+                sim->speed = 0;
+            }
+        }
+        if (sim->angle < sim->angle_min) {
+            sim->angle = sim->angle_min;
+            if (sim->speed < 0) {
+                sim->speed = 0;
+            }
+        }
+    }
+}
+
+/**
+ * Computes the state of the motor up to the given time, using the actuation
+ * that was set most recently.
+ * @param [in]  sim         The simulated motor
+ * @param [in]  time_now    Current time (us)
+ */
+void pbdrv_motor_sim_step(pbdrv_motor_sim_t *sim, uint32_t time_now) {
+    while ((int32_t)(time_now - sim->time) >= PBDRV_MOTOR_SIM_STEP_US) {
+        sim_integrate(sim, PBDRV_MOTOR_SIM_STEP_US / 1000000.0);
+        sim->time += PBDRV_MOTOR_SIM_STEP_US;
+    }
+}
+
+void pbdrv_motor_sim_coast(pbdrv_motor_sim_t *sim, uint32_t time_now) {
+    pbdrv_motor_sim_step(sim, time_now);
+    sim->coasting = true;
+    sim->duty_cycle = 0;
+}
+
+void pbdrv_motor_sim_set_duty_cycle(pbdrv_motor_sim_t *sim, uint32_t time_now, int16_t duty_cycle) {
+    pbdrv_motor_sim_step(sim, time_now);
+    sim->coasting = false;
+    sim->duty_cycle = duty_cycle;
+}
+
+/**
+ * Gets the encoder count of the simulated motor.
+ * @param [in]  sim         The simulated motor
+ * @param [in]  time_now    Current time (us)
+ * @return                  Count in encoder counts
+ */
+int32_t pbdrv_motor_sim_get_count(pbdrv_motor_sim_t *sim, uint32_t time_now) {
+    pbdrv_motor_sim_step(sim, time_now);
+    double count = sim->angle * 180 / SIM_PI * PBDRV_CONFIG_COUNTER_COUNTS_PER_DEGREE;
+    // Like a real encoder, the count only changes after a full count
+    int32_t whole = (int32_t)count;
+    return count < whole ? whole - 1 : whole;
+}
+
+/**
+ * Gets the rotational speed of the simulated motor.
+ * @param [in]  sim         The simulated motor
+ * @param [in]  time_now    Current time (us)
+ * @return                  Speed in encoder counts per second
+ */
+int32_t pbdrv_motor_sim_get_rate(pbdrv_motor_sim_t *sim, uint32_t time_now) {
+    pbdrv_motor_sim_step(sim, time_now);
+    return (int32_t)(sim->speed * 180 / SIM_PI * PBDRV_CONFIG_COUNTER_COUNTS_PER_DEGREE);
+}
+
+#endif // PBDRV_CONFIG_MOTOR_SIM
@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+// Simulation of a geared DC motor with a load, for running the servo stack
+// on a host computer.
+
+#ifndef _PBDRV_VIRTUAL_MOTOR_SIM_H_
+#define _PBDRV_VIRTUAL_MOTOR_SIM_H_
+
+#include <pbdrv/config.h>
+
+#if PBDRV_CONFIG_MOTOR_SIM
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Integration step of the simulation (us)
+#define PBDRV_MOTOR_SIM_STEP_US (100)
+
+typedef struct _pbdrv_motor_sim_t {
+    // Parameters, all referred to the output shaft of the gearbox
+    double k; // Torque constant (Nm/A), which equals the back EMF constant (Vs/rad)
+    double resistance; // Winding resistance (Ohm)
+    double inertia; // Inertia of the motor and its load (kg m^2)
+    double friction_viscous; // Viscous friction (Nm s/rad)
+    double friction_coulomb; // Coulomb friction (Nm)
+    double voltage_max; // Supply voltage at 100% duty cycle (V)
+    double load; // External load torque, positive opposes forward motion (Nm)
+    bool has_limits; // Whether the angle limits below are mechanical end stops
+    double angle_min; // Lower end stop (rad)
+    double angle_max; // Upper end stop (rad)
+    // State
+    bool coasting; // Whether the winding is disconnected
+    int16_t duty_cycle; // Applied duty cycle, -10000 to 10000
+    double angle; // Output shaft angle (rad)
+    double speed; // Output shaft speed (rad/s)
+    double current; // Winding current (A)
+    uint32_t time; // Time up to which the state has been computed (us)
+} pbdrv_motor_sim_t;
+
+void pbdrv_motor_sim_reset(pbdrv_motor_sim_t *sim, uint32_t time_now);
+
+void pbdrv_motor_sim_step(pbdrv_motor_sim_t *sim, uint32_t time_now);
+
+void pbdrv_motor_sim_coast(pbdrv_motor_sim_t *sim, uint32_t time_now);
+
+void pbdrv_motor_sim_set_duty_cycle(pbdrv_motor_sim_t *sim, uint32_t time_now, int16_t duty_cycle);
+
+int32_t pbdrv_motor_sim_get_count(pbdrv_motor_sim_t *sim, uint32_t time_now);
+
+int32_t pbdrv_motor_sim_get_rate(pbdrv_motor_sim_t *sim, uint32_t time_now);
+
+#endif // PBDRV_CONFIG_MOTOR_SIM
+
+#endif // _PBDRV_VIRTUAL_MOTOR_SIM_H_
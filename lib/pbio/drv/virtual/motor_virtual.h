@@ -0,0 +1,25 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#ifndef _PBDRV_VIRTUAL_MOTOR_VIRTUAL_H_
+#define _PBDRV_VIRTUAL_MOTOR_VIRTUAL_H_
+
+#include <pbdrv/config.h>
+
+#if PBDRV_CONFIG_MOTOR_VIRTUAL
+
+#include <pbio/error.h>
+#include <pbio/port.h>
+
+#include "motor_sim.h"
+
+#if !PBDRV_CONFIG_MOTOR_SIM
+#error Virtual motors require PBDRV_CONFIG_MOTOR_SIM
+#endif
+
+// defined in motor.c
+pbio_error_t pbdrv_motor_virtual_get_sim(pbio_port_t port, pbdrv_motor_sim_t **sim);
+
+#endif // PBDRV_CONFIG_MOTOR_VIRTUAL
+
+#endif // _PBDRV_VIRTUAL_MOTOR_VIRTUAL_H_
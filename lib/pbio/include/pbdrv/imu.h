@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+/**
+ * \addtogroup IMUDriver Inertial measurement unit driver
+ * @{
+ */
+
+#ifndef _PBDRV_IMU_H_
+#define _PBDRV_IMU_H_
+
+#include <stdint.h>
+
+#include <pbdrv/config.h>
+#include <pbio/error.h>
+
+/**
+ * One sample from the inertial measurement unit.
+ */
+typedef struct {
+    /**
+     * Angular velocity around the x, y and z axes in millidegrees per second.
+     */
+    int32_t gyro[3];
+    /**
+     * Acceleration along the x, y and z axes in mm/s^2.
+     */
+    int32_t accel[3];
+    /**
+     * Time at which the sample was taken in microseconds (same time base as
+     * clock_usecs()).
+     */
+    uint32_t timestamp;
+    /**
+     * Sequence number of the sample, incremented for each new sample.
+     */
+    uint32_t seq;
+} pbdrv_imu_sample_t;
+
+#if PBDRV_CONFIG_IMU
+
+/**
+ * Gets the most recent sample.
+ * @param [out] sample  The sample
+ * @return              ::PBIO_SUCCESS on success, ::PBIO_ERROR_AGAIN if no
+ *                      sample has been received yet or ::PBIO_ERROR_NO_DEV if
+ *                      the IMU could not be initialized.
+ */
+pbio_error_t pbdrv_imu_get_sample(pbdrv_imu_sample_t *sample);
+
+/**
+ * Gets the samples that were received after a given sample, oldest first.
+ *
+ * The driver keeps a limited history. If the caller falls behind, the oldest
+ * samples are skipped, which can be detected by a gap in the sequence numbers.
+ *
+ * @param [in, out] seq     Sequence number of the last sample already seen
+ *                          by the caller. Updated to the last sample returned.
+ * @param [out] samples     Array to hold the samples
+ * @param [in, out] count   The size of *samples*. Updated to the number of
+ *                          samples returned.
+ * @return                  ::PBIO_SUCCESS on success or ::PBIO_ERROR_NO_DEV if
+ *                          the IMU could not be initialized.
+ */
+pbio_error_t pbdrv_imu_read_samples(uint32_t *seq, pbdrv_imu_sample_t *samples, uint32_t *count);
+
+#else // PBDRV_CONFIG_IMU
+
+static inline pbio_error_t pbdrv_imu_get_sample(pbdrv_imu_sample_t *sample) {
+    return PBIO_ERROR_NOT_SUPPORTED;
+}
+static inline pbio_error_t pbdrv_imu_read_samples(uint32_t *seq, pbdrv_imu_sample_t *samples, uint32_t *count) {
+    *count = 0;
+    return PBIO_ERROR_NOT_SUPPORTED;
+}
+
+#endif // PBDRV_CONFIG_IMU
+
+#endif // _PBDRV_IMU_H_
+
+/** @} */
@@ -10,6 +10,7 @@
 #define _PBDRV_IOPORT_H_
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include <pbdrv/config.h>
 #include <pbio/error.h>
@@ -29,6 +30,20 @@ static inline pbio_error_t pbdrv_ioport_get_iodev(pbio_port_t port, pbio_iodev_t
 
 #endif // PBDRV_CONFIG_IOPORT
 
+#if PBDRV_CONFIG_IOPORT_EV3DEV_STRETCH
+
+pbio_error_t pbdrv_ioport_ev3dev_get_syspath(pbio_port_t port, const char **syspath);
+
+uint32_t pbdrv_ioport_ev3dev_get_generation(void);
+
+#endif // PBDRV_CONFIG_IOPORT_EV3DEV_STRETCH
+
+#if PBDRV_CONFIG_IOPORT_EV3DEV_STRETCH_INDEX
+
+pbio_error_t pbdrv_ioport_ev3dev_get_number(pbio_port_t port, const char *subsystem, int *number);
+
+#endif // PBDRV_CONFIG_IOPORT_EV3DEV_STRETCH_INDEX
+
 #endif // _PBDRV_IOPORT_H_
 
 /** @}*/
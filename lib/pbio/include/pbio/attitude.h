@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+/**
+ * \addtogroup Attitude Attitude and heading estimation
+ *
+ * Estimates tilt (pitch and roll) and heading from gyro and accelerometer
+ * samples using a fixed-point complementary filter. The gyro bias is
+ * re-estimated whenever the hub is held still for a while. The first estimate
+ * is made shortly after startup, so the hub should not be moved until then.
+ *
+ * Angles are in millidegrees and angular velocities are in millidegrees per
+ * second. Heading is not wrapped, so it keeps counting over multiple turns.
+ * @{
+ */
+
+#ifndef _PBIO_ATTITUDE_H_
+#define _PBIO_ATTITUDE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <pbdrv/imu.h>
+
+#include <pbio/config.h>
+#include <pbio/error.h>
+
+typedef struct _pbio_attitude_t {
+    bool initialized; // Whether the first sample has been processed
+    uint32_t time_prev; // Timestamp of the previous sample (us)
+    int64_t roll; // Rotation about the x-axis (ndeg)
+    int64_t pitch; // Rotation about the y-axis (ndeg)
+    int64_t heading; // Rotation about the vertical axis (ndeg)
+    int32_t heading_rate; // Rate of change of heading (mdps)
+    int32_t rate[3]; // Bias-corrected angular velocity in the hub frame (mdps)
+    int32_t bias[3]; // Gyro bias estimate (mdps)
+    bool bias_valid; // Whether the bias has been estimated at least once
+    uint32_t still_count; // Number of samples for which the hub has been still
+    int32_t still_ref[3]; // Gyro value at the start of the still period (mdps)
+    int32_t still_sum[3]; // Sum of gyro values during the still period (mdps)
+} pbio_attitude_t;
+
+#if PBIO_CONFIG_ATTITUDE
+
+void pbio_attitude_reset(pbio_attitude_t *att);
+
+void pbio_attitude_update(pbio_attitude_t *att, const pbdrv_imu_sample_t *sample);
+
+void pbio_attitude_get_tilt(pbio_attitude_t *att, int32_t *pitch, int32_t *roll);
+
+void pbio_attitude_get_heading(pbio_attitude_t *att, int32_t *heading, int32_t *heading_rate);
+
+void pbio_attitude_get_angular_velocity(pbio_attitude_t *att, int32_t *rate);
+
+void pbio_attitude_reset_heading(pbio_attitude_t *att, int32_t heading);
+
+/**
+ * Gets the attitude estimate that is fed by the hub IMU in the background.
+ * @param [out] att     The attitude estimate
+ * @return              ::PBIO_SUCCESS on success, ::PBIO_ERROR_AGAIN if no IMU
+ *                      sample has been processed yet or another error if the
+ *                      IMU is not available.
+ */
+pbio_error_t pbio_attitude_get(pbio_attitude_t **att);
+
+void _pbio_attitude_poll(void);
+
+#else // PBIO_CONFIG_ATTITUDE
+
+static inline pbio_error_t pbio_attitude_get(pbio_attitude_t **att) {
+    *att = NULL;
+    return PBIO_ERROR_NOT_SUPPORTED;
+}
+
+static inline void _pbio_attitude_poll(void) {
+}
+
+#endif // PBIO_CONFIG_ATTITUDE
+
+#endif // _PBIO_ATTITUDE_H_
+
+/** @} */
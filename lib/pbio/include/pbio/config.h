@@ -7,6 +7,10 @@
 // This file should be defined by applications that use the PBIO library.
 #include "pbioconfig.h"
 
+#ifndef PBIO_CONFIG_ATTITUDE
+#define PBIO_CONFIG_ATTITUDE (0)
+#endif
+
 #ifndef PBIO_CONFIG_ENABLE_SYS
 #define PBIO_CONFIG_ENABLE_SYS (0)
 #endif
@@ -59,6 +59,14 @@ pbio_control_on_target_t pbio_control_on_target_angle;
 pbio_control_on_target_t pbio_control_on_target_time;
 pbio_control_on_target_t pbio_control_on_target_stalled;
 
+/**
+ * Events emitted by the controller when the state of a maneuver changes.
+ */
+typedef enum {
+    PBIO_CONTROL_EVENT_DONE = 1 << 0,    /**< The maneuver reached its target or was stopped */
+    PBIO_CONTROL_EVENT_STALLED = 1 << 1, /**< The controller became stalled */
+} pbio_control_event_t;
+
 typedef enum {
     PBIO_CONTROL_NONE,   /**< No control */
     PBIO_CONTROL_TIMED,  /**< Run for a given amount of time */
@@ -75,6 +83,7 @@ typedef struct _pbio_control_t {
     pbio_control_on_target_t on_target_func;
     bool stalled;
     bool on_target;
+    uint8_t events;            /**< ::pbio_control_event_t flags emitted since they were last taken */
 } pbio_control_t;
 
 // Convert control units (counts, rate) and physical user units (deg or mm, deg/s or mm/s)
@@ -105,6 +114,7 @@ pbio_error_t pbio_control_start_hold_control(pbio_control_t *ctl, int32_t time_n
 
 bool pbio_control_is_stalled(pbio_control_t *ctl);
 bool pbio_control_is_done(pbio_control_t *ctl);
+uint8_t pbio_control_take_events(pbio_control_t *ctl);
 
 void control_update(pbio_control_t *ctl, int32_t time_now, int32_t count_now, int32_t rate_now, pbio_actuation_t *actuation_type, int32_t *control);
 
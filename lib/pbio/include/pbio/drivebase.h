@@ -4,15 +4,74 @@
 #ifndef _PBIO_DRIVEBASE_H_
 #define _PBIO_DRIVEBASE_H_
 
+#include <pbio/reflex.h>
 #include <pbio/servo.h>
 
+pbio_error_t pbio_drivebase_adopt_settings(pbio_control_settings_t *s_distance, pbio_control_settings_t *s_heading, const pbio_control_settings_t *s_left, const pbio_control_settings_t *s_right);
+
 #if PBDRV_CONFIG_NUM_MOTOR_CONTROLLER != 0
 
+/**
+ * Reads the heading of a drivebase from an external sensor such as a gyro.
+ * @param [in] context      Context given to pbio_drivebase_set_heading_source()
+ * @param [out] heading     Heading in millidegrees, clockwise positive
+ * @param [out] heading_rate Rate of change of heading in millidegrees per second
+ * @return                  ::PBIO_SUCCESS or an error if the sensor could not
+ *                          be read.
+ */
+typedef pbio_error_t (*pbio_drivebase_heading_func_t)(void *context, int32_t *heading, int32_t *heading_rate);
+
+/** Maximum number of segments in a path given to pbio_drivebase_follow_path() */
+#define PBIO_DRIVEBASE_PATH_MAX_SEGMENTS (16)
+
+/**
+ * Path segment. The drivebase travels the given distance while its heading
+ * changes by the given angle, so a zero angle is a straight line and any
+ * other angle is a circular arc.
+ */
+typedef struct _pbio_drivebase_path_segment_t {
+    int32_t distance; // Length of the segment (mm)
+    int32_t angle; // Change of heading along the segment (deg, clockwise)
+} pbio_drivebase_path_segment_t;
+
+// Start of a path segment, in odometry coordinates
+typedef struct _pbio_drivebase_path_node_t {
+    int32_t x; // Forward position (um)
+    int32_t y; // Position to the right (um)
+    int32_t theta; // Heading (mdeg)
+    int32_t start; // Path length up to this node (um)
+    int32_t length; // Length of the segment that starts here (um)
+    int32_t angle; // Change of heading along the segment (mdeg)
+} pbio_drivebase_path_node_t;
+
+typedef struct _pbio_drivebase_path_t {
+    bool active; // Whether the drivebase is following this path
+    uint8_t num_segments;
+    int32_t sum_start; // Sum of counts at the start of the path
+    int32_t speed; // Cruise speed (mm/s)
+    int32_t acceleration; // Acceleration and deceleration (mm/s^2)
+    // Segment starts, followed by the end of the path
+    pbio_drivebase_path_node_t nodes[PBIO_DRIVEBASE_PATH_MAX_SEGMENTS + 1];
+} pbio_drivebase_path_t;
+
 typedef struct _pbio_drivebase_t {
     pbio_servo_t *left;
     pbio_servo_t *right;
     int32_t sum_offset;
     int32_t dif_offset;
+    pbio_drivebase_heading_func_t heading_func;
+    void *heading_context;
+    int32_t heading_offset;
+    bool pose_valid; // Whether the previous counts below have been set
+    int32_t pose_sum_prev; // Sum of counts at the previous pose update
+    int32_t pose_dif_offset; // Difference of counts at zero pose angle
+    int32_t pose_theta_prev; // Pose angle at the previous update (mdeg)
+    int32_t pose_x; // Forward position relative to initial pose (um)
+    int32_t pose_y; // Position to the right of the initial pose (um)
+    pbio_drivebase_path_t path;
+    bool reflex_active; // Whether the reflex below steers the drivebase
+    int32_t reflex_speed; // Drive speed while the reflex steers (mm/s)
+    pbio_reflex_t reflex; // Sets the turn rate (deg/s)
     pbio_log_t log;
     pbio_control_t control_heading;
     pbio_control_t control_distance;
@@ -36,12 +95,31 @@ pbio_error_t pbio_drivebase_stop(pbio_drivebase_t *db, pbio_actuation_t after_st
 
 pbio_error_t pbio_drivebase_stop_force(pbio_drivebase_t *db);
 
+// Path following
+
+pbio_error_t pbio_drivebase_follow_path(pbio_drivebase_t *db, const pbio_drivebase_path_segment_t *segments, uint8_t num_segments, int32_t speed, int32_t acceleration);
+
+// Steering by a sensor
+
+pbio_error_t pbio_drivebase_follow(pbio_drivebase_t *db, pbio_reflex_source_t source, void *context, int32_t target, fix16_t kp, fix16_t ki, fix16_t kd, int32_t speed);
+
 // Measuring
 
 pbio_error_t pbio_drivebase_get_state(pbio_drivebase_t *db, int32_t *distance, int32_t *drive_speed, int32_t *angle, int32_t *turn_rate);
 
 pbio_error_t pbio_drivebase_reset_state(pbio_drivebase_t *db);
 
+// Odometry. Position is in mm, with x forward and y to the right of the
+// initial pose. The angle is in degrees, clockwise like the drivebase angle.
+
+pbio_error_t pbio_drivebase_get_pose(pbio_drivebase_t *db, int32_t *x, int32_t *y, int32_t *theta);
+
+pbio_error_t pbio_drivebase_reset_pose(pbio_drivebase_t *db, int32_t x, int32_t y, int32_t theta);
+
+// Heading source
+
+pbio_error_t pbio_drivebase_set_heading_source(pbio_drivebase_t *db, pbio_drivebase_heading_func_t func, void *context);
+
 // Settings
 
 pbio_error_t pbio_drivebase_get_drive_settings(pbio_drivebase_t *db, int32_t *drive_speed, int32_t *drive_acceleration, int32_t *turn_rate, int32_t *turn_acceleration);
@@ -399,6 +399,16 @@ struct _pbio_iodev_t {
      * Motor capability flags.
      */
     pbio_iodev_motor_flags_t motor_flags;
+    /**
+     * Time (in microseconds, see clock_usecs()) at which *bin_data* was last
+     * updated by the device driver.
+     */
+    uint32_t timestamp;
+    /**
+     * Sequence number of *bin_data*. This is incremented each time new data
+     * is received so that consumers can tell a new sample from a repeated one.
+     */
+    uint32_t data_seq;
     /**
      * Most recent binary data read from the device. How to interpret this data
      * is determined by the ::pbio_iodev_mode_t info associated with the current
@@ -413,6 +423,7 @@ struct _pbio_iodev_t {
 size_t pbio_iodev_size_of(pbio_iodev_data_type_t type);
 pbio_error_t pbio_iodev_get_data_format(pbio_iodev_t *iodev, uint8_t mode, uint8_t *len, pbio_iodev_data_type_t *type);
 pbio_error_t pbio_iodev_get_data(pbio_iodev_t *iodev, uint8_t **data);
+pbio_error_t pbio_iodev_get_data_timestamp(pbio_iodev_t *iodev, uint32_t *timestamp, uint32_t *seq);
 pbio_error_t pbio_iodev_set_mode_begin(pbio_iodev_t *iodev, uint8_t mode);
 pbio_error_t pbio_iodev_set_mode_end(pbio_iodev_t *iodev);
 void pbio_iodev_set_mode_cancel(pbio_iodev_t *iodev);
@@ -10,6 +10,12 @@
 
 #if PBDRV_CONFIG_NUM_MOTOR_CONTROLLER != 0
 
+/**
+ * Callback that is called from the motor poll process when a servo or drive
+ * base emitted an event, such as completing or stalling.
+ */
+typedef void (*pbio_motorpoll_event_callback_t)(void);
+
 pbio_error_t pbio_motorpoll_get_servo(pbio_port_t port, pbio_servo_t **srv);
 pbio_error_t pbio_motorpoll_get_servo_status(pbio_servo_t *srv);
 pbio_error_t pbio_motorpoll_set_servo_status(pbio_servo_t *srv, pbio_error_t err);
@@ -18,6 +24,9 @@ pbio_error_t pbio_motorpoll_get_drivebase(pbio_drivebase_t **db);
 pbio_error_t pbio_motorpoll_get_drivebase_status(pbio_drivebase_t *db);
 pbio_error_t pbio_motorpoll_set_drivebase_status(pbio_drivebase_t *db, pbio_error_t err);
 
+uint32_t pbio_motorpoll_get_event_count(void);
+void pbio_motorpoll_set_event_callback(pbio_motorpoll_event_callback_t callback);
+
 void _pbio_motorpoll_reset_all(void);
 void _pbio_motorpoll_poll(void);
 
@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+/**
+ * \addtogroup Reflex Sensor feedback loops
+ *
+ * A reflex reads a value from a sensor on every control loop iteration and
+ * turns the difference with a target value into an output using PID control.
+ * The output can steer a drivebase, so that line or wall following runs at
+ * the full control rate without any work in the user program.
+ * @{
+ */
+
+#ifndef _PBIO_REFLEX_H_
+#define _PBIO_REFLEX_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <fixmath.h>
+
+#include <pbio/error.h>
+
+/**
+ * Reads the value to be controlled by a reflex.
+ * @param [in] context      Context given to pbio_reflex_setup()
+ * @param [out] value       The value
+ * @return                  ::PBIO_SUCCESS, ::PBIO_ERROR_AGAIN if no value is
+ *                          available right now or another error if the sensor
+ *                          could not be read.
+ */
+typedef pbio_error_t (*pbio_reflex_source_t)(void *context, int32_t *value);
+
+typedef struct _pbio_reflex_t {
+    pbio_reflex_source_t source;
+    void *context;
+    int32_t target; // Value that the source should have
+    fix16_t kp; // Output per unit of error
+    fix16_t ki; // Output per unit of error, per second
+    fix16_t kd; // Output per unit of error rate of change (units/s)
+    int32_t output_max; // Bound on the output magnitude
+    bool started; // Whether the values below have been set
+    int32_t time_prev; // Time of the previous update (us)
+    int32_t error_prev; // Error at the previous update
+    int32_t integral; // Integral of the error (units * ms)
+    int32_t output; // Most recent output
+} pbio_reflex_t;
+
+void pbio_reflex_setup(pbio_reflex_t *reflex, pbio_reflex_source_t source, void *context, int32_t target, fix16_t kp, fix16_t ki, fix16_t kd, int32_t output_max);
+
+/**
+ * Reads the source and calculates a new output.
+ * @param [in] reflex       The reflex
+ * @param [in] time_now     The current time (us)
+ * @param [out] output      The new output, or the previous output if no new
+ *                          value was available
+ * @return                  ::PBIO_SUCCESS or an error if the source could not
+ *                          be read.
+ */
+pbio_error_t pbio_reflex_update(pbio_reflex_t *reflex, int32_t time_now, int32_t *output);
+
+#endif // _PBIO_REFLEX_H_
+
+/** @} */
@@ -23,6 +23,8 @@
 
 #include <pbio/iodev.h>
 
+void pbio_servo_load_settings(pbio_control_settings_t *s, pbio_iodev_type_id_t id);
+
 #if PBDRV_CONFIG_NUM_MOTOR_CONTROLLER != 0
 
 typedef struct _pbio_servo_t {
@@ -87,6 +87,27 @@ pbio_error_t pbsys_stdin_get_char(uint8_t *c);
  */
 pbio_error_t pbsys_stdout_put_char(uint8_t c);
 
+/**
+ * Write data to stdout without blocking.
+ *
+ * As much of *data* as can be buffered is written. Call this again with the
+ * remaining data to write the rest.
+ * @param [in] data     The data to write
+ * @param [in] size     The size of *data* in bytes
+ * @param [out] written The number of bytes that were written
+ * @return              ::PBIO_SUCCESS if at least one byte was written,
+ *                      ::PBIO_ERROR_AGAIN if no bytes could be written
+ *                      at this time or ::PBIO_ERROR_NOT_SUPPORTED if the
+ *                      platform does not have a stdout.
+ */
+pbio_error_t pbsys_stdout_write(const uint8_t *data, uint32_t size, uint32_t *written);
+
+/**
+ * Requests that any buffered stdout data is sent as soon as possible instead
+ * of waiting for more data to accumulate. This function does not block.
+ */
+void pbsys_stdout_flush(void);
+
 /**
  * Reboots the brick. This could also be considered a "hard" reset. This
  * function never returns.
@@ -113,6 +134,12 @@ static inline pbio_error_t pbsys_stdin_get_char(uint8_t *c) {
 static inline pbio_error_t pbsys_stdout_put_char(uint8_t c) {
     return PBIO_ERROR_NOT_SUPPORTED;
 }
+static inline pbio_error_t pbsys_stdout_write(const uint8_t *data, uint32_t size, uint32_t *written) {
+    *written = 0;
+    return PBIO_ERROR_NOT_SUPPORTED;
+}
+static inline void pbsys_stdout_flush(void) {
+}
 static inline void pbsys_reset(void) {
 }
 static inline void pbsys_reboot(bool fw_update) {
@@ -35,6 +35,11 @@
 #define PBDRV_CONFIG_GPIO                           (1)
 #define PBDRV_CONFIG_GPIO_STM32L4                   (1)
 
+#define PBDRV_CONFIG_IMU                            (1)
+#define PBDRV_CONFIG_IMU_LSM6DS3TR_C_STM32_HAL      (1)
+#define PBDRV_CONFIG_IMU_LSM6DS3TR_C_STM32_HAL_I2C_INSTANCE I2C1
+#define PBDRV_CONFIG_IMU_LSM6DS3TR_C_STM32_HAL_I2C_TIMING   0x00000404 // ~400kHz
+
 #define PBDRV_CONFIG_IOPORT                         (1)
 #define PBDRV_CONFIG_IOPORT_LPF2                    (1)
 #define PBDRV_CONFIG_IOPORT_LPF2_NUM_PORTS          (4)
@@ -7,6 +7,7 @@
 
 #include "../../drv/adc/adc_stm32_hal.h"
 #include "../../drv/button/button_gpio.h"
+#include "../../drv/imu/imu_lsm6ds3tr_c_stm32_hal.h"
 #include "../../drv/ioport/ioport_lpf2.h"
 #include "../../drv/uart/uart_stm32l4_ll.h"
 
@@ -311,13 +312,11 @@ void HAL_I2C_MspInit(I2C_HandleTypeDef *hi2c) {
 }
 
 void I2C1_ER_IRQHandler(void) {
-    extern void mod_experimental_IMU_handle_i2c_er_irq();
-    mod_experimental_IMU_handle_i2c_er_irq();
+    pbdrv_imu_lsm6ds3tr_c_stm32_hal_handle_i2c_er_irq();
 }
 
 void I2C1_EV_IRQHandler(void) {
-    extern void mod_experimental_IMU_handle_i2c_ev_irq();
-    mod_experimental_IMU_handle_i2c_ev_irq();
+    pbdrv_imu_lsm6ds3tr_c_stm32_hal_handle_i2c_ev_irq();
 }
 
 // Early initialization
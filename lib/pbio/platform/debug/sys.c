@@ -78,6 +78,24 @@ pbio_error_t pbsys_stdout_put_char(uint8_t c) {
     return PBIO_SUCCESS;
 }
 
+pbio_error_t pbsys_stdout_write(const uint8_t *data, uint32_t size, uint32_t *written) {
+    uint32_t i;
+
+    // no buffering, so this only writes as long as the UART is ready
+    for (i = 0; i < size; i++) {
+        if (pbsys_stdout_put_char(data[i]) != PBIO_SUCCESS) {
+            break;
+        }
+    }
+
+    *written = i;
+
+    return i ? PBIO_SUCCESS : PBIO_ERROR_AGAIN;
+}
+
+void pbsys_stdout_flush(void) {
+}
+
 void pbsys_reboot(bool fw_update) {
     // this function never returns
     NVIC_SystemReset();
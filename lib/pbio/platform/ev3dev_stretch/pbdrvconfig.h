@@ -21,6 +21,7 @@
 
 #define PBDRV_CONFIG_IOPORT                                 (1)
 #define PBDRV_CONFIG_IOPORT_EV3DEV_STRETCH                  (1)
+#define PBDRV_CONFIG_IOPORT_EV3DEV_STRETCH_INDEX            (1)
 
 #define PBDRV_CONFIG_HAS_PORT_A (1)
 #define PBDRV_CONFIG_HAS_PORT_B (1)
@@ -81,6 +81,11 @@ const pbdrv_uart_stm32f0_platform_data_t pbdrv_uart_stm32f0_platform_data[PBDRV_
     [UART_ID_1] = {
         .uart = USART3,
         .irq = USART3_4_IRQn,
+        // USART4 RX has no DMA request free from the Bluetooth SPI channels,
+        // so only USART3 uses DMA.
+        .rx_dma = DMA1_Channel3,
+        .rx_dma_ch = 3,
+        .rx_dma_irq = DMA1_Channel2_3_IRQn,
     },
 };
 
@@ -90,6 +95,11 @@ void USART3_4_IRQHandler(void) {
     pbdrv_uart_stm32f0_handle_irq(UART_ID_1);
 }
 
+// overrides weak function in setup_*.m
+void DMA1_Channel2_3_IRQHandler(void) {
+    pbdrv_uart_stm32f0_handle_dma_irq(UART_ID_1);
+}
+
 #if PBIO_CONFIG_UARTDEV
 const pbio_uartdev_platform_data_t pbio_uartdev_platform_data[PBIO_CONFIG_UARTDEV_NUM_DEV] = {
     [0] = {
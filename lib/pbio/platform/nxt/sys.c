@@ -90,6 +90,14 @@ pbio_error_t pbsys_stdout_put_char(uint8_t c) {
     return pbdrv_bluetooth_tx(c);
 }
 
+pbio_error_t pbsys_stdout_write(const uint8_t *data, uint32_t size, uint32_t *written) {
+    return pbdrv_bluetooth_tx_buf(data, size, written);
+}
+
+void pbsys_stdout_flush(void) {
+    // Bluetooth driver starts sending as soon as data is written
+}
+
 void pbsys_reboot(bool fw_update) {
     // TODO RESET
     // this function never returns
@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <contiki.h>
+
+static bool clock_simulated;
+
+// Simulated time since clock_init() (us)
+static uint64_t clock_simulated_usecs;
+
+void clock_virtual_set_simulated(bool simulated) {
+    clock_simulated = simulated;
+}
+
+bool clock_virtual_is_simulated(void) {
+    return clock_simulated;
+}
+
+void clock_virtual_advance(uint32_t usecs) {
+    clock_simulated_usecs += usecs;
+}
+
+void clock_init(void) {
+    clock_simulated_usecs = 0;
+}
+
+static uint64_t clock_get_usecs(void) {
+    if (clock_simulated) {
+        return clock_simulated_usecs;
+    }
+    struct timespec time_val;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &time_val);
+    return time_val.tv_sec * 1000000ULL + time_val.tv_nsec / 1000;
+}
+
+clock_time_t clock_time() {
+    return clock_get_usecs() / 1000;
+}
+
+unsigned long clock_usecs() {
+    return clock_get_usecs();
+}
+
+void clock_delay_usec(uint16_t duration) {
+    if (clock_simulated) {
+        clock_virtual_advance(duration);
+        return;
+    }
+    usleep(duration);
+}
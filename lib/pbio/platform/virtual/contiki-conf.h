@@ -0,0 +1,26 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#ifndef _PBIO_CONF_H_
+#define _PBIO_CONF_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CCIF
+#define CLIF
+#define AUTOSTART_ENABLE 1
+
+typedef uint32_t clock_time_t;
+#define CLOCK_CONF_SECOND 1000
+
+// Selects simulated time instead of the wall clock. Must be called before
+// clock_init(). Simulated time only moves on when clock_virtual_advance() or
+// clock_delay_usec() is called, so programs run as fast as the host allows.
+void clock_virtual_set_simulated(bool simulated);
+
+bool clock_virtual_is_simulated(void);
+
+void clock_virtual_advance(uint32_t usecs);
+
+#endif /* _PBIO_CONF_H_ */
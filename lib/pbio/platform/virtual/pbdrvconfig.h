@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#ifndef _PBDRVCONFIG_H_
+#define _PBDRVCONFIG_H_
+
+// platform-specific configuration for a virtual hub with simulated motors
+
+#define PBDRV_CONFIG_COUNTER                                (1)
+#define PBDRV_CONFIG_COUNTER_NUM_DEV                        (4)
+#define PBDRV_CONFIG_COUNTER_VIRTUAL                        (1)
+#define PBDRV_CONFIG_COUNTER_VIRTUAL_NUM_DEV                (4)
+
+#define PBDRV_CONFIG_HAS_PORT_A (1)
+#define PBDRV_CONFIG_HAS_PORT_B (1)
+#define PBDRV_CONFIG_HAS_PORT_C (1)
+#define PBDRV_CONFIG_HAS_PORT_D (1)
+#define PBDRV_CONFIG_HAS_PORT_1 (1)
+#define PBDRV_CONFIG_HAS_PORT_2 (1)
+#define PBDRV_CONFIG_HAS_PORT_3 (1)
+#define PBDRV_CONFIG_HAS_PORT_4 (1)
+
+#define PBDRV_CONFIG_MOTOR                                  (1)
+#define PBDRV_CONFIG_MOTOR_SIM                              (1)
+#define PBDRV_CONFIG_MOTOR_VIRTUAL                          (1)
+
+#define PBDRV_CONFIG_FIRST_MOTOR_PORT PBIO_PORT_A
+#define PBDRV_CONFIG_LAST_MOTOR_PORT PBIO_PORT_D
+#define PBDRV_CONFIG_NUM_MOTOR_CONTROLLER (4)
+
+#endif // _PBDRVCONFIG_H_
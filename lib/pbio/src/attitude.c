@@ -0,0 +1,245 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#include <pbio/config.h>
+
+#if PBIO_CONFIG_ATTITUDE
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <fixmath.h>
+
+#include <pbdrv/imu.h>
+#include <pbio/attitude.h>
+#include <pbio/error.h>
+#include <pbio/math.h>
+#include <pbio/util.h>
+
+// Time constant of the complementary filter. Below this time scale, the tilt
+// follows the gyro. Above it, it follows the accelerometer.
+#define ATTITUDE_TAU_US (500000)
+
+// Gaps between samples longer than this are not integrated
+#define ATTITUDE_MAX_DT_US (100000)
+
+// The hub is considered still if the gyro stays within this band and the
+// measured acceleration is close to gravity for this many samples.
+#define ATTITUDE_STILL_BAND_MDPS (2000)
+#define ATTITUDE_STILL_SAMPLES (256)
+
+// Standard gravity (mm/s^2)
+#define ATTITUDE_GRAVITY (9807)
+
+#define NDEG_PER_DEG (1000000000LL)
+#define NDEG_PER_MDEG (1000000LL)
+
+// Converts angle in ndeg to radians in fix16 format
+static fix16_t ndeg_to_rad(int64_t angle) {
+    return angle * fix16_pi / (180 * NDEG_PER_DEG);
+}
+
+// Converts angle in radians in fix16 format to ndeg
+static int64_t rad_to_ndeg(fix16_t angle) {
+    return angle * 180 * NDEG_PER_DEG / fix16_pi;
+}
+
+// Wraps angle to the range [-180, 180) degrees
+static int64_t wrap_ndeg(int64_t angle) {
+    while (angle >= 180 * NDEG_PER_DEG) {
+        angle -= 360 * NDEG_PER_DEG;
+    }
+    while (angle < -180 * NDEG_PER_DEG) {
+        angle += 360 * NDEG_PER_DEG;
+    }
+    return angle;
+}
+
+// Converts acceleration in mm/s^2 to m/s^2 in fix16 format
+static fix16_t accel_to_fix16(int32_t accel) {
+    return (int64_t)accel * fix16_one / 1000;
+}
+
+void pbio_attitude_reset(pbio_attitude_t *att) {
+    // Keep the bias estimate since it does not depend on the orientation
+    pbio_attitude_t reset = {
+        .bias = { att->bias[0], att->bias[1], att->bias[2] },
+        .bias_valid = att->bias_valid,
+    };
+    *att = reset;
+}
+
+// Re-estimates the gyro bias whenever the hub has been still for a while
+static void pbio_attitude_update_bias(pbio_attitude_t *att, const pbdrv_imu_sample_t *sample, bool gravity_only) {
+    // Once we have a bias estimate, turning at a constant rate must not be
+    // mistaken for being still, so the gyro must also stay near the bias.
+    bool still = gravity_only;
+    for (int i = 0; i < 3 && still; i++) {
+        if (att->still_count && abs(sample->gyro[i] - att->still_ref[i]) > ATTITUDE_STILL_BAND_MDPS) {
+            still = false;
+        }
+        if (att->bias_valid && abs(sample->gyro[i] - att->bias[i]) > ATTITUDE_STILL_BAND_MDPS) {
+            still = false;
+        }
+    }
+
+    if (!still) {
+        att->still_count = 0;
+        return;
+    }
+
+    if (att->still_count == 0) {
+        for (int i = 0; i < 3; i++) {
+            att->still_ref[i] = sample->gyro[i];
+            att->still_sum[i] = 0;
+        }
+    }
+
+    for (int i = 0; i < 3; i++) {
+        att->still_sum[i] += sample->gyro[i];
+    }
+
+    if (++att->still_count == ATTITUDE_STILL_SAMPLES) {
+        for (int i = 0; i < 3; i++) {
+            att->bias[i] = att->still_sum[i] / ATTITUDE_STILL_SAMPLES;
+        }
+        att->bias_valid = true;
+        att->still_count = 0;
+    }
+}
+
+void pbio_attitude_update(pbio_attitude_t *att, const pbdrv_imu_sample_t *sample) {
+    fix16_t ax = accel_to_fix16(sample->accel[0]);
+    fix16_t ay = accel_to_fix16(sample->accel[1]);
+    fix16_t az = accel_to_fix16(sample->accel[2]);
+    fix16_t ayz2 = fix16_mul(ay, ay) + fix16_mul(az, az);
+    fix16_t norm2 = fix16_mul(ax, ax) + ayz2;
+
+    // The accelerometer only tells us which way is down if there is no
+    // other acceleration, so only use it if the magnitude is close to 1 g.
+    fix16_t g = accel_to_fix16(ATTITUDE_GRAVITY);
+    fix16_t g2 = fix16_mul(g, g);
+    bool gravity_only = norm2 > fix16_mul(g2, F16(0.81)) && norm2 < fix16_mul(g2, F16(1.21));
+
+    // Tilt according to the accelerometer
+    int64_t pitch_acc = rad_to_ndeg(fix16_atan2(-ax, fix16_sqrt(ayz2)));
+    int64_t roll_acc = rad_to_ndeg(fix16_atan2(ay, az));
+
+    pbio_attitude_update_bias(att, sample, gravity_only);
+
+    for (int i = 0; i < 3; i++) {
+        att->rate[i] = sample->gyro[i] - att->bias[i];
+    }
+
+    // On the first sample, start from the accelerometer tilt
+    if (!att->initialized) {
+        att->initialized = true;
+        att->time_prev = sample->timestamp;
+        att->pitch = pitch_acc;
+        att->roll = roll_acc;
+        return;
+    }
+
+    int32_t dt = sample->timestamp - att->time_prev;
+    att->time_prev = sample->timestamp;
+    if (dt <= 0 || dt > ATTITUDE_MAX_DT_US) {
+        return;
+    }
+
+    // Convert angular velocity in the hub frame to rate of change of the
+    // pitch, roll and heading angles.
+    fix16_t roll_rad = ndeg_to_rad(att->roll);
+    fix16_t pitch_rad = ndeg_to_rad(att->pitch);
+    fix16_t sin_roll = fix16_sin(roll_rad);
+    fix16_t cos_roll = fix16_cos(roll_rad);
+    fix16_t sin_pitch = fix16_sin(pitch_rad);
+    fix16_t cos_pitch = fix16_cos(pitch_rad);
+
+    // Avoid blowing up near the singularity at +/-90 degrees pitch
+    if (cos_pitch < F16(0.1)) {
+        cos_pitch = F16(0.1);
+    }
+
+    int32_t yz_rate = pbio_math_mul_i32_fix16(att->rate[1], sin_roll) +
+        pbio_math_mul_i32_fix16(att->rate[2], cos_roll);
+    int32_t heading_rate = pbio_math_div_i32_fix16(yz_rate, cos_pitch);
+    int32_t roll_rate = att->rate[0] + pbio_math_mul_i32_fix16(heading_rate, sin_pitch);
+    att->heading_rate = heading_rate;
+    int32_t pitch_rate = pbio_math_mul_i32_fix16(att->rate[1], cos_roll) -
+        pbio_math_mul_i32_fix16(att->rate[2], sin_roll);
+
+    // mdps * us = ndeg
+    att->heading += (int64_t)heading_rate * dt;
+    att->pitch += (int64_t)pitch_rate * dt;
+    att->roll = wrap_ndeg(att->roll + (int64_t)roll_rate * dt);
+
+    if (!gravity_only) {
+        return;
+    }
+
+    // Pull tilt towards the accelerometer estimate
+    int64_t gain = ((int64_t)dt << 16) / (ATTITUDE_TAU_US + dt);
+    att->pitch += ((pitch_acc - att->pitch) * gain) >> 16;
+
+    // Roll is undefined if the hub is pointing straight up or down
+    if (ayz2 > fix16_mul(g2, F16(0.1))) {
+        att->roll = wrap_ndeg(att->roll + ((wrap_ndeg(roll_acc - att->roll) * gain) >> 16));
+    }
+}
+
+void pbio_attitude_get_tilt(pbio_attitude_t *att, int32_t *pitch, int32_t *roll) {
+    *pitch = att->pitch / NDEG_PER_MDEG;
+    *roll = att->roll / NDEG_PER_MDEG;
+}
+
+void pbio_attitude_get_heading(pbio_attitude_t *att, int32_t *heading, int32_t *heading_rate) {
+    *heading = att->heading / NDEG_PER_MDEG;
+    *heading_rate = att->heading_rate;
+}
+
+void pbio_attitude_get_angular_velocity(pbio_attitude_t *att, int32_t *rate) {
+    for (int i = 0; i < 3; i++) {
+        rate[i] = att->rate[i];
+    }
+}
+
+void pbio_attitude_reset_heading(pbio_attitude_t *att, int32_t heading) {
+    att->heading = heading * NDEG_PER_MDEG;
+}
+
+// Estimate fed by the hub IMU
+
+static pbio_attitude_t attitude;
+static uint32_t attitude_seq;
+static pbio_error_t attitude_err = PBIO_ERROR_AGAIN;
+
+pbio_error_t pbio_attitude_get(pbio_attitude_t **att) {
+    *att = &attitude;
+    if (attitude_err != PBIO_SUCCESS) {
+        return attitude_err;
+    }
+    return attitude.initialized ? PBIO_SUCCESS : PBIO_ERROR_AGAIN;
+}
+
+void _pbio_attitude_poll(void) {
+    pbdrv_imu_sample_t samples[8];
+    uint32_t count;
+
+    // Process all samples that came in since the last poll
+    do {
+        count = PBIO_ARRAY_SIZE(samples);
+        pbio_error_t err = pbdrv_imu_read_samples(&attitude_seq, samples, &count);
+        if (err != PBIO_SUCCESS) {
+            attitude_err = err;
+            return;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            pbio_attitude_update(&attitude, &samples[i]);
+        }
+    } while (count == PBIO_ARRAY_SIZE(samples));
+
+    attitude_err = PBIO_SUCCESS;
+}
+
+#endif // PBIO_CONFIG_ATTITUDE
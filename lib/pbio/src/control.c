@@ -18,6 +18,10 @@ void control_update(pbio_control_t *ctl, int32_t time_now, int32_t count_now, in
     int32_t acceleration_ref;
     int32_t duty, duty_due_to_proportional, duty_due_to_integral, duty_due_to_derivative, duty_feedforward;
 
+    // State before this update, used to emit events when it changes
+    bool was_stalled = ctl->stalled;
+    bool was_on_target = ctl->on_target;
+
     // Get the time at which we want to evaluate the reference position/velocities.
     // This compensates for any time we may have spent pausing when the motor was stalled.
     time_ref = pbio_control_get_ref_time(ctl, time_now);
@@ -88,6 +92,14 @@ void control_update(pbio_control_t *ctl, int32_t time_now, int32_t count_now, in
     // Check if we are on target
     ctl->on_target = ctl->on_target_func(&ctl->trajectory, &ctl->settings, time_ref, count_now, rate_now, ctl->stalled);
 
+    // Emit events so that anything waiting for this maneuver can respond in this control tick
+    if (ctl->stalled && !was_stalled) {
+        ctl->events |= PBIO_CONTROL_EVENT_STALLED;
+    }
+    if (ctl->on_target && !was_on_target) {
+        ctl->events |= PBIO_CONTROL_EVENT_DONE;
+    }
+
     // If we are done and the next action is passive then return zero actuation
     if (ctl->on_target && ctl->after_stop != PBIO_ACTUATION_HOLD) {
         *actuation_type = ctl->after_stop;
@@ -114,6 +126,8 @@ void pbio_control_stop(pbio_control_t *ctl) {
     ctl->on_target = true;
     ctl->on_target_func = pbio_control_on_target_always;
     ctl->stalled = false;
+    // Stopping also completes any maneuver that was still going
+    ctl->events |= PBIO_CONTROL_EVENT_DONE;
 }
 
 pbio_error_t pbio_control_start_angle_control(pbio_control_t *ctl, int32_t time_now, int32_t count_now, int32_t target_count, int32_t rate_now, int32_t target_rate, int32_t acceleration, pbio_actuation_t after_stop) {
@@ -409,3 +423,10 @@ bool pbio_control_is_stalled(pbio_control_t *ctl) {
 bool pbio_control_is_done(pbio_control_t *ctl) {
     return ctl->type == PBIO_CONTROL_NONE || ctl->on_target;
 }
+
+// Gets the events emitted since the last call and clears them
+uint8_t pbio_control_take_events(pbio_control_t *ctl) {
+    uint8_t events = ctl->events;
+    ctl->events = 0;
+    return events;
+}
@@ -1,6 +1,8 @@
 // SPDX-License-Identifier: MIT
 // Copyright (c) 2018-2020 The Pybricks Authors
 
+#include <stdlib.h>
+
 #include <contiki.h>
 
 #include <pbio/error.h>
@@ -10,9 +12,19 @@
 
 #define DRIVEBASE_LOG_NUM_VALUES (15 + NUM_DEFAULT_LOG_VALUES)
 
-#if PBDRV_CONFIG_NUM_MOTOR_CONTROLLER != 0
+// Pure pursuit steers toward a point this far ahead on the path. It is at
+// least the minimum distance, and grows with the time to reach it.
+#define DRIVEBASE_PATH_LOOKAHEAD_MIN_UM (50000)
+#define DRIVEBASE_PATH_LOOKAHEAD_TIME_MS (300)
+
+// Speed used toward the end of a path, so the end is actually reached (mm/s)
+#define DRIVEBASE_PATH_MIN_SPEED (20)
 
-static pbio_error_t drivebase_adopt_settings(pbio_control_settings_t *s_distance, pbio_control_settings_t *s_heading, pbio_control_settings_t *s_left, pbio_control_settings_t *s_right) {
+// Bound on the pure pursuit turn rate before it is converted to counts (mrad/s)
+#define DRIVEBASE_PATH_MAX_TURN_RATE (100000LL)
+
+// Derives the drivebase control settings from those of its two motors
+pbio_error_t pbio_drivebase_adopt_settings(pbio_control_settings_t *s_distance, pbio_control_settings_t *s_heading, const pbio_control_settings_t *s_left, const pbio_control_settings_t *s_right) {
 
     // All rate/count acceleration limits add up, because distance state is two motors counts added
     s_distance->max_rate = s_left->max_rate + s_right->max_rate;
@@ -48,6 +60,23 @@ static pbio_error_t drivebase_adopt_settings(pbio_control_settings_t *s_distance
     return PBIO_SUCCESS;
 }
 
+#if PBDRV_CONFIG_NUM_MOTOR_CONTROLLER != 0
+
+// Convert millidegrees of drivebase rotation to wheel count difference
+static int32_t drivebase_heading_to_counts(pbio_drivebase_t *db, int32_t heading) {
+    return pbio_math_mul_i32_fix16(heading, db->control_heading.settings.counts_per_unit) / 1000;
+}
+
+// Convert wheel count difference to millidegrees of drivebase rotation
+static int32_t drivebase_counts_to_mdeg(pbio_drivebase_t *db, int32_t dif) {
+    return (int64_t)dif * 1000 * fix16_one / db->control_heading.settings.counts_per_unit;
+}
+
+// Convert wheel count sum to micrometers of forward travel
+static int32_t drivebase_counts_to_um(pbio_drivebase_t *db, int32_t sum) {
+    return (int64_t)sum * 1000 * fix16_one / db->control_distance.settings.counts_per_unit;
+}
+
 // Get the physical state of a drivebase
 static pbio_error_t drivebase_get_state(pbio_drivebase_t *db,
     int32_t *time_now,
@@ -90,6 +119,18 @@ static pbio_error_t drivebase_get_state(pbio_drivebase_t *db,
     *dif = count_left - count_right;
     *dif_rate = rate_left - rate_right;
 
+    // If there is an external heading source, it replaces the wheel count
+    // difference, so heading is not affected by wheel slip.
+    if (db->heading_func) {
+        int32_t heading, heading_rate;
+        err = db->heading_func(db->heading_context, &heading, &heading_rate);
+        if (err != PBIO_SUCCESS) {
+            return err;
+        }
+        *dif = drivebase_heading_to_counts(db, heading) + db->heading_offset;
+        *dif_rate = drivebase_heading_to_counts(db, heading_rate);
+    }
+
     return PBIO_SUCCESS;
 }
 
@@ -142,6 +183,139 @@ static pbio_error_t pbio_drivebase_actuate(pbio_drivebase_t *db, pbio_actuation_
     return err;
 }
 
+// Convert millidegrees to radians in fix16 format. Angle is wrapped first
+// so it fits.
+static fix16_t drivebase_mdeg_to_rad(int32_t angle) {
+    return (int64_t)(angle % 360000) * fix16_pi / 180000;
+}
+
+// Integrate the position of the drivebase since the previous update
+static void drivebase_update_pose(pbio_drivebase_t *db, int32_t sum, int32_t dif) {
+
+    // On the first update, start at zero angle
+    if (!db->pose_valid) {
+        db->pose_valid = true;
+        db->pose_sum_prev = sum;
+        db->pose_dif_offset = dif;
+        db->pose_theta_prev = 0;
+        return;
+    }
+
+    int32_t theta = drivebase_counts_to_mdeg(db, dif - db->pose_dif_offset);
+
+    int32_t distance = drivebase_counts_to_um(db, sum - db->pose_sum_prev);
+
+    // Move along the average heading during this interval
+    fix16_t theta_rad = drivebase_mdeg_to_rad(db->pose_theta_prev + (theta - db->pose_theta_prev) / 2);
+
+    db->pose_x += pbio_math_mul_i32_fix16(distance, fix16_cos(theta_rad));
+    db->pose_y += pbio_math_mul_i32_fix16(distance, fix16_sin(theta_rad));
+    db->pose_sum_prev = sum;
+    db->pose_theta_prev = theta;
+}
+
+// Drive at the given rates until told otherwise
+static pbio_error_t drivebase_drive_counts(pbio_drivebase_t *db, int32_t time_now, int32_t sum, int32_t sum_rate, int32_t target_sum_rate, int32_t sum_acceleration, int32_t dif, int32_t dif_rate, int32_t target_dif_rate) {
+    pbio_error_t err = pbio_control_start_timed_control(&db->control_distance, time_now, DURATION_FOREVER, sum, sum_rate, target_sum_rate, sum_acceleration, pbio_control_on_target_never, PBIO_ACTUATION_COAST);
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+    return pbio_control_start_timed_control(&db->control_heading, time_now, DURATION_FOREVER, dif, dif_rate, target_dif_rate, db->control_heading.settings.abs_acceleration, pbio_control_on_target_never, PBIO_ACTUATION_COAST);
+}
+
+// Get the point at the given distance from the start of a path segment
+static void drivebase_path_node_get_point(pbio_drivebase_path_node_t *node, int32_t traveled, int32_t *x, int32_t *y) {
+
+    int32_t turned = node->length ? (int64_t)node->angle * traveled / node->length : 0;
+
+    // Moving along an arc is the same as moving along its chord, which is
+    // in the direction of the average heading.
+    fix16_t half = drivebase_mdeg_to_rad(turned / 2);
+    int32_t chord = traveled;
+    if (half != 0) {
+        chord = pbio_math_mul_i32_fix16(traveled, fix16_div(fix16_sin(half), half));
+    }
+    fix16_t theta = drivebase_mdeg_to_rad(node->theta + turned / 2);
+    *x = node->x + pbio_math_mul_i32_fix16(chord, fix16_cos(theta));
+    *y = node->y + pbio_math_mul_i32_fix16(chord, fix16_sin(theta));
+}
+
+// Get the point at the given distance along a path. Beyond the end, the
+// path continues in a straight line.
+static void drivebase_path_get_point(pbio_drivebase_path_t *path, int32_t distance, int32_t *x, int32_t *y) {
+    pbio_drivebase_path_node_t *node = &path->nodes[0];
+    while (node < &path->nodes[path->num_segments] && distance >= node->start + node->length) {
+        node++;
+    }
+    drivebase_path_node_get_point(node, distance - node->start, x, y);
+}
+
+// Sets the drive speed and turn rate to follow the path from the current pose
+static pbio_error_t drivebase_path_update(pbio_drivebase_t *db, int32_t time_now, int32_t sum, int32_t sum_rate, int32_t dif, int32_t dif_rate) {
+
+    pbio_drivebase_path_t *path = &db->path;
+
+    // Hold position once we have traveled the full length of the path
+    int32_t traveled = drivebase_counts_to_um(db, sum - path->sum_start);
+    int32_t remaining = path->nodes[path->num_segments].start - traveled;
+    if (remaining <= 0) {
+        path->active = false;
+        return pbio_drivebase_stop(db, PBIO_ACTUATION_HOLD);
+    }
+
+    // Slow down such that we can stop at the end
+    int32_t speed = path->speed;
+    if ((int64_t)path->acceleration * (remaining / 1000) * 2 < (int64_t)speed * speed) {
+        speed = pbio_math_sqrt(path->acceleration * (remaining / 1000) * 2);
+        speed = max(speed, min(path->speed, DRIVEBASE_PATH_MIN_SPEED));
+    }
+
+    // Get the lookahead point relative to the drivebase
+    int32_t lookahead = max(DRIVEBASE_PATH_LOOKAHEAD_MIN_UM, speed * DRIVEBASE_PATH_LOOKAHEAD_TIME_MS);
+    int32_t x, y;
+    drivebase_path_get_point(path, traveled + lookahead, &x, &y);
+    x -= db->pose_x;
+    y -= db->pose_y;
+    fix16_t theta = drivebase_mdeg_to_rad(db->pose_theta_prev);
+    fix16_t cos_theta = fix16_cos(theta);
+    fix16_t sin_theta = fix16_sin(theta);
+    int64_t ahead = pbio_math_mul_i32_fix16(x, cos_theta) + pbio_math_mul_i32_fix16(y, sin_theta);
+    int64_t right = pbio_math_mul_i32_fix16(y, cos_theta) - pbio_math_mul_i32_fix16(x, sin_theta);
+
+    // Drive along the circle through the lookahead point. Its curvature is
+    // 2 * right / distance^2, so this gives the turn rate in mrad/s.
+    int64_t distance2 = ahead * ahead + right * right;
+    int64_t turn_rate = distance2 ? (int64_t)speed * 2 * right * 1000000 / distance2 : 0;
+    turn_rate = max(-DRIVEBASE_PATH_MAX_TURN_RATE, min(turn_rate, DRIVEBASE_PATH_MAX_TURN_RATE));
+
+    // Convert to mdeg/s and then to count difference rate
+    turn_rate = turn_rate * 180 * fix16_one / fix16_pi;
+    int32_t max_turn_rate = db->control_heading.settings.max_rate;
+    int32_t target_dif_rate = drivebase_heading_to_counts(db, turn_rate);
+    target_dif_rate = max(-max_turn_rate, min(target_dif_rate, max_turn_rate));
+
+    // Update both controllers
+    int32_t target_sum_rate = pbio_control_user_to_counts(&db->control_distance.settings, speed);
+    int32_t sum_acceleration = pbio_control_user_to_counts(&db->control_distance.settings, path->acceleration);
+    return drivebase_drive_counts(db, time_now, sum, sum_rate, target_sum_rate, sum_acceleration, dif, dif_rate, target_dif_rate);
+}
+
+// Sets the turn rate given by the reflex
+static pbio_error_t drivebase_reflex_update(pbio_drivebase_t *db, int32_t time_now, int32_t sum, int32_t sum_rate, int32_t dif, int32_t dif_rate) {
+    int32_t turn_rate;
+    pbio_error_t err = pbio_reflex_update(&db->reflex, time_now, &turn_rate);
+    if (err != PBIO_SUCCESS) {
+        // The drivebase is not polled after an error, so don't leave the
+        // motors running without control.
+        db->reflex_active = false;
+        pbio_drivebase_stop(db, PBIO_ACTUATION_COAST);
+        return err;
+    }
+    int32_t target_sum_rate = pbio_control_user_to_counts(&db->control_distance.settings, db->reflex_speed);
+    int32_t target_dif_rate = pbio_control_user_to_counts(&db->control_heading.settings, turn_rate);
+    return drivebase_drive_counts(db, time_now, sum, sum_rate, target_sum_rate, db->control_distance.settings.abs_acceleration, dif, dif_rate, target_dif_rate);
+}
+
 // Log motor data for a motor that is being actively controlled
 static pbio_error_t drivebase_log_update(pbio_drivebase_t *db,
     int32_t time_now,
@@ -214,11 +388,22 @@ pbio_error_t pbio_drivebase_setup(pbio_drivebase_t *db, pbio_servo_t *left, pbio
     db->right = right;
     pbio_drivebase_claim_servos(db, false);
 
+    // Use wheel count difference for heading until told otherwise
+    db->heading_func = NULL;
+    db->heading_context = NULL;
+
+    // Start odometry at the current position
+    db->pose_valid = false;
+    db->pose_x = 0;
+    db->pose_y = 0;
+    db->path.active = false;
+    db->reflex_active = false;
+
     // Initialize log
     db->log.num_values = DRIVEBASE_LOG_NUM_VALUES;
 
     // Adopt settings as the average or sum of both servos, except scaling
-    err = drivebase_adopt_settings(&db->control_distance.settings, &db->control_heading.settings, &db->left->control.settings, &db->right->control.settings);
+    err = pbio_drivebase_adopt_settings(&db->control_distance.settings, &db->control_heading.settings, &db->left->control.settings, &db->right->control.settings);
     if (err != PBIO_SUCCESS) {
         return err;
     }
@@ -254,6 +439,9 @@ pbio_error_t pbio_drivebase_setup(pbio_drivebase_t *db, pbio_servo_t *left, pbio
 
 // Claim servos so that they cannot be used independently
 void pbio_drivebase_claim_servos(pbio_drivebase_t *db, bool claim) {
+    // Any new command cancels the path or reflex we may be following
+    db->path.active = false;
+    db->reflex_active = false;
     // Stop control
     pbio_control_stop(&db->left->control);
     pbio_control_stop(&db->right->control);
@@ -290,6 +478,8 @@ pbio_error_t pbio_drivebase_stop(pbio_drivebase_t *db, pbio_actuation_t after_st
 pbio_error_t pbio_drivebase_stop_force(pbio_drivebase_t *db) {
 
     // Stop control so polling will stop
+    db->path.active = false;
+    db->reflex_active = false;
     pbio_control_stop(&db->control_distance);
     pbio_control_stop(&db->control_heading);
 
@@ -317,6 +507,25 @@ pbio_error_t pbio_drivebase_update(pbio_drivebase_t *db) {
         return err;
     }
 
+    // Keep track of position, whether or not we are controlling the motors
+    drivebase_update_pose(db, sum, dif);
+
+    // Steer along the path, if any
+    if (db->path.active) {
+        err = drivebase_path_update(db, time_now, sum, sum_rate, dif, dif_rate);
+        if (err != PBIO_SUCCESS) {
+            return err;
+        }
+    }
+
+    // Steer by the sensor, if any
+    if (db->reflex_active) {
+        err = drivebase_reflex_update(db, time_now, sum, sum_rate, dif, dif_rate);
+        if (err != PBIO_SUCCESS) {
+            return err;
+        }
+    }
+
     // If passive, log and exit
     if (db->control_heading.type == PBIO_CONTROL_NONE || db->control_distance.type == PBIO_CONTROL_NONE) {
         return drivebase_log_update(db, time_now, sum, sum_rate, 0, dif, dif_rate, 0);
@@ -455,6 +664,91 @@ pbio_error_t pbio_drivebase_drive(pbio_drivebase_t *db, int32_t speed, int32_t t
     return PBIO_SUCCESS;
 }
 
+pbio_error_t pbio_drivebase_follow_path(pbio_drivebase_t *db, const pbio_drivebase_path_segment_t *segments, uint8_t num_segments, int32_t speed, int32_t acceleration) {
+
+    pbio_error_t err;
+
+    if (num_segments == 0 || num_segments > PBIO_DRIVEBASE_PATH_MAX_SEGMENTS || speed <= 0 || acceleration <= 0) {
+        return PBIO_ERROR_INVALID_ARG;
+    }
+
+    // Segments must go forward, and arcs may not turn more than a full circle.
+    // Check them all before taking over the motors.
+    for (uint8_t i = 0; i < num_segments; i++) {
+        if (segments[i].distance <= 0 || abs(segments[i].angle) > 360) {
+            return PBIO_ERROR_INVALID_ARG;
+        }
+    }
+
+    // Claim both servos for use by drivebase
+    pbio_drivebase_claim_servos(db, true);
+
+    // Get the physical initial state
+    int32_t time_now, sum, sum_rate, dif, dif_rate;
+    err = drivebase_get_state(db, &time_now, &sum, &sum_rate, &dif, &dif_rate);
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+
+    // The path starts at the current pose
+    drivebase_update_pose(db, sum, dif);
+    pbio_drivebase_path_t *path = &db->path;
+    path->nodes[0].x = db->pose_x;
+    path->nodes[0].y = db->pose_y;
+    path->nodes[0].theta = db->pose_theta_prev;
+    path->nodes[0].start = 0;
+
+    // Get the start of each following segment from the end of the previous one
+    path->num_segments = 0;
+    for (uint8_t i = 0; i < num_segments; i++) {
+        pbio_drivebase_path_node_t *node = &path->nodes[i];
+        node->length = segments[i].distance * 1000;
+        node->angle = segments[i].angle * 1000;
+        path->num_segments++;
+
+        pbio_drivebase_path_node_t *next = &path->nodes[i + 1];
+        drivebase_path_node_get_point(node, node->length, &next->x, &next->y);
+        next->theta = node->theta + node->angle;
+        next->start = node->start + node->length;
+        next->length = 0;
+        next->angle = 0;
+    }
+
+    path->sum_start = sum;
+    path->speed = speed;
+    path->acceleration = acceleration;
+    path->active = true;
+
+    // Start driving right away, so the drivebase is not done before the
+    // first update.
+    return drivebase_path_update(db, time_now, sum, sum_rate, dif, dif_rate);
+}
+
+pbio_error_t pbio_drivebase_follow(pbio_drivebase_t *db, pbio_reflex_source_t source, void *context, int32_t target, fix16_t kp, fix16_t ki, fix16_t kd, int32_t speed) {
+
+    pbio_error_t err;
+
+    // Claim both servos for use by drivebase
+    pbio_drivebase_claim_servos(db, true);
+
+    // Get the physical initial state
+    int32_t time_now, sum, sum_rate, dif, dif_rate;
+    err = drivebase_get_state(db, &time_now, &sum, &sum_rate, &dif, &dif_rate);
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+
+    // The reflex may turn as fast as the drivebase is allowed to
+    int32_t max_turn_rate = pbio_control_counts_to_user(&db->control_heading.settings, db->control_heading.settings.max_rate);
+    pbio_reflex_setup(&db->reflex, source, context, target, kp, ki, kd, max_turn_rate);
+    db->reflex_speed = speed;
+    db->reflex_active = true;
+
+    // Start driving right away, so the drivebase is not done before the
+    // first update.
+    return drivebase_reflex_update(db, time_now, sum, sum_rate, dif, dif_rate);
+}
+
 pbio_error_t pbio_drivebase_get_state(pbio_drivebase_t *db, int32_t *distance, int32_t *drive_speed, int32_t *angle, int32_t *turn_rate) {
     int32_t time_now, sum, sum_rate, dif, dif_rate;
     pbio_error_t err = drivebase_get_state(db, &time_now, &sum, &sum_rate, &dif, &dif_rate);
@@ -473,6 +767,80 @@ pbio_error_t pbio_drivebase_reset_state(pbio_drivebase_t *db) {
     return drivebase_get_state(db, &time_now, &db->sum_offset, &sum_rate, &db->dif_offset, &dif_rate);
 }
 
+pbio_error_t pbio_drivebase_get_pose(pbio_drivebase_t *db, int32_t *x, int32_t *y, int32_t *theta) {
+    // Pose is updated by pbio_drivebase_update(), so there is nothing to read yet
+    if (!db->pose_valid) {
+        return PBIO_ERROR_AGAIN;
+    }
+    *x = db->pose_x / 1000;
+    *y = db->pose_y / 1000;
+    *theta = db->pose_theta_prev / 1000;
+    return PBIO_SUCCESS;
+}
+
+pbio_error_t pbio_drivebase_reset_pose(pbio_drivebase_t *db, int32_t x, int32_t y, int32_t theta) {
+    int32_t time_now, sum, sum_rate, dif, dif_rate;
+    pbio_error_t err = drivebase_get_state(db, &time_now, &sum, &sum_rate, &dif, &dif_rate);
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+
+    // Choose the offset so that the current heading gives the requested angle
+    db->pose_dif_offset = dif - drivebase_heading_to_counts(db, theta * 1000);
+    db->pose_valid = true;
+    db->pose_sum_prev = sum;
+    db->pose_theta_prev = theta * 1000;
+    db->pose_x = x * 1000;
+    db->pose_y = y * 1000;
+
+    return PBIO_SUCCESS;
+}
+
+pbio_error_t pbio_drivebase_set_heading_source(pbio_drivebase_t *db, pbio_drivebase_heading_func_t func, void *context) {
+
+    // Can't change the heading source while heading is being controlled
+    if (db->control_heading.type != PBIO_CONTROL_NONE) {
+        return PBIO_ERROR_INVALID_OP;
+    }
+
+    // Get the heading state using the current source
+    int32_t time_now, sum, sum_rate, dif, dif_rate;
+    pbio_error_t err = drivebase_get_state(db, &time_now, &sum, &sum_rate, &dif, &dif_rate);
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+
+    // Start the new source where the old one left off, so that the angle
+    // reported to the user does not jump.
+    db->heading_offset = dif;
+    if (func) {
+        int32_t heading, heading_rate;
+        err = func(context, &heading, &heading_rate);
+        if (err != PBIO_SUCCESS) {
+            return err;
+        }
+        db->heading_offset -= drivebase_heading_to_counts(db, heading);
+    } else {
+        // The wheel count difference has no offset. Apply the change to the
+        // user offset instead.
+        int32_t count_left, count_right;
+        err = pbio_tacho_get_count(db->left->tacho, &count_left);
+        if (err != PBIO_SUCCESS) {
+            return err;
+        }
+        err = pbio_tacho_get_count(db->right->tacho, &count_right);
+        if (err != PBIO_SUCCESS) {
+            return err;
+        }
+        db->dif_offset += count_left - count_right - dif;
+    }
+
+    db->heading_func = func;
+    db->heading_context = context;
+
+    return PBIO_SUCCESS;
+}
+
 pbio_error_t pbio_drivebase_get_drive_settings(pbio_drivebase_t *db, int32_t *drive_speed, int32_t *drive_acceleration, int32_t *turn_rate, int32_t *turn_acceleration) {
 
     pbio_control_settings_t *sd = &db->control_distance.settings;
@@ -72,6 +72,27 @@ pbio_error_t pbio_iodev_get_data(pbio_iodev_t *iodev, uint8_t **data) {
     return PBIO_SUCCESS;
 }
 
+/**
+ * Gets the time at which the raw data of an I/O device was received.
+ * @param [in]  iodev       The I/O device
+ * @param [out] timestamp   Receive time in microseconds (same time base as clock_usecs())
+ * @param [out] seq         Sequence number of the sample, incremented on each update
+ * @return                  ::PBIO_SUCCESS on success
+ *                          ::PBIO_ERROR_NO_DEV if the port does not have a device attached
+ *
+ * This describes the data returned by ::pbio_iodev_get_data().
+ */
+pbio_error_t pbio_iodev_get_data_timestamp(pbio_iodev_t *iodev, uint32_t *timestamp, uint32_t *seq) {
+    if (iodev->info->type_id == PBIO_IODEV_TYPE_ID_NONE) {
+        return PBIO_ERROR_NO_DEV;
+    }
+
+    *timestamp = iodev->timestamp;
+    *seq = iodev->data_seq;
+
+    return PBIO_SUCCESS;
+}
+
 /**
  * Sets the mode of an I/O device.
  * @param [in]  iodev       The I/O device
@@ -15,17 +15,22 @@
 #include "pbdrv/light.h"
 #include "pbdrv/motor.h"
 #include "pbsys/sys.h"
+#include "pbio/attitude.h"
 #include "pbio/config.h"
+#include "pbio/light.h"
 #include "pbio/motorpoll.h"
 #include "pbio/uartdev.h"
 
 #include "processes.h"
 
-static clock_time_t prev_fast_poll_time;
-static clock_time_t prev_slow_poll_time;
+// How often the light patterns are updated
+#define LIGHT_POLL_PERIOD_MS 32
+
+PROCESS(pbio_poll_process, "pbio poll");
 
 AUTOSTART_PROCESSES(
     &etimer_process
+    ,&pbio_poll_process
 #if PBDRV_CONFIG_ADC
     ,&pbdrv_adc_process
 #endif
@@ -39,6 +44,9 @@ AUTOSTART_PROCESSES(
 #if PBDRV_CONFIG_COUNTER
     ,&pbdrv_counter_process
 #endif
+#if PBDRV_CONFIG_IMU
+    ,&pbdrv_imu_process
+#endif
 #if PBDRV_CONFIG_IOPORT_EV3DEV_STRETCH
     ,&pbdrv_ioport_ev3dev_stretch_process
 #endif
@@ -74,26 +82,52 @@ void pbio_init(void) {
     _pbio_motorpoll_reset_all();
 }
 
+// Advances a periodic timer to its next deadline. If we fell behind by more
+// than one period, start over from now instead of running several times in a
+// row to catch up.
+static void reset_periodic_timer(struct etimer *et) {
+    etimer_reset(et);
+    if (timer_expired(&et->timer)) {
+        etimer_restart(et);
+    }
+}
+
+// Runs the background tasks that need to be done periodically. The etimer
+// deadlines are checked on each clock tick, so these run on time without
+// having to compare clock values on every call to pbio_do_one_event().
+PROCESS_THREAD(pbio_poll_process, ev, data) {
+    static struct etimer motor_timer;
+    static struct etimer light_timer;
+
+    PROCESS_BEGIN();
+
+    etimer_set(&motor_timer, clock_from_msec(PBIO_CONFIG_SERVO_PERIOD_MS));
+    etimer_set(&light_timer, clock_from_msec(LIGHT_POLL_PERIOD_MS));
+
+    for (;;) {
+        PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_TIMER);
+        if (data == &motor_timer) {
+            reset_periodic_timer(&motor_timer);
+            _pbio_attitude_poll();
+            _pbio_motorpoll_poll();
+        } else if (data == &light_timer) {
+            reset_periodic_timer(&light_timer);
+            _pbio_light_poll(clock_time());
+        }
+    }
+
+    PROCESS_END();
+}
+
 /**
  * Checks for and performs pending background tasks. This function is meant to
  * be called as frequently as possible. To conserve power, you an wait for an
  * interrupt after all events have been processed (i.e. return value is 0).
+ * Periodic tasks are driven by the clock tick, so waiting for an interrupt
+ * does not delay them.
  * @return      The number of still-pending events.
  */
 int pbio_do_one_event(void) {
-    clock_time_t now = clock_time();
-
-    // pbio_do_one_event() can be called quite frequently (e.g. in a tight loop) so we
-    // don't want to call all of the subroutines unless enough time has
-    // actually elapsed to do something useful.
-    if (now - prev_fast_poll_time >= clock_from_msec(PBIO_CONFIG_SERVO_PERIOD_MS)) {
-        _pbio_motorpoll_poll();
-        prev_fast_poll_time = clock_time();
-    }
-    if (now - prev_slow_poll_time >= clock_from_msec(32)) {
-        _pbio_light_poll(now);
-        prev_slow_poll_time = now;
-    }
     return process_run();
 }
 
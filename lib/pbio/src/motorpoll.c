@@ -14,6 +14,10 @@ static pbio_error_t servo_err[PBDRV_CONFIG_NUM_MOTOR_CONTROLLER];
 static pbio_drivebase_t drivebase;
 static pbio_error_t drivebase_err;
 
+// Number of polls in which any servo or drive base emitted an event
+static uint32_t event_count;
+static pbio_motorpoll_event_callback_t event_callback;
+
 // Get pointer to servo by port index
 pbio_error_t pbio_motorpoll_get_servo(pbio_port_t port, pbio_servo_t **srv) {
 
@@ -71,6 +75,16 @@ pbio_error_t pbio_motorpoll_get_drivebase_status(pbio_drivebase_t *db) {
     return drivebase_err;
 }
 
+// Get the number of polls that emitted events so far. Waiters can compare
+// this to an earlier value to see if anything happened since.
+uint32_t pbio_motorpoll_get_event_count(void) {
+    return event_count;
+}
+
+// Set a function that gets called each time the event count changes
+void pbio_motorpoll_set_event_callback(pbio_motorpoll_event_callback_t callback) {
+    event_callback = callback;
+}
 
 void _pbio_motorpoll_reset_all(void) {
 
@@ -99,6 +113,7 @@ void _pbio_motorpoll_reset_all(void) {
 void _pbio_motorpoll_poll(void) {
 
     pbio_error_t err;
+    bool emitted = false;
 
     // Poll servos
     for (int i = 0; i < PBDRV_CONFIG_NUM_MOTOR_CONTROLLER; i++) {
@@ -107,8 +122,14 @@ void _pbio_motorpoll_poll(void) {
             err = pbio_servo_control_update(&servo[i]);
             if (err != PBIO_SUCCESS) {
                 servo_err[i] = err;
+                // An error ends the maneuver too
+                emitted = true;
             }
         }
+        // Collect events, including those from stopping outside of this poll
+        if (pbio_control_take_events(&servo[i].control)) {
+            emitted = true;
+        }
     }
 
     // Poll drivebase again if it says so, and save error if encountered
@@ -116,6 +137,18 @@ void _pbio_motorpoll_poll(void) {
         err = pbio_drivebase_update(&drivebase);
         if (err != PBIO_SUCCESS) {
             drivebase_err = err;
+            emitted = true;
+        }
+    }
+    if (pbio_control_take_events(&drivebase.control_distance) | pbio_control_take_events(&drivebase.control_heading)) {
+        emitted = true;
+    }
+
+    // Wake up anything that waits for a maneuver
+    if (emitted) {
+        event_count++;
+        if (event_callback) {
+            event_callback();
         }
     }
 }
@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#include <stdlib.h>
+
+#include <pbio/math.h>
+#include <pbio/reflex.h>
+#include <pbio/trajectory.h>
+
+void pbio_reflex_setup(pbio_reflex_t *reflex, pbio_reflex_source_t source, void *context, int32_t target, fix16_t kp, fix16_t ki, fix16_t kd, int32_t output_max) {
+    reflex->source = source;
+    reflex->context = context;
+    reflex->target = target;
+    reflex->kp = kp;
+    reflex->ki = ki;
+    reflex->kd = kd;
+    reflex->output_max = output_max;
+    reflex->started = false;
+    reflex->integral = 0;
+    reflex->output = 0;
+}
+
+pbio_error_t pbio_reflex_update(pbio_reflex_t *reflex, int32_t time_now, int32_t *output) {
+
+    // Keep the previous output if there is no new value yet
+    int32_t value;
+    pbio_error_t err = reflex->source(reflex->context, &value);
+    if (err == PBIO_ERROR_AGAIN) {
+        *output = reflex->output;
+        return PBIO_SUCCESS;
+    }
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+
+    int32_t error = reflex->target - value;
+
+    // On the first value, there is no rate of change or integral yet
+    if (!reflex->started) {
+        reflex->started = true;
+        reflex->time_prev = time_now;
+        reflex->error_prev = error;
+    }
+
+    int32_t dt = time_now - reflex->time_prev;
+    int32_t error_rate = dt > 0 ? (int64_t)(error - reflex->error_prev) * US_PER_SECOND / dt : 0;
+    int32_t integral = reflex->integral + (int64_t)error * dt / US_PER_MS;
+    reflex->time_prev = time_now;
+    reflex->error_prev = error;
+
+    int32_t proportional = pbio_math_mul_i32_fix16(error, reflex->kp);
+    int32_t derivative = pbio_math_mul_i32_fix16(error_rate, reflex->kd);
+    int32_t total = proportional + derivative + pbio_math_mul_i32_fix16(integral, reflex->ki) / MS_PER_SECOND;
+
+    // Stop integrating if that would only push the output further past its limit
+    if (abs(total) <= reflex->output_max || abs(integral) < abs(reflex->integral)) {
+        reflex->integral = integral;
+    } else {
+        total = proportional + derivative + pbio_math_mul_i32_fix16(reflex->integral, reflex->ki) / MS_PER_SECOND;
+    }
+
+    reflex->output = max(-reflex->output_max, min(total, reflex->output_max));
+    *output = reflex->output;
+    return PBIO_SUCCESS;
+}
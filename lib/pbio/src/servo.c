@@ -13,12 +13,10 @@
 #include <pbio/servo.h>
 #include <pbio/logger.h>
 
-#if PBDRV_CONFIG_NUM_MOTOR_CONTROLLER != 0
-
 #define SERVO_LOG_NUM_VALUES (9 + NUM_DEFAULT_LOG_VALUES)
 
 // TODO: Move to config and enable only known motors for platform
-static pbio_control_settings_t settings_servo_ev3_medium = {
+static const pbio_control_settings_t settings_servo_ev3_medium = {
     .max_rate = 2000,
     .abs_acceleration = 8000,
     .rate_tolerance = 100,
@@ -35,7 +33,7 @@ static pbio_control_settings_t settings_servo_ev3_medium = {
     .actuation_scale = 100,
 };
 
-static pbio_control_settings_t settings_servo_ev3_large = {
+static const pbio_control_settings_t settings_servo_ev3_large = {
     .max_rate = 1600,
     .abs_acceleration = 3200,
     .rate_tolerance = 100,
@@ -52,7 +50,7 @@ static pbio_control_settings_t settings_servo_ev3_large = {
     .actuation_scale = 100,
 };
 
-static pbio_control_settings_t settings_servo_move_hub = {
+static const pbio_control_settings_t settings_servo_move_hub = {
     .max_rate = 1500,
     .abs_acceleration = 5000,
     .rate_tolerance = 50,
@@ -69,7 +67,7 @@ static pbio_control_settings_t settings_servo_move_hub = {
     .actuation_scale = 100,
 };
 
-static pbio_control_settings_t settings_servo_boost_interactive = {
+static const pbio_control_settings_t settings_servo_boost_interactive = {
     .max_rate = 1000,
     .abs_acceleration = 2000,
     .rate_tolerance = 50,
@@ -86,7 +84,7 @@ static pbio_control_settings_t settings_servo_boost_interactive = {
     .actuation_scale = 100,
 };
 
-static pbio_control_settings_t settings_servo_cplus_xl = {
+static const pbio_control_settings_t settings_servo_cplus_xl = {
     .max_rate = 1000,
     .abs_acceleration = 4000,
     .rate_tolerance = 50,
@@ -103,7 +101,7 @@ static pbio_control_settings_t settings_servo_cplus_xl = {
     .actuation_scale = 100,
 };
 
-static pbio_control_settings_t settings_servo_default = {
+static const pbio_control_settings_t settings_servo_default = {
     .max_rate = 1000,
     .abs_acceleration = 2000,
     .rate_tolerance = 5,
@@ -120,7 +118,8 @@ static pbio_control_settings_t settings_servo_default = {
     .actuation_scale = 100,
 };
 
-static void load_servo_settings(pbio_control_settings_t *s, pbio_iodev_type_id_t id) {
+// Loads the default control settings for a motor type
+void pbio_servo_load_settings(pbio_control_settings_t *s, pbio_iodev_type_id_t id) {
     switch (id) {
         case PBIO_IODEV_TYPE_ID_EV3_MEDIUM_MOTOR:
             *s = settings_servo_ev3_medium;
@@ -154,6 +153,8 @@ static void load_servo_settings(pbio_control_settings_t *s, pbio_iodev_type_id_t
     }
 }
 
+#if PBDRV_CONFIG_NUM_MOTOR_CONTROLLER != 0
+
 pbio_error_t pbio_servo_setup(pbio_servo_t *srv, pbio_direction_t direction, fix16_t gear_ratio) {
     pbio_error_t err;
 
@@ -177,7 +178,7 @@ pbio_error_t pbio_servo_setup(pbio_servo_t *srv, pbio_direction_t direction, fix
     pbio_control_stop(&srv->control);
 
     // Load default settings for this device type
-    load_servo_settings(&srv->control.settings, srv->dcmotor->id);
+    pbio_servo_load_settings(&srv->control.settings, srv->dcmotor->id);
 
     // For a servo, counts per output unit is counts per degree at the gear train output
     srv->control.settings.counts_per_unit = fix16_mul(F16C(PBDRV_CONFIG_COUNTER_COUNTS_PER_DEGREE, 0), gear_ratio);
@@ -675,6 +675,8 @@ static void pbio_uartdev_parse_msg(uartdev_port_data_t *data) {
                 data->iodev.mode = mode;
                 if (mode == data->new_mode) {
                     memcpy(data->iodev.bin_data, data->rx_msg + 1, msg_size - 2);
+                    data->iodev.timestamp = clock_usecs();
+                    data->iodev.data_seq++;
                 }
             }
 
@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <pbio/attitude.h>
+
+#include <tinytest.h>
+#include <tinytest_macros.h>
+
+#define SAMPLE_PERIOD_US 2404 // 416 Hz
+#define GRAVITY 9807 // mm/s^2
+
+// Feeds samples with constant gyro and accelerometer values for a while
+static void feed(pbio_attitude_t *att, pbdrv_imu_sample_t *sample, uint32_t duration_ms) {
+    for (uint32_t t = 0; t < duration_ms * 1000; t += SAMPLE_PERIOD_US) {
+        sample->timestamp += SAMPLE_PERIOD_US;
+        sample->seq++;
+        pbio_attitude_update(att, sample);
+    }
+}
+
+void test_attitude_still(void *env) {
+    pbio_attitude_t att = { 0 };
+    pbdrv_imu_sample_t sample = {
+        .gyro = { 300, -500, 700 }, // bias
+        .accel = { 0, 0, GRAVITY },
+    };
+    int32_t pitch, roll, heading, rate;
+
+    // bias is learned while the hub is still, so heading must stop drifting
+    feed(&att, &sample, 1000);
+    pbio_attitude_get_heading(&att, &heading, &rate);
+    feed(&att, &sample, 10000);
+
+    int32_t drift;
+    pbio_attitude_get_heading(&att, &drift, &rate);
+    drift -= heading;
+    tt_want_int_op(abs(drift), <, 100);
+
+    pbio_attitude_get_tilt(&att, &pitch, &roll);
+    tt_want_int_op(abs(pitch), <, 500);
+    tt_want_int_op(abs(roll), <, 500);
+}
+
+void test_attitude_heading(void *env) {
+    pbio_attitude_t att = { 0 };
+    pbdrv_imu_sample_t sample = {
+        .accel = { 0, 0, GRAVITY },
+    };
+    int32_t heading, rate;
+
+    // let it estimate the bias first
+    feed(&att, &sample, 1000);
+    pbio_attitude_reset_heading(&att, 0);
+
+    // turn at 90 deg/s for one second
+    sample.gyro[2] = 90000;
+    feed(&att, &sample, 1000);
+    pbio_attitude_get_heading(&att, &heading, &rate);
+    tt_want_int_op(rate, ==, 90000);
+    sample.gyro[2] = 0;
+    feed(&att, &sample, 100);
+
+    pbio_attitude_get_heading(&att, &heading, &rate);
+    tt_want_int_op(abs(heading - 90000), <, 1000);
+
+    // and back again, past the starting point
+    sample.gyro[2] = -90000;
+    feed(&att, &sample, 3000);
+    pbio_attitude_get_heading(&att, &heading, &rate);
+    tt_want_int_op(abs(heading + 180000), <, 2000);
+}
+
+void test_attitude_tilt(void *env) {
+    pbio_attitude_t att = { 0 };
+    pbdrv_imu_sample_t sample = {
+        .accel = { 0, 0, GRAVITY },
+    };
+    int32_t pitch, roll;
+
+    feed(&att, &sample, 100);
+
+    // hub rests at 30 degrees roll: the gyro has already stopped, so the
+    // estimate must converge using the accelerometer alone.
+    sample.accel[1] = GRAVITY / 2;
+    sample.accel[2] = GRAVITY * 866 / 1000;
+    feed(&att, &sample, 3000);
+
+    pbio_attitude_get_tilt(&att, &pitch, &roll);
+    tt_want_int_op(abs(pitch), <, 500);
+    tt_want_int_op(abs(roll - 30000), <, 500);
+
+    // accelerometer is ignored while there is other acceleration
+    sample.accel[0] = GRAVITY;
+    feed(&att, &sample, 1000);
+    pbio_attitude_get_tilt(&att, &pitch, &roll);
+    tt_want_int_op(abs(pitch), <, 500);
+}
@@ -0,0 +1,363 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+// Measures how well the controller performs standard maneuvers on a
+// simulated EV3 Large Motor. The thresholds are set a little above what the
+// controller achieves today, so changes that make control worse fail here.
+//
+// Run with PBIO_TEST_CONTROL_REPORT=1 in the environment to print the
+// measured metrics of each maneuver.
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <pbdrv/motor.h>
+
+#include <pbio/config.h>
+#include <pbio/control.h>
+#include <pbio/drivebase.h>
+#include <pbio/servo.h>
+
+#include <tinytest.h>
+#include <tinytest_macros.h>
+
+#include "../drv/virtual/motor_sim.h"
+
+// Time at which each maneuver starts (us)
+#define TIME_START (1000000)
+
+#define RAD_PER_DEG (3.14159265358979323846 / 180)
+
+typedef struct {
+    int32_t done_time; // Time until the maneuver is done (ms), or -1 if never
+    int32_t settle_time; // Time until the count stays within tolerance of the target (ms)
+    int32_t overshoot; // Largest count past the target, in the direction of motion
+    int32_t final_error; // Count error at the end of the simulation
+    int32_t rate_error; // Mean absolute rate error while running at constant speed
+    int32_t stall_delay; // Time from hitting an end stop until the stall is detected (ms)
+    int32_t done_event_time; // Time of the update that emitted the done event (ms), or -1 if never
+    int32_t stall_event_time; // Time of the update that emitted the stall event (ms), or -1 if never
+    int32_t num_done_events; // Number of done events emitted during the maneuver
+} metrics_t;
+
+static void report(const char *name, metrics_t *m) {
+    if (!getenv("PBIO_TEST_CONTROL_REPORT")) {
+        return;
+    }
+    printf("%-22s done %5d ms  settle %5d ms  overshoot %4d  error %4d  rate error %4d  stall delay %4d ms\n",
+        name, m->done_time, m->settle_time, m->overshoot, m->final_error, m->rate_error, m->stall_delay);
+}
+
+static void actuate(pbdrv_motor_sim_t *sim, pbio_control_t *ctl, int32_t time, pbio_actuation_t actuation, int32_t control) {
+    switch (actuation) {
+        case PBIO_ACTUATION_COAST:
+            pbdrv_motor_sim_coast(sim, time);
+            break;
+        case PBIO_ACTUATION_BRAKE:
+            pbdrv_motor_sim_set_duty_cycle(sim, time, 0);
+            break;
+        case PBIO_ACTUATION_HOLD:
+            pbio_control_start_hold_control(ctl, time, control);
+            break;
+        case PBIO_ACTUATION_DUTY:
+            pbdrv_motor_sim_set_duty_cycle(sim, time, max(-PBDRV_MAX_DUTY, min(control, PBDRV_MAX_DUTY)));
+            break;
+    }
+}
+
+// Runs the control loop like the servo does, and measures the response. The
+// target is only used for the count metrics. The rate metric is evaluated
+// between rate_from and rate_to (ms after start) if rate_to is nonzero.
+static void run_servo(pbdrv_motor_sim_t *sim, pbio_control_t *ctl, int32_t duration, int32_t target,
+    int32_t target_rate, int32_t rate_from, int32_t rate_to, metrics_t *m) {
+
+    int32_t direction = target_rate < 0 ? -1 : 1;
+    int64_t rate_error_sum = 0;
+    int32_t rate_samples = 0;
+    int32_t contact_time = -1;
+
+    m->done_time = -1;
+    m->settle_time = -1;
+    m->overshoot = 0;
+    m->rate_error = 0;
+    m->stall_delay = -1;
+    m->done_event_time = -1;
+    m->stall_event_time = -1;
+    m->num_done_events = 0;
+
+    // Only count events emitted by the control loop
+    pbio_control_take_events(ctl);
+
+    for (int32_t time = TIME_START; time < TIME_START + duration * US_PER_MS; time += PBIO_CONFIG_SERVO_PERIOD_MS * US_PER_MS) {
+        int32_t elapsed = (time - TIME_START) / US_PER_MS;
+        int32_t count = pbdrv_motor_sim_get_count(sim, time);
+        int32_t rate = pbdrv_motor_sim_get_rate(sim, time);
+
+        // Measure the response
+        if (m->done_time < 0 && pbio_control_is_done(ctl)) {
+            m->done_time = elapsed;
+            if (contact_time >= 0) {
+                m->stall_delay = elapsed - contact_time;
+            }
+        }
+        if (abs(count - target) > ctl->settings.count_tolerance) {
+            m->settle_time = -1;
+        } else if (m->settle_time < 0) {
+            m->settle_time = elapsed;
+        }
+        m->overshoot = max(m->overshoot, (count - target) * direction);
+        if (elapsed >= rate_from && elapsed < rate_to) {
+            rate_error_sum += abs(rate - target_rate);
+            rate_samples++;
+        }
+        if (contact_time < 0 && sim->has_limits &&
+            (sim->angle >= sim->angle_max || sim->angle <= sim->angle_min)) {
+            contact_time = elapsed;
+        }
+
+        // Update the control loop
+        if (ctl->type != PBIO_CONTROL_NONE) {
+            pbio_actuation_t actuation;
+            int32_t control;
+            control_update(ctl, time, count, rate, &actuation, &control);
+            actuate(sim, ctl, time, actuation, control);
+        }
+
+        uint8_t events = pbio_control_take_events(ctl);
+        if (events & PBIO_CONTROL_EVENT_DONE) {
+            m->num_done_events++;
+            if (m->done_event_time < 0) {
+                m->done_event_time = elapsed;
+            }
+        }
+        if ((events & PBIO_CONTROL_EVENT_STALLED) && m->stall_event_time < 0) {
+            m->stall_event_time = elapsed;
+        }
+    }
+
+    m->final_error = pbdrv_motor_sim_get_count(sim, TIME_START + duration * US_PER_MS) - target;
+    if (rate_samples) {
+        m->rate_error = rate_error_sum / rate_samples;
+    }
+}
+
+static void setup_servo(pbdrv_motor_sim_t *sim, pbio_control_t *ctl) {
+    pbdrv_motor_sim_reset(sim, TIME_START);
+    pbio_control_stop(ctl);
+
+    // Use the same settings as pbio_servo_setup() for this motor
+    pbio_servo_load_settings(&ctl->settings, PBIO_IODEV_TYPE_ID_EV3_LARGE_MOTOR);
+    ctl->settings.counts_per_unit = F16(PBDRV_CONFIG_COUNTER_COUNTS_PER_DEGREE);
+}
+
+void test_control_run_target(void *env) {
+    pbdrv_motor_sim_t sim;
+    pbio_control_t ctl;
+    metrics_t m;
+
+    setup_servo(&sim, &ctl);
+    pbio_control_start_angle_control(&ctl, TIME_START, 0, 360, 0, 500, ctl.settings.abs_acceleration, PBIO_ACTUATION_HOLD);
+    run_servo(&sim, &ctl, 2000, 360, 500, 0, 0, &m);
+    report("run_target", &m);
+
+    // The trajectory itself takes 876 ms
+    tt_want_int_op(m.done_time, >=, 0);
+    tt_want_int_op(m.done_time, <=, 1000);
+    tt_want_int_op(m.settle_time, >=, 0);
+    tt_want_int_op(m.settle_time, <=, 1000);
+    tt_want_int_op(m.overshoot, <=, 10);
+    tt_want_int_op(abs(m.final_error), <=, 3);
+
+    // Completion is emitted once, by the update that completes the maneuver
+    tt_want_int_op(m.num_done_events, ==, 1);
+    tt_want_int_op(m.done_event_time + PBIO_CONFIG_SERVO_PERIOD_MS, ==, m.done_time);
+    tt_want_int_op(m.stall_event_time, ==, -1);
+}
+
+void test_control_run_target_load(void *env) {
+    pbdrv_motor_sim_t sim;
+    pbio_control_t ctl;
+    metrics_t m;
+
+    // A load of 0.1 Nm needs about 20% duty just to keep the motor still, so
+    // the integrator has to remove the error.
+    setup_servo(&sim, &ctl);
+    sim.load = 0.1;
+    pbio_control_start_angle_control(&ctl, TIME_START, 0, 180, 0, 500, ctl.settings.abs_acceleration, PBIO_ACTUATION_HOLD);
+    run_servo(&sim, &ctl, 2000, 180, 500, 0, 0, &m);
+    report("run_target with load", &m);
+
+    tt_want_int_op(m.done_time, >=, 0);
+    tt_want_int_op(m.done_time, <=, 1000);
+    tt_want_int_op(m.overshoot, <=, 10);
+    tt_want_int_op(abs(m.final_error), <=, 5);
+}
+
+void test_control_run_time(void *env) {
+    pbdrv_motor_sim_t sim;
+    pbio_control_t ctl;
+    metrics_t m;
+
+    setup_servo(&sim, &ctl);
+    pbio_control_start_timed_control(&ctl, TIME_START, 1000 * US_PER_MS, 0, 0, 500, ctl.settings.abs_acceleration, pbio_control_on_target_time, PBIO_ACTUATION_COAST);
+    // Acceleration and deceleration take 156 ms each, so the speed should be
+    // constant from about 300 ms to 800 ms
+    run_servo(&sim, &ctl, 1500, 0, 500, 300, 800, &m);
+    report("run_time", &m);
+
+    tt_want_int_op(m.done_time, >=, 1000);
+    tt_want_int_op(m.done_time, <=, 1020);
+    tt_want_int_op(m.rate_error, <=, 15);
+}
+
+void test_control_run_until_stalled(void *env) {
+    pbdrv_motor_sim_t sim;
+    pbio_control_t ctl;
+    metrics_t m;
+
+    setup_servo(&sim, &ctl);
+    sim.has_limits = true;
+    sim.angle_min = -1000;
+    sim.angle_max = 90 * RAD_PER_DEG;
+    pbio_control_start_timed_control(&ctl, TIME_START, DURATION_FOREVER, 0, 0, 300, ctl.settings.abs_acceleration, pbio_control_on_target_stalled, PBIO_ACTUATION_COAST);
+    run_servo(&sim, &ctl, 2000, 90, 300, 0, 0, &m);
+    report("run_until_stalled", &m);
+
+    // The stall must be detected soon after the stall time of 200 ms
+    tt_want_int_op(m.stall_delay, >=, 200);
+    tt_want_int_op(m.stall_delay, <=, 320);
+
+    // The stall completes the maneuver, so both are emitted at the same time
+    tt_want_int_op(m.stall_event_time, >=, 0);
+    tt_want_int_op(m.done_event_time, ==, m.stall_event_time);
+    tt_want_int_op(m.done_event_time + PBIO_CONFIG_SERVO_PERIOD_MS, ==, m.done_time);
+}
+
+// Drive base of two simulated motors, controlled like in drivebase.c
+
+typedef struct {
+    pbdrv_motor_sim_t left;
+    pbdrv_motor_sim_t right;
+    pbio_control_t distance;
+    pbio_control_t heading;
+} drivebase_t;
+
+static void setup_drivebase(drivebase_t *db) {
+    setup_servo(&db->left, &db->distance);
+    setup_servo(&db->right, &db->heading);
+
+    // The right motor is a bit stiffer, so heading control has work to do
+    db->right.friction_coulomb *= 2;
+
+    // Same as pbio_drivebase_setup(), except for scaling
+    pbio_control_settings_t s_left = db->distance.settings;
+    pbio_control_settings_t s_right = db->heading.settings;
+    tt_want_int_op(pbio_drivebase_adopt_settings(&db->distance.settings, &db->heading.settings, &s_left, &s_right), ==, PBIO_SUCCESS);
+}
+
+static void drivebase_actuate(drivebase_t *db, int32_t time, pbio_actuation_t actuation, int32_t sum_control, int32_t dif_control) {
+    switch (actuation) {
+        case PBIO_ACTUATION_COAST:
+            pbdrv_motor_sim_coast(&db->left, time);
+            pbdrv_motor_sim_coast(&db->right, time);
+            break;
+        case PBIO_ACTUATION_BRAKE:
+            pbdrv_motor_sim_set_duty_cycle(&db->left, time, 0);
+            pbdrv_motor_sim_set_duty_cycle(&db->right, time, 0);
+            break;
+        case PBIO_ACTUATION_HOLD:
+            break;
+        case PBIO_ACTUATION_DUTY:
+            pbdrv_motor_sim_set_duty_cycle(&db->left, time, max(-PBDRV_MAX_DUTY, min(sum_control + dif_control, PBDRV_MAX_DUTY)));
+            pbdrv_motor_sim_set_duty_cycle(&db->right, time, max(-PBDRV_MAX_DUTY, min(sum_control - dif_control, PBDRV_MAX_DUTY)));
+            break;
+    }
+}
+
+// Runs the drive base control loop and measures the response of the given
+// control. The largest deviation of the other control from its target is
+// reported as the overshoot.
+static void run_drivebase(drivebase_t *db, int32_t duration, bool straight, int32_t target, metrics_t *m) {
+
+    int32_t deviation = 0;
+
+    m->done_time = -1;
+    m->settle_time = -1;
+    m->rate_error = 0;
+    m->stall_delay = -1;
+
+    for (int32_t time = TIME_START; time < TIME_START + duration * US_PER_MS; time += PBIO_CONFIG_SERVO_PERIOD_MS * US_PER_MS) {
+        int32_t elapsed = (time - TIME_START) / US_PER_MS;
+        int32_t count_left = pbdrv_motor_sim_get_count(&db->left, time);
+        int32_t count_right = pbdrv_motor_sim_get_count(&db->right, time);
+        int32_t rate_left = pbdrv_motor_sim_get_rate(&db->left, time);
+        int32_t rate_right = pbdrv_motor_sim_get_rate(&db->right, time);
+        int32_t sum = count_left + count_right;
+        int32_t dif = count_left - count_right;
+
+        pbio_control_t *ctl = straight ? &db->distance : &db->heading;
+        int32_t count = straight ? sum : dif;
+
+        if (m->done_time < 0 && pbio_control_is_done(&db->distance) && pbio_control_is_done(&db->heading)) {
+            m->done_time = elapsed;
+        }
+        if (abs(count - target) > ctl->settings.count_tolerance) {
+            m->settle_time = -1;
+        } else if (m->settle_time < 0) {
+            m->settle_time = elapsed;
+        }
+        deviation = max(deviation, abs(straight ? dif : sum));
+
+        if (db->distance.type != PBIO_CONTROL_NONE && db->heading.type != PBIO_CONTROL_NONE) {
+            pbio_actuation_t sum_actuation, dif_actuation;
+            int32_t sum_control, dif_control;
+            control_update(&db->distance, time, sum, rate_left + rate_right, &sum_actuation, &sum_control);
+            control_update(&db->heading, time, dif, rate_left - rate_right, &dif_actuation, &dif_control);
+            tt_want_int_op(sum_actuation, ==, dif_actuation);
+            drivebase_actuate(db, time, sum_actuation, sum_control, dif_control);
+        }
+    }
+
+    int32_t time_end = TIME_START + duration * US_PER_MS;
+    int32_t count_left = pbdrv_motor_sim_get_count(&db->left, time_end);
+    int32_t count_right = pbdrv_motor_sim_get_count(&db->right, time_end);
+    m->final_error = (straight ? count_left + count_right : count_left - count_right) - target;
+    m->overshoot = deviation;
+}
+
+void test_control_drivebase_straight(void *env) {
+    drivebase_t db;
+    metrics_t m;
+
+    // Drive 1000 degrees on each wheel
+    setup_drivebase(&db);
+    pbio_control_start_relative_angle_control(&db.distance, TIME_START, 0, 2000, 0, 1000, db.distance.settings.abs_acceleration, PBIO_ACTUATION_HOLD);
+    pbio_control_start_relative_angle_control(&db.heading, TIME_START, 0, 0, 0, 1000, db.heading.settings.abs_acceleration, PBIO_ACTUATION_HOLD);
+    run_drivebase(&db, 3000, true, 2000, &m);
+    report("drivebase straight", &m);
+
+    tt_want_int_op(m.done_time, >=, 0);
+    tt_want_int_op(m.done_time, <=, 2200);
+    tt_want_int_op(abs(m.final_error), <=, 6);
+    // Overshoot is the heading deviation while driving straight
+    tt_want_int_op(m.overshoot, <=, 20);
+}
+
+void test_control_drivebase_turn(void *env) {
+    drivebase_t db;
+    metrics_t m;
+
+    // Turn in place until the wheels are 360 degrees apart
+    setup_drivebase(&db);
+    pbio_control_start_relative_angle_control(&db.distance, TIME_START, 0, 0, 0, 600, db.distance.settings.abs_acceleration, PBIO_ACTUATION_HOLD);
+    pbio_control_start_relative_angle_control(&db.heading, TIME_START, 0, 360, 0, 600, db.heading.settings.abs_acceleration, PBIO_ACTUATION_HOLD);
+    run_drivebase(&db, 2000, false, 360, &m);
+    report("drivebase turn", &m);
+
+    tt_want_int_op(m.done_time, >=, 0);
+    tt_want_int_op(m.done_time, <=, 1000);
+    tt_want_int_op(abs(m.final_error), <=, 6);
+    // Overshoot is the forward drift while turning
+    tt_want_int_op(m.overshoot, <=, 20);
+}
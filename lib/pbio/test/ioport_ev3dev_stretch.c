@@ -0,0 +1,116 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#include <stdbool.h>
+
+#include <pbdrv/ioport.h>
+#include <pbio/error.h>
+#include <pbio/port.h>
+
+#include <tinytest.h>
+#include <tinytest_macros.h>
+
+#include "drv/ioport/ioport_ev3dev_stretch_index.h"
+
+// Parses and adds a device, like the udev monitor does
+static pbdrv_ioport_ev3dev_index_device_t add(const char *subsystem, const char *address, const char *sysnum) {
+    pbdrv_ioport_ev3dev_index_device_t device;
+    tt_want(pbdrv_ioport_ev3dev_index_parse(subsystem, address, sysnum, &device));
+    pbdrv_ioport_ev3dev_index_add(&device);
+    return device;
+}
+
+// Looks up a number, or returns -1 if there is an error
+static int get_number(pbio_port_t port, const char *subsystem, pbio_error_t expected) {
+    int number = -1;
+    tt_want_int_op(pbdrv_ioport_ev3dev_get_number(port, subsystem, &number), ==, expected);
+    return number;
+}
+
+void test_ev3dev_index_parse(void *env) {
+    pbdrv_ioport_ev3dev_index_device_t device;
+
+    tt_want(pbdrv_ioport_ev3dev_index_parse("lego-sensor", "ev3-ports:in3", "12", &device));
+    tt_want_int_op(device.port, ==, 2);
+    tt_want_int_op(device.number, ==, 12);
+    tt_want(device.exact);
+
+    tt_want(pbdrv_ioport_ev3dev_index_parse("tacho-motor", "ev3-ports:outB", "0", &device));
+    tt_want_int_op(device.port, ==, 5);
+    tt_want(device.exact);
+
+    // I2C sensor behind an input port
+    tt_want(pbdrv_ioport_ev3dev_index_parse("lego-sensor", "ev3-ports:in1:i2c1", "4", &device));
+    tt_want_int_op(device.port, ==, 0);
+    tt_want(!device.exact);
+
+    // Not indexed
+    tt_want(!pbdrv_ioport_ev3dev_index_parse("leds", "ev3-ports:in1", "0", &device));
+    tt_want(!pbdrv_ioport_ev3dev_index_parse("lego-sensor", "serial0-0", "0", &device));
+    tt_want(!pbdrv_ioport_ev3dev_index_parse("lego-sensor", "ev3-ports:in5", "0", &device));
+    tt_want(!pbdrv_ioport_ev3dev_index_parse("lego-sensor", NULL, "0", &device));
+    tt_want(!pbdrv_ioport_ev3dev_index_parse("lego-sensor", "ev3-ports:in1", NULL, &device));
+}
+
+void test_ev3dev_index_lookup(void *env) {
+    pbdrv_ioport_ev3dev_index_reset();
+    add("lego-sensor", "ev3-ports:in1", "3");
+
+    // Nothing is known until the initial scan is done
+    get_number(PBIO_PORT_1, "lego-sensor", PBIO_ERROR_NOT_SUPPORTED);
+    pbdrv_ioport_ev3dev_index_set_ready();
+
+    tt_want_int_op(get_number(PBIO_PORT_1, "lego-sensor", PBIO_SUCCESS), ==, 3);
+    get_number(PBIO_PORT_2, "lego-sensor", PBIO_ERROR_NO_DEV);
+    get_number(PBIO_PORT_1, "tacho-motor", PBIO_ERROR_NO_DEV);
+    get_number(PBIO_PORT_1, "leds", PBIO_ERROR_NOT_SUPPORTED);
+
+    // Ports are counted apart from the devices on them
+    add("lego-port", "ev3-ports:outA", "4");
+    pbdrv_ioport_ev3dev_index_device_t motor = add("tacho-motor", "ev3-ports:outA", "7");
+    tt_want_int_op(get_number(PBIO_PORT_A, "lego-port", PBIO_SUCCESS), ==, 4);
+    tt_want_int_op(get_number(PBIO_PORT_A, "tacho-motor", PBIO_SUCCESS), ==, 7);
+
+    pbdrv_ioport_ev3dev_index_remove(&motor);
+    get_number(PBIO_PORT_A, "tacho-motor", PBIO_ERROR_NO_DEV);
+    tt_want_int_op(get_number(PBIO_PORT_A, "lego-port", PBIO_SUCCESS), ==, 4);
+}
+
+void test_ev3dev_index_behind_port(void *env) {
+    pbdrv_ioport_ev3dev_index_reset();
+    pbdrv_ioport_ev3dev_index_set_ready();
+
+    // A single device behind a port can be found
+    pbdrv_ioport_ev3dev_index_device_t first = add("lego-sensor", "ev3-ports:in2:i2c1", "5");
+    tt_want_int_op(get_number(PBIO_PORT_2, "lego-sensor", PBIO_SUCCESS), ==, 5);
+
+    // With two of them, the index can't tell which one is meant
+    pbdrv_ioport_ev3dev_index_device_t second = add("lego-sensor", "ev3-ports:in2:i2c2", "6");
+    get_number(PBIO_PORT_2, "lego-sensor", PBIO_ERROR_NOT_SUPPORTED);
+
+    // A device at the port itself wins over those behind it
+    pbdrv_ioport_ev3dev_index_device_t exact = add("lego-sensor", "ev3-ports:in2", "8");
+    tt_want_int_op(get_number(PBIO_PORT_2, "lego-sensor", PBIO_SUCCESS), ==, 8);
+    add("lego-sensor", "ev3-ports:in2:i2c3", "9");
+    tt_want_int_op(get_number(PBIO_PORT_2, "lego-sensor", PBIO_SUCCESS), ==, 8);
+
+    // Removing other devices keeps the number
+    pbdrv_ioport_ev3dev_index_remove(&first);
+    tt_want_int_op(get_number(PBIO_PORT_2, "lego-sensor", PBIO_SUCCESS), ==, 8);
+
+    // Removing the device that was found leaves it to the caller to search
+    pbdrv_ioport_ev3dev_index_remove(&exact);
+    get_number(PBIO_PORT_2, "lego-sensor", PBIO_ERROR_NOT_SUPPORTED);
+
+    // Until there is nothing left
+    pbdrv_ioport_ev3dev_index_remove(&second);
+    get_number(PBIO_PORT_2, "lego-sensor", PBIO_ERROR_NOT_SUPPORTED);
+    pbdrv_ioport_ev3dev_index_device_t last = { .subsystem = exact.subsystem, .port = exact.port, .number = 9, .exact = false };
+    pbdrv_ioport_ev3dev_index_remove(&last);
+    get_number(PBIO_PORT_2, "lego-sensor", PBIO_ERROR_NO_DEV);
+
+    // Removing more than was added does not underflow the count
+    pbdrv_ioport_ev3dev_index_remove(&last);
+    add("lego-sensor", "ev3-ports:in2", "10");
+    tt_want_int_op(get_number(PBIO_PORT_2, "lego-sensor", PBIO_SUCCESS), ==, 10);
+}
@@ -0,0 +1,262 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <pbio/error.h>
+#include <pbio/light.h>
+#include <pbio/port.h>
+
+#include <ev3dev_stretch/nxtcolor.h>
+#include <ev3dev_stretch/nxtcolor_gpio.h>
+
+#include <tinytest.h>
+#include <tinytest_macros.h>
+
+// Calibration data, thresholds and crc, as sent by the sensor
+#define CALIBRATION_SIZE (3 * 4 * 4 + 2 * 2 + 2)
+
+// Calibration multiplier that keeps the raw value as percentage
+#define CALIBRATION_UNITY (111410)
+
+// Mock sensor that records all pin operations and sends scripted data
+static struct {
+    bool opened;
+    uint8_t ops[4096];
+    size_t num_ops;
+    const uint8_t *tx_data;
+    size_t tx_bits;
+    const int32_t *adc_values;
+    size_t num_adc_reads;
+} mock;
+
+static pbio_error_t mock_open(nxtcolor_gpio_t *gpio) {
+    mock.opened = true;
+    return PBIO_SUCCESS;
+}
+
+static pbio_error_t mock_run(nxtcolor_gpio_t *gpio, const uint8_t *ops, size_t num_ops, uint8_t *in) {
+    size_t num_bits = 0;
+    for (size_t i = 0; i < num_ops; i++) {
+        if (mock.num_ops == sizeof(mock.ops)) {
+            return PBIO_ERROR_FAILED;
+        }
+        mock.ops[mock.num_ops++] = ops[i];
+        if (ops[i] == NXTCOLOR_GPIO_DATA_READ) {
+            // The sensor sends each byte LSB first
+            if (mock.tx_data[mock.tx_bits / 8] & (1 << (mock.tx_bits % 8))) {
+                in[num_bits / 8] |= 1 << (num_bits % 8);
+            }
+            mock.tx_bits++;
+            num_bits++;
+        }
+    }
+    return PBIO_SUCCESS;
+}
+
+static pbio_error_t mock_read_adc(nxtcolor_gpio_t *gpio, nxtcolor_gpio_adc_t adc, int32_t *value) {
+    // A low value on wire 1 means that the sensor is attached
+    if (adc == NXTCOLOR_GPIO_ADC_CON) {
+        *value = 0;
+        return PBIO_SUCCESS;
+    }
+    *value = mock.adc_values[mock.num_adc_reads++];
+    return PBIO_SUCCESS;
+}
+
+static void mock_close(nxtcolor_gpio_t *gpio) {
+    mock.opened = false;
+}
+
+static const nxtcolor_gpio_backend_t mock_backend = {
+    .name = "mock",
+    .open = mock_open,
+    .run = mock_run,
+    .read_adc = mock_read_adc,
+    .close = mock_close,
+};
+
+// Adds the operations that send a byte to the sensor
+static size_t expect_send_byte(uint8_t *ops, size_t n, uint8_t msg) {
+    ops[n++] = NXTCOLOR_GPIO_CLOCK_LOW;
+    ops[n++] = NXTCOLOR_GPIO_DATA_LOW;
+    for (uint8_t i = 0; i < 8; i++) {
+        ops[n++] = msg & (1 << i) ? NXTCOLOR_GPIO_DATA_HIGH : NXTCOLOR_GPIO_DATA_LOW;
+        ops[n++] = NXTCOLOR_GPIO_CLOCK_HIGH;
+        ops[n++] = NXTCOLOR_GPIO_CLOCK_LOW;
+    }
+    return n;
+}
+
+// Adds the operations that read a byte from the sensor
+static size_t expect_read_byte(uint8_t *ops, size_t n) {
+    ops[n++] = NXTCOLOR_GPIO_DATA_INPUT;
+    for (uint8_t i = 0; i < 8; i++) {
+        ops[n++] = NXTCOLOR_GPIO_CLOCK_HIGH;
+        ops[n++] = NXTCOLOR_GPIO_DATA_READ;
+        ops[n++] = NXTCOLOR_GPIO_CLOCK_LOW;
+    }
+    return n;
+}
+
+// Calls the sensor until it is done waiting
+static pbio_error_t get_values(uint8_t mode, int32_t *values) {
+    pbio_error_t err;
+    for (int i = 0; i < 100; i++) {
+        err = nxtcolor_get_values_at_mode(PBIO_PORT_1, mode, values);
+        if (err != PBIO_ERROR_AGAIN) {
+            break;
+        }
+        usleep(10000);
+    }
+    return err;
+}
+
+void test_nxtcolor_pin_sequence(void *env) {
+    static uint8_t expected[4096];
+    uint8_t tx_data[CALIBRATION_SIZE] = { 0 };
+    int32_t values[5];
+    size_t n = 0;
+
+    // All calibration rows keep the raw values, and the thresholds are
+    // zero, so the first row is used.
+    for (size_t i = 0; i < 3 * 4; i++) {
+        tx_data[i * 4 + 0] = CALIBRATION_UNITY & 0xFF;
+        tx_data[i * 4 + 1] = (CALIBRATION_UNITY >> 8) & 0xFF;
+        tx_data[i * 4 + 2] = (CALIBRATION_UNITY >> 16) & 0xFF;
+        tx_data[i * 4 + 3] = (CALIBRATION_UNITY >> 24) & 0xFF;
+    }
+    mock.tx_data = tx_data;
+
+    // Red, green, blue and ambient light
+    static const int32_t adc_values[] = { 80, 30, 20, 10 };
+    mock.adc_values = adc_values;
+
+    nxtcolor_gpio_set_backend(&mock_backend);
+
+    // Lamp mode red
+    tt_want_int_op(get_values(1, values), ==, PBIO_SUCCESS);
+    tt_want(mock.opened);
+
+    // Both pins low
+    expected[n++] = NXTCOLOR_GPIO_CLOCK_LOW;
+    expected[n++] = NXTCOLOR_GPIO_DATA_LOW;
+
+    // Reset
+    expected[n++] = NXTCOLOR_GPIO_CLOCK_LOW;
+    expected[n++] = NXTCOLOR_GPIO_DATA_HIGH;
+    expected[n++] = NXTCOLOR_GPIO_CLOCK_HIGH;
+    expected[n++] = NXTCOLOR_GPIO_CLOCK_LOW;
+    expected[n++] = NXTCOLOR_GPIO_CLOCK_HIGH;
+    expected[n++] = NXTCOLOR_GPIO_CLOCK_LOW;
+
+    // Full color mode, then read calibration data
+    n = expect_send_byte(expected, n, 13);
+    for (size_t i = 0; i < CALIBRATION_SIZE; i++) {
+        n = expect_read_byte(expected, n);
+    }
+
+    // The lamp starts off and one clock pulse turns it red
+    expected[n++] = NXTCOLOR_GPIO_CLOCK_HIGH;
+
+    tt_want_int_op(mock.num_ops, ==, n);
+    tt_want_int_op(mock.tx_bits, ==, CALIBRATION_SIZE * 8);
+    tt_want(memcmp(mock.ops, expected, n) == 0);
+
+    // Measuring cycles through red, green, blue and off, reading the data
+    // line as analog each time, and then turns the lamp back to red.
+    mock.num_ops = 0;
+    n = 0;
+    tt_want_int_op(get_values(0, values), ==, PBIO_SUCCESS);
+    static const uint8_t measure_ops[] = {
+        NXTCOLOR_GPIO_DATA_INPUT,
+        NXTCOLOR_GPIO_CLOCK_LOW,
+        NXTCOLOR_GPIO_DATA_INPUT,
+        NXTCOLOR_GPIO_CLOCK_HIGH,
+        NXTCOLOR_GPIO_DATA_INPUT,
+        NXTCOLOR_GPIO_CLOCK_LOW,
+        NXTCOLOR_GPIO_DATA_INPUT,
+        NXTCOLOR_GPIO_CLOCK_HIGH,
+    };
+    tt_want_int_op(mock.num_ops, ==, sizeof(measure_ops));
+    tt_want(memcmp(mock.ops, measure_ops, sizeof(measure_ops)) == 0);
+    tt_want_int_op(mock.num_adc_reads, ==, 4);
+
+    // The values only come out right if the calibration data was received
+    // in the right order.
+    tt_want_int_op(values[0], ==, 70);
+    tt_want_int_op(values[1], ==, 20);
+    tt_want_int_op(values[2], ==, 10);
+    tt_want_int_op(values[3], ==, 0);
+    tt_want_int_op(values[4], ==, PBIO_LIGHT_COLOR_RED);
+
+    nxtcolor_gpio_set_backend(NULL);
+}
+
+// Counts the calls that change pin levels, with and without combining them
+static void count_level_calls(const uint8_t *ops, size_t num_ops, size_t *separate, size_t *combined) {
+    *separate = 0;
+    *combined = 0;
+    for (size_t i = 0; i < num_ops;) {
+        size_t n = nxtcolor_gpio_get_batch(ops + i, num_ops - i);
+        if (n == 0) {
+            i++;
+            continue;
+        }
+        *separate += n;
+        *combined += 1;
+        i += n;
+    }
+}
+
+void test_nxtcolor_batch(void *env) {
+    static uint8_t ops[4096];
+    size_t n, separate, combined;
+
+    // Data changes with the falling clock edge, but the rising edge waits
+    // until the data is stable.
+    static const uint8_t bit_ops[] = {
+        NXTCOLOR_GPIO_DATA_HIGH,
+        NXTCOLOR_GPIO_CLOCK_HIGH,
+        NXTCOLOR_GPIO_CLOCK_LOW,
+        NXTCOLOR_GPIO_DATA_LOW,
+        NXTCOLOR_GPIO_CLOCK_HIGH,
+    };
+    tt_want_int_op(nxtcolor_gpio_get_batch(bit_ops, 5), ==, 1);
+    tt_want_int_op(nxtcolor_gpio_get_batch(bit_ops + 1, 4), ==, 1);
+    tt_want_int_op(nxtcolor_gpio_get_batch(bit_ops + 2, 3), ==, 2);
+
+    // A line that changes twice is a pulse, so it is never combined
+    static const uint8_t pulse_ops[] = {
+        NXTCOLOR_GPIO_CLOCK_LOW,
+        NXTCOLOR_GPIO_CLOCK_LOW,
+    };
+    tt_want_int_op(nxtcolor_gpio_get_batch(pulse_ops, 2), ==, 1);
+
+    // Reads are never combined
+    static const uint8_t read_ops[] = {
+        NXTCOLOR_GPIO_DATA_READ,
+        NXTCOLOR_GPIO_CLOCK_LOW,
+    };
+    tt_want_int_op(nxtcolor_gpio_get_batch(read_ops, 2), ==, 0);
+
+    // Sending one byte
+    n = expect_send_byte(ops, 0, 13);
+    count_level_calls(ops, n, &separate, &combined);
+    tt_want_int_op(separate, ==, 26);
+    tt_want_int_op(combined, ==, 18);
+
+    // Going to full color mode and reading the calibration data. Only the
+    // sending part can be combined, since the data line is an input while
+    // reading.
+    n = expect_send_byte(ops, 0, 13);
+    for (size_t i = 0; i < CALIBRATION_SIZE; i++) {
+        n = expect_read_byte(ops, n);
+    }
+    count_level_calls(ops, n, &separate, &combined);
+    TT_BLATHER(("calibration: %zu level changes in %zu calls", separate, combined));
+    tt_want_int_op(separate - combined, ==, 8);
+}
@@ -1,5 +1,20 @@
 
 #define PBDRV_CONFIG_COUNTER                        (1)
 #define PBDRV_CONFIG_COUNTER_NUM_DEV                (1)
+#define PBDRV_CONFIG_COUNTER_COUNTS_PER_DEGREE      (1)
+
+#define PBDRV_CONFIG_MOTOR_SIM                      (1)
 
 #define PBDRV_CONFIG_UART                           (1)
+
+#define PBDRV_CONFIG_IOPORT_EV3DEV_STRETCH_INDEX    (1)
+
+// Ports for the NXT Color Sensor and ev3dev device index tests
+#define PBDRV_CONFIG_HAS_PORT_A                     (1)
+#define PBDRV_CONFIG_HAS_PORT_B                     (1)
+#define PBDRV_CONFIG_HAS_PORT_C                     (1)
+#define PBDRV_CONFIG_HAS_PORT_D                     (1)
+#define PBDRV_CONFIG_HAS_PORT_1                     (1)
+#define PBDRV_CONFIG_HAS_PORT_2                     (1)
+#define PBDRV_CONFIG_HAS_PORT_3                     (1)
+#define PBDRV_CONFIG_HAS_PORT_4                     (1)
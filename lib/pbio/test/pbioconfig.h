@@ -1,2 +1,4 @@
+#define PBIO_CONFIG_ATTITUDE                (1)
+
 #define PBIO_CONFIG_UARTDEV                 (1)
 #define PBIO_CONFIG_UARTDEV_NUM_DEV         (1)
@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#include <stdlib.h>
+
+#include <pbio/reflex.h>
+
+#include <tinytest.h>
+#include <tinytest_macros.h>
+
+#define UPDATE_PERIOD_US 5000
+
+// The simulated value is kept in thousandths, so small changes add up
+static pbio_error_t get_value(void *context, int32_t *value) {
+    *value = *(int32_t *)context / 1000;
+    return PBIO_SUCCESS;
+}
+
+void test_reflex_converge(void *env) {
+    pbio_reflex_t reflex;
+    int32_t value = 0;
+    int32_t output;
+
+    pbio_reflex_setup(&reflex, get_value, &value, 50, F16(2), 0, F16(0.05), 500);
+
+    // the output is the rate of change of the value (units/s), so the value
+    // is driven toward the target.
+    for (int32_t time = 0; time < 3000000; time += UPDATE_PERIOD_US) {
+        tt_want_int_op(pbio_reflex_update(&reflex, time, &output), ==, PBIO_SUCCESS);
+        tt_want_int_op(abs(output), <=, 500);
+        value += output * UPDATE_PERIOD_US / 1000;
+    }
+    tt_want_int_op(abs(value - 50000), <=, 1000);
+}
+
+void test_reflex_windup(void *env) {
+    pbio_reflex_t reflex;
+    int32_t value = 0;
+    int32_t output;
+    int32_t time = 0;
+
+    pbio_reflex_setup(&reflex, get_value, &value, 100, F16(1), F16(10), 0, 200);
+
+    // value is stuck, so the output stays at its limit
+    for (; time < 5000000; time += UPDATE_PERIOD_US) {
+        pbio_reflex_update(&reflex, time, &output);
+    }
+    tt_want_int_op(output, ==, 200);
+
+    // once the target is reached, the output must come off the limit
+    // right away, instead of unwinding a huge integral first.
+    value = 120000;
+    time += UPDATE_PERIOD_US;
+    pbio_reflex_update(&reflex, time, &output);
+    tt_want_int_op(output, <, 200);
+}
@@ -75,6 +75,45 @@ static struct testcase_t example_tests[] = {
     END_OF_TESTCASES
 };
 
+PBIO_TEST_FUNC(test_attitude_still);
+PBIO_TEST_FUNC(test_attitude_heading);
+PBIO_TEST_FUNC(test_attitude_tilt);
+
+static struct testcase_t pbio_attitude_tests[] = {
+    PBIO_TEST(test_attitude_still),
+    PBIO_TEST(test_attitude_heading),
+    PBIO_TEST(test_attitude_tilt),
+    END_OF_TESTCASES
+};
+
+PBIO_TEST_FUNC(test_control_run_target);
+PBIO_TEST_FUNC(test_control_run_target_load);
+PBIO_TEST_FUNC(test_control_run_time);
+PBIO_TEST_FUNC(test_control_run_until_stalled);
+PBIO_TEST_FUNC(test_control_drivebase_straight);
+PBIO_TEST_FUNC(test_control_drivebase_turn);
+
+static struct testcase_t pbio_control_tests[] = {
+    PBIO_TEST(test_control_run_target),
+    PBIO_TEST(test_control_run_target_load),
+    PBIO_TEST(test_control_run_time),
+    PBIO_TEST(test_control_run_until_stalled),
+    PBIO_TEST(test_control_drivebase_straight),
+    PBIO_TEST(test_control_drivebase_turn),
+    END_OF_TESTCASES
+};
+
+PBIO_TEST_FUNC(test_ev3dev_index_parse);
+PBIO_TEST_FUNC(test_ev3dev_index_lookup);
+PBIO_TEST_FUNC(test_ev3dev_index_behind_port);
+
+static struct testcase_t pbio_ioport_ev3dev_tests[] = {
+    PBIO_TEST(test_ev3dev_index_parse),
+    PBIO_TEST(test_ev3dev_index_lookup),
+    PBIO_TEST(test_ev3dev_index_behind_port),
+    END_OF_TESTCASES
+};
+
 PBIO_TEST_FUNC(test_sqrt);
 PBIO_TEST_FUNC(test_mul_i32_fix16);
 PBIO_TEST_FUNC(test_div_i32_fix16);
@@ -86,6 +125,24 @@ static struct testcase_t pbio_math_tests[] = {
     END_OF_TESTCASES
 };
 
+PBIO_TEST_FUNC(test_nxtcolor_pin_sequence);
+PBIO_TEST_FUNC(test_nxtcolor_batch);
+
+static struct testcase_t pbio_nxtcolor_tests[] = {
+    PBIO_TEST(test_nxtcolor_pin_sequence),
+    PBIO_TEST(test_nxtcolor_batch),
+    END_OF_TESTCASES
+};
+
+PBIO_TEST_FUNC(test_reflex_converge);
+PBIO_TEST_FUNC(test_reflex_windup);
+
+static struct testcase_t pbio_reflex_tests[] = {
+    PBIO_TEST(test_reflex_converge),
+    PBIO_TEST(test_reflex_windup),
+    END_OF_TESTCASES
+};
+
 PBIO_TEST_FUNC(test_boost_color_distance_sensor);
 PBIO_TEST_FUNC(test_boost_interactive_motor);
 PBIO_TEST_FUNC(test_technic_large_motor);
@@ -101,7 +158,12 @@ static struct testcase_t pbio_uartdev_tests[] = {
 
 static struct testgroup_t test_groups[] = {
     { "example/", example_tests },
+    { "attitude/", pbio_attitude_tests },
+    { "control/", pbio_control_tests },
+    { "ioport_ev3dev/", pbio_ioport_ev3dev_tests },
     { "math/", pbio_math_tests },
+    { "nxtcolor/", pbio_nxtcolor_tests },
+    { "reflex/", pbio_reflex_tests },
     { "uartdev/", pbio_uartdev_tests, },
     END_OF_GROUPS
 };
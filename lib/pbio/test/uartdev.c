@@ -554,6 +554,9 @@ PT_THREAD(test_boost_color_distance_sensor(struct pt *pt)) {
 
     // static struct etimer timer;
     int err;
+    static uint32_t timestamp, seq, prev_seq;
+
+    tt_uint_op(pbio_iodev_get_data_timestamp(iodev, &timestamp, &prev_seq), ==, PBIO_SUCCESS);
 
     PT_WAIT_WHILE(pt, (err = pbio_iodev_set_mode_begin(iodev, 1)) == PBIO_ERROR_AGAIN);
     tt_uint_op(err, ==, PBIO_SUCCESS);
@@ -572,6 +575,10 @@ PT_THREAD(test_boost_color_distance_sensor(struct pt *pt)) {
     tt_uint_op(err, ==, PBIO_SUCCESS);
     tt_uint_op(iodev->mode, ==, 1);
 
+    // receiving data in the new mode should update the sample sequence number
+    tt_uint_op(pbio_iodev_get_data_timestamp(iodev, &timestamp, &seq), ==, PBIO_SUCCESS);
+    tt_uint_op(seq, >, prev_seq);
+
 
     // also do mode 8 since it requires the extended mode flag
 
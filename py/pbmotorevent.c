@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+// Waiting for motor events on ports that run the control loops in their own
+// thread. That thread wakes up waiting threads, so they don't have to poll.
+
+#include "py/mpconfig.h"
+
+#if PYBRICKS_PORT_CONTROL_THREAD
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <pbio/motorpoll.h>
+
+#include "py/mpthread.h"
+#include "py/runtime.h"
+
+#include "pbmotorevent.h"
+
+// How often threads that wait for a motor event check for pending exceptions (ms)
+#define MOTOR_EVENT_WAIT_MS (100)
+
+// Used to wake up threads that wait for a maneuver while they have released
+// the GIL. The event count itself is only changed while holding the GIL.
+static pthread_mutex_t motor_event_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t motor_event_cond = PTHREAD_COND_INITIALIZER;
+
+// Whether the control thread is running and will wake up waiting threads
+static bool motor_event_started;
+
+// Called in the control thread when a servo or drive base emits an event
+static void motor_event_callback(void) {
+    pthread_mutex_lock(&motor_event_lock);
+    pthread_cond_broadcast(&motor_event_cond);
+    pthread_mutex_unlock(&motor_event_lock);
+}
+
+/**
+ * Lets the control thread wake up threads that wait for motor events. Call
+ * this when the control thread starts.
+ */
+void pb_motor_event_start(void) {
+    pbio_motorpoll_set_event_callback(motor_event_callback);
+    motor_event_started = true;
+}
+
+/**
+ * Goes back to waiting in the event hook. Call this when the control thread
+ * stops.
+ */
+void pb_motor_event_stop(void) {
+    motor_event_started = false;
+    pbio_motorpoll_set_event_callback(NULL);
+}
+
+/**
+ * Waits until the event count is no longer the given value, or until it is
+ * time to check for pending exceptions. Must be called with the GIL held.
+ * @param [in]  event_count     Event count from before the wait
+ */
+void pb_motor_event_wait(uint32_t event_count) {
+    // Without the control thread, the control loops only run in the event hook
+    if (!motor_event_started) {
+        MICROPY_EVENT_POLL_HOOK
+        return;
+    }
+
+    MP_THREAD_GIL_EXIT();
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += MOTOR_EVENT_WAIT_MS * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    pthread_mutex_lock(&motor_event_lock);
+    if (pbio_motorpoll_get_event_count() == event_count) {
+        pthread_cond_timedwait(&motor_event_cond, &motor_event_lock, &deadline);
+    }
+    pthread_mutex_unlock(&motor_event_lock);
+    MP_THREAD_GIL_ENTER();
+
+    // Allow KeyboardInterrupt and other exceptions
+    mp_handle_pending(true);
+}
+
+#endif // PYBRICKS_PORT_CONTROL_THREAD
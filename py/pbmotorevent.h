@@ -0,0 +1,19 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#ifndef _PYBRICKS_PY_PBMOTOREVENT_H_
+#define _PYBRICKS_PY_PBMOTOREVENT_H_
+
+#include <stdint.h>
+
+#include "py/mpconfig.h"
+
+#if PYBRICKS_PORT_CONTROL_THREAD
+
+void pb_motor_event_start(void);
+void pb_motor_event_stop(void);
+void pb_motor_event_wait(uint32_t event_count);
+
+#endif // PYBRICKS_PORT_CONTROL_THREAD
+
+#endif // _PYBRICKS_PY_PBMOTOREVENT_H_
@@ -0,0 +1,21 @@
+from pybricks.hubs import EV3Brick
+
+ev3 = EV3Brick()
+
+# The screen and speaker are created on first use, and only once
+
+print(ev3.screen is ev3.screen)
+print(ev3.speaker is ev3.speaker)
+print(ev3.light is ev3.light)
+
+# Other attributes come from the class, as usual
+
+print(ev3.buttons is EV3Brick.buttons)
+print(hasattr(ev3, "battery"), hasattr(ev3, "missing"))
+
+# Attributes are read-only
+
+try:
+    ev3.screen = None
+except AttributeError:
+    print("AttributeError")
@@ -45,6 +45,14 @@ ev3.speaker.play_notes([], 120)
 # keyword args are OK
 ev3.speaker.play_notes(notes=[], tempo=120)
 
+# not waiting is OK
+ev3.speaker.play_notes(["C4/4", "R/8"], wait=False)
+
+# a new melody or a beep replaces the one that is playing
+ev3.speaker.play_notes(["C4/4", "D4/4_"], wait=False)
+ev3.speaker.play_notes(["E4/4"], wait=False)
+ev3.speaker.beep()
+
 # String doesn't work because it iterates each character
 try:
     ev3.speaker.play_notes("C4/4")
@@ -129,6 +137,24 @@ ev3.speaker.say("hi")
 # keyword argument OK
 ev3.speaker.say(text="hi")
 
+# not waiting is OK
+ev3.speaker.say("hi", wait=False)
+
+
+# prepare_say method
+
+# Requires one argument
+try:
+    ev3.speaker.prepare_say()
+except TypeError as ex:
+    print(ex)
+
+# one argument OK
+ev3.speaker.prepare_say("hi")
+
+# speaking prepared text is OK
+ev3.speaker.say("hi")
+
 
 # set_volume method
 
@@ -173,3 +199,7 @@ ev3.speaker.set_speech_options("en", "f1", 100, 50)
 
 # keyword args are OK
 ev3.speaker.set_speech_options(language="en", voice="f1", speed=100, pitch=50)
+
+# disk cache can be turned on and off
+ev3.speaker.set_speech_options(cache=True)
+ev3.speaker.set_speech_options(cache=False)
@@ -0,0 +1,53 @@
+# Test mailbox storage and framing for the EV3 mailbox protocol
+
+from messaging_c import Mailboxes
+from uio import BytesIO
+
+mailboxes = Mailboxes()
+buf = bytearray(Mailboxes.MAX_SIZE)
+
+# mailbox that has not received a value returns None
+print(mailboxes.read("text"))
+
+# encoded message includes the terminating zero of the name
+text_frame = bytes(mailboxes.frame("text", b"hi\0"))
+print(text_frame)
+numeric_frame = bytes(mailboxes.frame("numeric", b"\x00\x00\xa0@"))
+
+# each message is stored in its own mailbox
+stream = BytesIO(text_frame + numeric_frame)
+print(mailboxes.receive(stream, buf))
+print(mailboxes.receive(stream, buf))
+print(mailboxes.read("text"))
+print(mailboxes.read("numeric"))
+
+# end of stream means the connection was closed
+print(mailboxes.receive(stream, buf))
+
+# newer messages replace older ones
+mailboxes.receive(BytesIO(bytes(mailboxes.frame("text", b"bye\0"))), buf)
+print(mailboxes.read("text"))
+
+# only write mailbox commands are allowed
+try:
+    mailboxes.receive(BytesIO(b"\x06\x00\x01\x00\x81\x00\x01\x00"), buf)
+except ValueError as ex:
+    print(ex)
+
+# size must fit in the message
+try:
+    mailboxes.receive(BytesIO(b"\x09\x00\x01\x00\x81\x9e\x01\x00\x05\x00\x00"), buf)
+except ValueError as ex:
+    print(ex)
+
+# reading unknown mailboxes does not use up mailboxes
+for i in range(20):
+    mailboxes.read("unknown{}".format(i))
+mailboxes.receive(BytesIO(bytes(mailboxes.frame("other", b"ok\0"))), buf)
+print(mailboxes.read("other"))
+
+# receive buffer must fit the biggest message
+try:
+    mailboxes.receive(BytesIO(text_frame), bytearray(16))
+except ValueError as ex:
+    print(ex)
@@ -1,5 +1,6 @@
 from pybricks.ev3devices import Motor
 from pybricks.parameters import Port
+from pybricks.tools import multitask, run_task, wait_all, wait_any
 
 IIO_BASE = (
     "/sys/devices/platform/soc@1c00000/ti-pruss/1c32000.pru1"
@@ -84,3 +85,29 @@ print_tacho("duty_cycle_sp")  # expect -100
 # testing __str__/__repr__
 
 print(m)
+
+
+# testing waiting for maneuvers
+
+m.stop()
+print(wait_any(m) is m)  # expect True
+print(wait_all(m))  # expect None
+
+try:
+    wait_all(m, 1)
+except TypeError:
+    print("TypeError")
+
+
+# in a task, awaiting wait_any() gives the maneuver that is done
+
+
+def main():
+    done = yield from wait_any(m)
+    print(done is m)  # expect True
+    print((yield from wait_all(m)))  # expect None
+    yield from multitask(wait_any(m))
+    return done
+
+
+print(run_task(main()) is m)  # expect True
@@ -0,0 +1,71 @@
+# Test cooperative tasks with run_task() and multitask()
+
+from pybricks.tools import multitask, run_task, wait
+
+
+def count(name, n, delay):
+    for i in range(n):
+        print(name, i)
+        yield from wait(delay)
+    return name
+
+
+def main():
+    # tasks run side by side until all of them are done
+    yield from multitask(count("a", 3, 100), count("b", 2, 150))
+    print("all done")
+
+    # racing tasks stop when the first one is done
+    yield from multitask(count("c", 5, 100), count("d", 1, 150), race=True)
+    print("race done")
+
+    # run loop can't be nested
+    try:
+        run_task(count("e", 1, 0))
+    except OSError as ex:
+        print(ex.args[0])
+
+    return 42
+
+
+# return value of the main task is returned
+print(run_task(main()))
+
+
+def fail():
+    yield from wait(10)
+    raise ValueError("task failed")
+
+
+# exception in one task stops the others
+try:
+    run_task(multitask(count("f", 3, 100), fail()))
+except ValueError as ex:
+    print(ex)
+
+# wait blocks outside of tasks
+print(wait(10))
+
+
+# other threads keep blocking while a task runs, and can't start a run loop
+import _thread
+
+results = []
+
+
+def other_thread():
+    results.append(wait(10))
+    try:
+        run_task(count("g", 1, 0))
+    except OSError as ex:
+        results.append(ex.args[0])
+
+
+def wait_for_thread():
+    _thread.start_new_thread(other_thread, ())
+    while len(results) < 2:
+        yield from wait(10)
+
+
+run_task(wait_for_thread())
+print(results)